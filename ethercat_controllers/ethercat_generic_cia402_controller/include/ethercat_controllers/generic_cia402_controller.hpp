@@ -15,13 +15,17 @@
 #ifndef ETHERCAT_CONTROLLERS__GENERIC_CIA402_CONTROLLER_HPP_
 #define ETHERCAT_CONTROLLERS__GENERIC_CIA402_CONTROLLER_HPP_
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
 
-#include "controller_interface/controller_interface.hpp"
+#include "controller_interface/chainable_controller_interface.hpp"
 #include "ethercat_controllers/visibility_control.h"
+#include "rclcpp/service.hpp"
 #include "rclcpp/subscription.hpp"
+#include "rclcpp/timer.hpp"
 #include "rclcpp_lifecycle/node_interfaces/lifecycle_node_interface.hpp"
 #include "rclcpp_lifecycle/state.hpp"
 #include "realtime_tools/realtime_buffer.h"
@@ -29,15 +33,21 @@
 #include "ethercat_msgs/msg/cia402_drive_states.hpp"
 #include "ethercat_msgs/srv/switch_drive_mode_of_operation.hpp"
 #include "ethercat_msgs/srv/reset_drive_fault.hpp"
+#include "ethercat_msgs/srv/group_drive_command.hpp"
 
 namespace ethercat_controllers
 {
 using DriveStateMsgType = ethercat_msgs::msg::Cia402DriveStates;
 using SwitchMOOSrv = ethercat_msgs::srv::SwitchDriveModeOfOperation;
 using ResetFaultSrv = ethercat_msgs::srv::ResetDriveFault;
+using GroupCommandSrv = ethercat_msgs::srv::GroupDriveCommand;
 using CallbackReturn = rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn;
 
-class CiA402Controller : public controller_interface::ControllerInterface
+/** Supervises the state machine of CiA402 drives. If gated_interfaces is set, the controller
+ *  is chainable: it exports a reference interface per dof and gated interface and forwards
+ *  it to the drive only once the drive is OPERATION_ENABLED. Until then it holds the current
+ *  position, resp. sends zero velocity or effort. */
+class CiA402Controller : public controller_interface::ChainableControllerInterface
 {
 public:
   CIA402_CONTROLLER_PUBLIC
@@ -62,16 +72,60 @@ public:
   CallbackReturn on_deactivate(const rclcpp_lifecycle::State & previous_state) override;
 
   CIA402_CONTROLLER_PUBLIC
-  controller_interface::return_type update(
+  controller_interface::return_type update_and_write_commands(
     const rclcpp::Time & time,
     const rclcpp::Duration & period) override;
 
 protected:
+  std::vector<hardware_interface::CommandInterface> on_export_reference_interfaces() override;
+
+  controller_interface::return_type update_reference_from_subscribers() override;
+
   std::vector<std::string> dof_names_;
   std::vector<int> mode_ops_;
   std::vector<double> control_words_;
   std::vector<bool> reset_faults_;
 
+  // downstream interfaces gated by drive state, in the order of the reference interfaces
+  std::vector<std::string> gated_interfaces_;
+  // per reference interface index of the state interface holding the command, -1 for zero
+  std::vector<int> hold_state_indices_;
+
+  /** group command handed over to the RT loop, dofs are resolved to indices */
+  struct GroupCommand
+  {
+    uint64_t id = 0;
+    std::vector<size_t> dofs;
+    uint8_t command = GroupCommandSrv::Request::COMMAND_RELEASE;
+    int mode_of_operation = -1;
+  };
+  /** group commands not yet applied by the RT loop, in the order they were sent */
+  using GroupCommandBatch = std::vector<std::shared_ptr<GroupCommand>>;
+  // per dof command and mode applied by the last group command, -1 if none
+  std::vector<int> group_commands_;
+  std::vector<int> group_modes_;
+  uint64_t last_group_command_id_ = 0;
+  uint64_t next_group_command_id_ = 0;
+  // sent and not yet applied, only used by the service callback
+  GroupCommandBatch queued_group_commands_;
+  // feedback from the RT loop to the group command service
+  std::atomic<uint64_t> applied_group_command_id_{0};
+  // per dof id of the last group command applied to it
+  std::unique_ptr<std::atomic<uint64_t>[]> group_command_ids_;
+  std::unique_ptr<std::atomic<uint16_t>[]> status_words_;
+  std::unique_ptr<std::atomic<int>[]> modes_display_;
+
+  /** group command whose response is deferred until its drives reach the target state */
+  struct PendingGroupCommand
+  {
+    std::shared_ptr<rmw_request_id_t> header;
+    std::shared_ptr<GroupCommand> command;
+    double timeout = 0;
+    std::chrono::steady_clock::time_point deadline;
+  };
+  // only used by the service callback and the timer, in the same callback group
+  std::vector<PendingGroupCommand> pending_group_commands_;
+  rclcpp::TimerBase::SharedPtr group_command_timer_;
 
   using DriveStatePublisher = realtime_tools::RealtimePublisher<DriveStateMsgType>;
   rclcpp::Publisher<DriveStateMsgType>::SharedPtr drive_state_publisher_;
@@ -83,11 +137,25 @@ protected:
   realtime_tools::RealtimeBuffer<std::shared_ptr<ResetFaultSrv::Request>> rt_reset_fault_srv_ptr_;
   rclcpp::Service<ResetFaultSrv>::SharedPtr reset_fault_srv_ptr_;
 
+  realtime_tools::RealtimeBuffer<std::shared_ptr<GroupCommandBatch>> rt_group_commands_ptr_;
+  rclcpp::Service<GroupCommandSrv>::SharedPtr group_command_srv_ptr_;
+
   std::string logger_name_;
 
   std::string device_state_str(uint16_t status_word);
   std::string mode_of_operation_str(double mode_of_operation);
 
+  /** returns the control_word bringing the drive one transition closer to the target
+   *  state of the group command, NaN for COMMAND_RELEASE */
+  static double group_control_word(uint8_t command, uint16_t status_word);
+  /** returns true if the drive is in the target state of the group command */
+  static bool group_command_reached(uint8_t command, uint16_t status_word);
+  /** fills the per dof completion of the group command from the status words and modes of
+   *  operation displayed by all the dofs, returns true if all its dofs completed */
+  static bool group_command_completed(
+    const GroupCommand & command, const std::vector<uint16_t> & status_words,
+    const std::vector<int> & modes_display, std::vector<bool> & completed);
+
   void switch_moo_callback(
     const std::shared_ptr<SwitchMOOSrv::Request> request,
     std::shared_ptr<SwitchMOOSrv::Response> response
@@ -97,6 +165,20 @@ protected:
     const std::shared_ptr<ResetFaultSrv::Request> request,
     std::shared_ptr<ResetFaultSrv::Response> response
   );
+
+  void group_command_callback(
+    const std::shared_ptr<rmw_request_id_t> header,
+    const std::shared_ptr<GroupCommandSrv::Request> request
+  );
+
+  /** answers the pending group commands completed or timed out */
+  void check_group_commands();
+  /** fills the response to the group command if all its drives completed it, if a later
+   *  group command took over some of its drives or if final, returns true if filled */
+  bool group_command_response(
+    const PendingGroupCommand & pending, bool final, GroupCommandSrv::Response & response);
+  /** answers the group command if its response is ready, returns true if it was answered */
+  bool answer_group_command(const PendingGroupCommand & pending, bool final);
 };
 
 }  // namespace ethercat_controllers
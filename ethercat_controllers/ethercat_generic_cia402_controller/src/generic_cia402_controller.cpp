@@ -13,6 +13,9 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
 #include <string>
 #include <utility>
 #include <vector>
@@ -28,8 +31,59 @@ namespace ethercat_controllers
 {
 using hardware_interface::LoanedCommandInterface;
 
+namespace
+{
+enum class DriveState
+{
+  NOT_READY_TO_SWITCH_ON,
+  SWITCH_ON_DISABLED,
+  READY_TO_SWITCH_ON,
+  SWITCH_ON,
+  OPERATION_ENABLED,
+  QUICK_STOP_ACTIVE,
+  FAULT_REACTION_ACTIVE,
+  FAULT,
+  UNDEFINED
+};
+
+DriveState drive_state(uint16_t status_word)
+{
+  if ((status_word & 0b01001111) == 0b00000000) {
+    return DriveState::NOT_READY_TO_SWITCH_ON;
+  } else if ((status_word & 0b01001111) == 0b01000000) {
+    return DriveState::SWITCH_ON_DISABLED;
+  } else if ((status_word & 0b01101111) == 0b00100001) {
+    return DriveState::READY_TO_SWITCH_ON;
+  } else if ((status_word & 0b01101111) == 0b00100011) {
+    return DriveState::SWITCH_ON;
+  } else if ((status_word & 0b01101111) == 0b00100111) {
+    return DriveState::OPERATION_ENABLED;
+  } else if ((status_word & 0b01101111) == 0b00000111) {
+    return DriveState::QUICK_STOP_ACTIVE;
+  } else if ((status_word & 0b01001111) == 0b00001111) {
+    return DriveState::FAULT_REACTION_ACTIVE;
+  } else if ((status_word & 0b01001111) == 0b00001000) {
+    return DriveState::FAULT;
+  }
+  return DriveState::UNDEFINED;
+}
+
+// CiA402 control_word commands
+constexpr uint16_t CW_SHUTDOWN = 0x06;
+constexpr uint16_t CW_SWITCH_ON = 0x07;
+constexpr uint16_t CW_DISABLE_VOLTAGE = 0x00;
+constexpr uint16_t CW_QUICK_STOP = 0x02;
+constexpr uint16_t CW_DISABLE_OPERATION = 0x07;
+constexpr uint16_t CW_ENABLE_OPERATION = 0x0F;
+
+constexpr int MODE_DISPLAY_UNKNOWN = std::numeric_limits<int>::min();
+
+// period at which the completion of the pending group commands is checked
+constexpr auto GROUP_COMMAND_CHECK_PERIOD = std::chrono::milliseconds(10);
+}  // namespace
+
 CiA402Controller::CiA402Controller()
-: controller_interface::ControllerInterface(),
+: controller_interface::ChainableControllerInterface(),
   rt_drive_state_publisher_(nullptr)
 {
 }
@@ -40,6 +94,7 @@ CallbackReturn CiA402Controller::on_init()
     // definition of the parameters that need to be queried from the
     // controller configuration file with default values
     auto_declare<std::vector<std::string>>("dofs", std::vector<std::string>());
+    auto_declare<std::vector<std::string>>("gated_interfaces", std::vector<std::string>());
   } catch (const std::exception & e) {
     fprintf(stderr, "Exception thrown during init stage with message: %s \n", e.what());
     return CallbackReturn::ERROR;
@@ -59,9 +114,40 @@ CallbackReturn CiA402Controller::on_configure(
     return CallbackReturn::FAILURE;
   }
 
+  gated_interfaces_ = get_node()->get_parameter("gated_interfaces").as_string_array();
+  hold_state_indices_.clear();
+  int hold_state_index = static_cast<int>(2 * dof_names_.size());
+  for (auto i = 0ul; i < dof_names_.size(); i++) {
+    for (const auto & interface : gated_interfaces_) {
+      if (interface == hardware_interface::HW_IF_POSITION) {
+        hold_state_indices_.push_back(hold_state_index++);
+      } else if (interface == hardware_interface::HW_IF_VELOCITY ||
+        interface == hardware_interface::HW_IF_EFFORT)
+      {
+        hold_state_indices_.push_back(-1);
+      } else {
+        RCLCPP_ERROR(
+          get_node()->get_logger(), "'gated_interfaces' parameter: unsupported interface '%s'",
+          interface.c_str());
+        return CallbackReturn::FAILURE;
+      }
+    }
+  }
+
   mode_ops_.resize(dof_names_.size(), std::numeric_limits<int>::quiet_NaN());
   control_words_.resize(dof_names_.size(), std::numeric_limits<double>::quiet_NaN());
   reset_faults_.resize(dof_names_.size(), false);
+  group_commands_.resize(dof_names_.size(), -1);
+  group_modes_.resize(dof_names_.size(), -1);
+  status_words_.reset(new std::atomic<uint16_t>[dof_names_.size()]);
+  modes_display_.reset(new std::atomic<int>[dof_names_.size()]);
+  group_command_ids_.reset(new std::atomic<uint64_t>[dof_names_.size()]);
+  for (auto i = 0ul; i < dof_names_.size(); i++) {
+    status_words_[i].store(0);
+    modes_display_[i].store(MODE_DISPLAY_UNKNOWN);
+    group_command_ids_[i].store(last_group_command_id_);
+  }
+  queued_group_commands_.clear();
 
   try {
     // register data publisher
@@ -83,6 +169,11 @@ CallbackReturn CiA402Controller::on_configure(
     "~/switch_mode_of_operation", std::bind(&CiA402Controller::switch_moo_callback, this, _1, _2));
   reset_fault_srv_ptr_ = get_node()->create_service<ResetFaultSrv>(
     "~/reset_fault", std::bind(&CiA402Controller::reset_fault_callback, this, _1, _2));
+  group_command_srv_ptr_ = get_node()->create_service<GroupCommandSrv>(
+    "~/group_command", std::bind(&CiA402Controller::group_command_callback, this, _1, _2));
+  pending_group_commands_.clear();
+  group_command_timer_ = get_node()->create_wall_timer(
+    GROUP_COMMAND_CHECK_PERIOD, std::bind(&CiA402Controller::check_group_commands, this));
 
   RCLCPP_INFO(get_node()->get_logger(), "configure successful");
   return CallbackReturn::SUCCESS;
@@ -93,12 +184,17 @@ CiA402Controller::command_interface_configuration() const
 {
   controller_interface::InterfaceConfiguration conf;
   conf.type = controller_interface::interface_configuration_type::INDIVIDUAL;
-  conf.names.reserve(dof_names_.size() * 3);
+  conf.names.reserve(dof_names_.size() * (3 + gated_interfaces_.size()));
   for (const auto & dof_name : dof_names_) {
     conf.names.push_back(dof_name + "/" + "control_word");
     conf.names.push_back(dof_name + "/" + "mode_of_operation");
     conf.names.push_back(dof_name + "/" + "reset_fault");
   }
+  for (const auto & dof_name : dof_names_) {
+    for (const auto & interface : gated_interfaces_) {
+      conf.names.push_back(dof_name + "/" + interface);
+    }
+  }
   return conf;
 }
 
@@ -112,12 +208,48 @@ CiA402Controller::state_interface_configuration() const
     conf.names.push_back(dof_name + "/" + "mode_of_operation");
     conf.names.push_back(dof_name + "/" + "status_word");
   }
+  for (const auto & dof_name : dof_names_) {
+    for (const auto & interface : gated_interfaces_) {
+      if (interface == hardware_interface::HW_IF_POSITION) {
+        conf.names.push_back(dof_name + "/" + interface);
+      }
+    }
+  }
   return conf;
 }
 
+std::vector<hardware_interface::CommandInterface>
+CiA402Controller::on_export_reference_interfaces()
+{
+  reference_interfaces_.assign(
+    dof_names_.size() * gated_interfaces_.size(), std::numeric_limits<double>::quiet_NaN());
+
+  std::vector<hardware_interface::CommandInterface> reference_interfaces;
+  reference_interfaces.reserve(reference_interfaces_.size());
+  for (auto i = 0ul; i < dof_names_.size(); i++) {
+    for (auto j = 0ul; j < gated_interfaces_.size(); j++) {
+      reference_interfaces.push_back(
+        hardware_interface::CommandInterface(
+          get_node()->get_name(), dof_names_[i] + "/" + gated_interfaces_[j],
+          &reference_interfaces_[i * gated_interfaces_.size() + j]));
+    }
+  }
+  return reference_interfaces;
+}
+
+controller_interface::return_type CiA402Controller::update_reference_from_subscribers()
+{
+  // references are only set by the preceding controllers of the chain
+  return controller_interface::return_type::OK;
+}
+
 CallbackReturn CiA402Controller::on_activate(
   const rclcpp_lifecycle::State & /*previous_state*/)
 {
+  // the references of a previous activation must not reach the drives
+  std::fill(
+    reference_interfaces_.begin(), reference_interfaces_.end(),
+    std::numeric_limits<double>::quiet_NaN());
   return CallbackReturn::SUCCESS;
 }
 
@@ -127,7 +259,7 @@ CallbackReturn CiA402Controller::on_deactivate(
   return CallbackReturn::SUCCESS;
 }
 
-controller_interface::return_type CiA402Controller::update(
+controller_interface::return_type CiA402Controller::update_and_write_commands(
   const rclcpp::Time & /*time*/,
   const rclcpp::Duration & /*period*/)
 {
@@ -152,9 +284,48 @@ controller_interface::return_type CiA402Controller::update(
   // getting the data from services using the rt pipe
   auto moo_request = rt_moo_srv_ptr_.readFromRT();
   auto reset_fault_request = rt_reset_fault_srv_ptr_.readFromRT();
+  auto group_requests = rt_group_commands_ptr_.readFromRT();
+
+  // the new group commands are applied in order, each one taken over by all its dofs in
+  // the same cycle. the batch holds all the commands not yet applied, none is lost if
+  // several are sent within a period
+  if (group_requests && (*group_requests)) {
+    for (const auto & group_request : **group_requests) {
+      if (group_request->id <= last_group_command_id_) {
+        continue;
+      }
+      for (const auto i : group_request->dofs) {
+        group_commands_[i] = group_request->command;
+        group_modes_[i] = group_request->mode_of_operation;
+        group_command_ids_[i].store(group_request->id, std::memory_order_relaxed);
+      }
+      last_group_command_id_ = group_request->id;
+    }
+  }
 
   for (auto i = 0ul; i < dof_names_.size(); i++) {
-    if (!moo_request || !(*moo_request)) {
+    const double mode_display = state_interfaces_[2 * i].get_value();
+    const double status_word = state_interfaces_[2 * i + 1].get_value();
+    status_words_[i].store(
+      std::isnan(status_word) ? 0 : static_cast<uint16_t>(status_word),
+      std::memory_order_relaxed);
+    modes_display_[i].store(
+      std::isnan(mode_display) ? MODE_DISPLAY_UNKNOWN : static_cast<int>(mode_display),
+      std::memory_order_relaxed);
+
+    if (group_commands_[i] >= 0) {
+      control_words_[i] = group_control_word(group_commands_[i], status_words_[i].load());
+      if (group_commands_[i] == GroupCommandSrv::Request::COMMAND_RELEASE) {
+        group_commands_[i] = -1;
+      }
+    }
+
+    if (group_modes_[i] >= 0) {
+      mode_ops_[i] = group_modes_[i];
+      if (mode_display == group_modes_[i]) {
+        group_modes_[i] = -1;
+      }
+    } else if (!moo_request || !(*moo_request)) {
       mode_ops_[i] = state_interfaces_[2 * i].get_value();
     } else {
       if (dof_names_[i] == (*moo_request)->dof_name) {
@@ -169,10 +340,29 @@ controller_interface::return_type CiA402Controller::update(
       }
     }
 
+    command_interfaces_[3 * i].set_value(control_words_[i]);  // control_word
     command_interfaces_[3 * i + 1].set_value(mode_ops_[i]);  // mode_of_operation
     command_interfaces_[3 * i + 2].set_value(reset_faults_[i]);  // reset_fault
     reset_faults_[i] = false;
   }
+  applied_group_command_id_.store(last_group_command_id_, std::memory_order_release);
+
+  // gate the downstream commands by drive state
+  const auto gated_offset = 3 * dof_names_.size();
+  for (auto i = 0ul; i < dof_names_.size(); i++) {
+    const bool enabled = drive_state(status_words_[i].load(std::memory_order_relaxed)) ==
+      DriveState::OPERATION_ENABLED;
+    for (auto k = i * gated_interfaces_.size(); k < (i + 1) * gated_interfaces_.size(); k++) {
+      if (enabled) {
+        command_interfaces_[gated_offset + k].set_value(reference_interfaces_[k]);
+      } else if (hold_state_indices_[k] >= 0) {
+        command_interfaces_[gated_offset + k].set_value(
+          state_interfaces_[hold_state_indices_[k]].get_value());
+      } else {
+        command_interfaces_[gated_offset + k].set_value(0.0);
+      }
+    }
+  }
 
   return controller_interface::return_type::OK;
 }
@@ -200,6 +390,61 @@ std::string CiA402Controller::device_state_str(uint16_t status_word)
   return "STATE_UNDEFINED";
 }
 
+double CiA402Controller::group_control_word(uint8_t command, uint16_t status_word)
+{
+  const auto state = drive_state(status_word);
+  switch (command) {
+    case GroupCommandSrv::Request::COMMAND_SHUTDOWN:
+      return (state == DriveState::QUICK_STOP_ACTIVE) ? CW_DISABLE_VOLTAGE : CW_SHUTDOWN;
+    case GroupCommandSrv::Request::COMMAND_ENABLE:
+      switch (state) {
+        case DriveState::SWITCH_ON_DISABLED:
+          return CW_SHUTDOWN;
+        case DriveState::READY_TO_SWITCH_ON:
+          return CW_SWITCH_ON;
+        case DriveState::SWITCH_ON:
+        case DriveState::OPERATION_ENABLED:
+        case DriveState::QUICK_STOP_ACTIVE:
+          return CW_ENABLE_OPERATION;
+        default:
+          return CW_DISABLE_VOLTAGE;
+      }
+    case GroupCommandSrv::Request::COMMAND_DISABLE:
+      if (state == DriveState::SWITCH_ON_DISABLED) {
+        return CW_SHUTDOWN;
+      } else if (state == DriveState::QUICK_STOP_ACTIVE) {
+        return CW_DISABLE_VOLTAGE;
+      }
+      return CW_DISABLE_OPERATION;
+    case GroupCommandSrv::Request::COMMAND_DISABLE_VOLTAGE:
+      return CW_DISABLE_VOLTAGE;
+    case GroupCommandSrv::Request::COMMAND_QUICK_STOP:
+      return CW_QUICK_STOP;
+    default:
+      return std::numeric_limits<double>::quiet_NaN();
+  }
+}
+
+bool CiA402Controller::group_command_reached(uint8_t command, uint16_t status_word)
+{
+  const auto state = drive_state(status_word);
+  switch (command) {
+    case GroupCommandSrv::Request::COMMAND_SHUTDOWN:
+      return state == DriveState::READY_TO_SWITCH_ON;
+    case GroupCommandSrv::Request::COMMAND_ENABLE:
+      return state == DriveState::OPERATION_ENABLED;
+    case GroupCommandSrv::Request::COMMAND_DISABLE:
+      return state == DriveState::SWITCH_ON;
+    case GroupCommandSrv::Request::COMMAND_DISABLE_VOLTAGE:
+      return state == DriveState::SWITCH_ON_DISABLED;
+    case GroupCommandSrv::Request::COMMAND_QUICK_STOP:
+      // depending on the quick stop option code the drive may end up disabled
+      return state == DriveState::QUICK_STOP_ACTIVE || state == DriveState::SWITCH_ON_DISABLED;
+    default:
+      return true;
+  }
+}
+
 /** returns mode str based upon the mode_of_operation value */
 std::string CiA402Controller::mode_of_operation_str(double mode_of_operation)
 {
@@ -251,9 +496,162 @@ void CiA402Controller::reset_fault_callback(
   }
 }
 
+void CiA402Controller::group_command_callback(
+  const std::shared_ptr<rmw_request_id_t> header,
+  const std::shared_ptr<GroupCommandSrv::Request> request
+)
+{
+  GroupCommandSrv::Response response;
+  if (request->command > GroupCommandSrv::Request::COMMAND_QUICK_STOP) {
+    response.return_message = "Abort. Unknown command " + std::to_string(request->command);
+    group_command_srv_ptr_->send_response(*header, response);
+    return;
+  }
+
+  auto command = std::make_shared<GroupCommand>();
+  command->command = request->command;
+  command->mode_of_operation = request->mode_of_operation;
+  for (const auto & dof_name : request->dof_names) {
+    auto it = find(dof_names_.begin(), dof_names_.end(), dof_name);
+    if (it == dof_names_.end()) {
+      response.return_message = "Abort. DoF " + dof_name + " not configured.";
+      group_command_srv_ptr_->send_response(*header, response);
+      return;
+    }
+    command->dofs.push_back(std::distance(dof_names_.begin(), it));
+  }
+  command->id = ++next_group_command_id_;
+
+  // a previous single dof request must not take over once the group mode is reached
+  if (request->mode_of_operation >= 0) {
+    auto moo_request = rt_moo_srv_ptr_.readFromNonRT();
+    if (moo_request && (*moo_request) &&
+      find(
+        request->dof_names.begin(), request->dof_names.end(),
+        (*moo_request)->dof_name) != request->dof_names.end())
+    {
+      auto moo_update = std::make_shared<SwitchMOOSrv::Request>(**moo_request);
+      moo_update->mode_of_operation = request->mode_of_operation;
+      rt_moo_srv_ptr_.writeFromNonRT(moo_update);
+    }
+  }
+  // the RT loop gets all the commands it did not apply yet
+  const uint64_t applied_id = applied_group_command_id_.load(std::memory_order_acquire);
+  queued_group_commands_.erase(
+    std::remove_if(
+      queued_group_commands_.begin(), queued_group_commands_.end(),
+      [applied_id](const std::shared_ptr<GroupCommand> & queued) {
+        return queued->id <= applied_id;
+      }),
+    queued_group_commands_.end());
+  queued_group_commands_.push_back(command);
+  rt_group_commands_ptr_.writeFromNonRT(
+    std::make_shared<GroupCommandBatch>(queued_group_commands_));
+
+  PendingGroupCommand pending;
+  pending.header = header;
+  pending.command = command;
+  pending.timeout = request->timeout;
+  if (request->timeout <= 0) {
+    answer_group_command(pending, true);
+    return;
+  }
+  // answered by check_group_commands(), the executor is not blocked meanwhile
+  pending.deadline = std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(request->timeout));
+  pending_group_commands_.push_back(pending);
+}
+
+bool CiA402Controller::group_command_completed(
+  const GroupCommand & command, const std::vector<uint16_t> & status_words,
+  const std::vector<int> & modes_display, std::vector<bool> & completed)
+{
+  bool success = true;
+  completed.assign(command.dofs.size(), false);
+  for (auto k = 0ul; k < command.dofs.size(); k++) {
+    const auto i = command.dofs[k];
+    completed[k] = group_command_reached(command.command, status_words[i]) &&
+      (command.mode_of_operation < 0 || modes_display[i] == command.mode_of_operation);
+    success = success && completed[k];
+  }
+  return success;
+}
+
+void CiA402Controller::check_group_commands()
+{
+  const auto now = std::chrono::steady_clock::now();
+  for (auto pending = pending_group_commands_.begin(); pending != pending_group_commands_.end(); ) {
+    if (answer_group_command(*pending, now >= pending->deadline)) {
+      pending = pending_group_commands_.erase(pending);
+    } else {
+      ++pending;
+    }
+  }
+}
+
+bool CiA402Controller::group_command_response(
+  const PendingGroupCommand & pending, bool final, GroupCommandSrv::Response & response)
+{
+  const GroupCommand & command = *pending.command;
+  const bool applied = applied_group_command_id_.load(std::memory_order_acquire) >= command.id;
+  std::vector<uint16_t> status_words(dof_names_.size());
+  std::vector<int> modes_display(dof_names_.size());
+  for (auto i = 0ul; i < dof_names_.size(); i++) {
+    status_words[i] = status_words_[i].load();
+    modes_display[i] = modes_display_[i].load();
+  }
+
+  const bool completed = group_command_completed(
+    command, status_words, modes_display, response.completed);
+  // the drives taken over by a later command no longer follow this one
+  bool superseded = false;
+  for (auto k = 0ul; applied && k < command.dofs.size(); k++) {
+    if (group_command_ids_[command.dofs[k]].load(std::memory_order_relaxed) > command.id) {
+      response.completed[k] = false;
+      superseded = true;
+    }
+  }
+  const bool success = completed && applied && !superseded;
+  if (!success && !superseded && !final) {
+    return false;
+  }
+  if (!applied) {
+    response.completed.assign(command.dofs.size(), false);
+  }
+
+  response.drive_states.resize(command.dofs.size());
+  for (auto k = 0ul; k < command.dofs.size(); k++) {
+    response.drive_states[k] = device_state_str(status_words[command.dofs[k]]);
+  }
+  response.success = success;
+  if (success) {
+    response.return_message = "Group command completed on all drives.";
+  } else if (superseded) {
+    response.return_message = "Abort. Group command superseded by a later one on its drives.";
+  } else if (pending.timeout <= 0) {
+    response.return_message = "Request transmitted to drives.";
+  } else if (!applied) {
+    response.return_message = "Timeout. Group command was not applied, is the controller active?";
+  } else {
+    response.return_message = "Timeout. Not all drives reached the target state.";
+  }
+  return true;
+}
+
+bool CiA402Controller::answer_group_command(const PendingGroupCommand & pending, bool final)
+{
+  GroupCommandSrv::Response response;
+  if (!group_command_response(pending, final, response)) {
+    return false;
+  }
+  group_command_srv_ptr_->send_response(*pending.header, response);
+  return true;
+}
+
 }  // namespace ethercat_controllers
 
 #include "pluginlib/class_list_macros.hpp"
 
 PLUGINLIB_EXPORT_CLASS(
-  ethercat_controllers::CiA402Controller, controller_interface::ControllerInterface)
+  ethercat_controllers::CiA402Controller, controller_interface::ChainableControllerInterface)
@@ -0,0 +1,353 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gmock/gmock.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ethercat_controllers/generic_cia402_controller.hpp"
+#include "hardware_interface/loaned_command_interface.hpp"
+#include "hardware_interface/loaned_state_interface.hpp"
+
+using ethercat_controllers::CallbackReturn;
+using ethercat_controllers::GroupCommandSrv;
+
+namespace
+{
+// status words of the drive states
+constexpr uint16_t SW_SWITCH_ON_DISABLED = 0x40;
+constexpr uint16_t SW_READY_TO_SWITCH_ON = 0x21;
+constexpr uint16_t SW_SWITCH_ON = 0x23;
+constexpr uint16_t SW_OPERATION_ENABLED = 0x27;
+constexpr uint16_t SW_QUICK_STOP_ACTIVE = 0x07;
+constexpr uint16_t SW_FAULT = 0x08;
+}  // namespace
+
+class FriendCiA402Controller : public ethercat_controllers::CiA402Controller
+{
+public:
+  using CiA402Controller::GroupCommand;
+  using CiA402Controller::group_control_word;
+  using CiA402Controller::group_command_reached;
+  using CiA402Controller::group_command_completed;
+  using CiA402Controller::group_command_callback;
+  using CiA402Controller::group_command_response;
+  using CiA402Controller::pending_group_commands_;
+};
+
+/** controller of two dofs exchanging with interfaces held by the test */
+class CiA402ControllerTest : public ::testing::Test
+{
+public:
+  static void SetUpTestCase() {rclcpp::init(0, nullptr);}
+  static void TearDownTestCase() {rclcpp::shutdown();}
+
+  void SetUp() override {controller_ = std::make_unique<FriendCiA402Controller>();}
+  void TearDown() override {controller_.reset();}
+
+  void SetUpController(const std::vector<std::string> & gated_interfaces = {})
+  {
+    ASSERT_EQ(controller_->init("test_cia402_controller"), controller_interface::return_type::OK);
+    controller_->get_node()->set_parameter(
+      {"dofs", std::vector<std::string>{"joint_1", "joint_2"}});
+    controller_->get_node()->set_parameter({"gated_interfaces", gated_interfaces});
+    ASSERT_EQ(controller_->on_configure(rclcpp_lifecycle::State()), CallbackReturn::SUCCESS);
+    reference_interfaces_ = controller_->export_reference_interfaces();
+
+    // the interfaces point into the values, which must not be reallocated
+    command_names_ = controller_->command_interface_configuration().names;
+    command_values_.assign(command_names_.size(), std::numeric_limits<double>::quiet_NaN());
+    command_itfs_.reserve(command_names_.size());
+    std::vector<hardware_interface::LoanedCommandInterface> loaned_commands;
+    for (auto i = 0ul; i < command_names_.size(); i++) {
+      const auto slash = command_names_[i].find('/');
+      command_itfs_.emplace_back(
+        command_names_[i].substr(0, slash), command_names_[i].substr(slash + 1),
+        &command_values_[i]);
+      loaned_commands.emplace_back(command_itfs_.back());
+    }
+    state_names_ = controller_->state_interface_configuration().names;
+    state_values_.assign(state_names_.size(), 0.0);
+    state_itfs_.reserve(state_names_.size());
+    std::vector<hardware_interface::LoanedStateInterface> loaned_states;
+    for (auto i = 0ul; i < state_names_.size(); i++) {
+      const auto slash = state_names_[i].find('/');
+      state_itfs_.emplace_back(
+        state_names_[i].substr(0, slash), state_names_[i].substr(slash + 1), &state_values_[i]);
+      loaned_states.emplace_back(state_itfs_.back());
+    }
+    controller_->assign_interfaces(std::move(loaned_commands), std::move(loaned_states));
+  }
+
+  double & command(const std::string & name)
+  {
+    auto it = std::find(command_names_.begin(), command_names_.end(), name);
+    EXPECT_NE(it, command_names_.end()) << name;
+    return command_values_[it - command_names_.begin()];
+  }
+  double & state(const std::string & name)
+  {
+    auto it = std::find(state_names_.begin(), state_names_.end(), name);
+    EXPECT_NE(it, state_names_.end()) << name;
+    return state_values_[it - state_names_.begin()];
+  }
+
+  void update()
+  {
+    ASSERT_EQ(
+      controller_->update(rclcpp::Time(0), rclcpp::Duration::from_seconds(0.001)),
+      controller_interface::return_type::OK);
+  }
+
+  /** group command whose answer is deferred until its drives reach the target state */
+  void send_group_command(uint8_t command, const std::vector<std::string> & dof_names)
+  {
+    auto request = std::make_shared<GroupCommandSrv::Request>();
+    request->command = command;
+    request->dof_names = dof_names;
+    request->timeout = 10.0;
+    controller_->group_command_callback(std::make_shared<rmw_request_id_t>(), request);
+  }
+
+protected:
+  std::unique_ptr<FriendCiA402Controller> controller_;
+  std::vector<hardware_interface::CommandInterface> reference_interfaces_;
+  std::vector<std::string> command_names_;
+  std::vector<double> command_values_;
+  std::vector<hardware_interface::CommandInterface> command_itfs_;
+  std::vector<std::string> state_names_;
+  std::vector<double> state_values_;
+  std::vector<hardware_interface::StateInterface> state_itfs_;
+};
+
+TEST(TestCiA402Controller, GroupControlWordEnablesStepByStep)
+{
+  const uint8_t enable = GroupCommandSrv::Request::COMMAND_ENABLE;
+  EXPECT_EQ(FriendCiA402Controller::group_control_word(enable, SW_SWITCH_ON_DISABLED), 0x06);
+  EXPECT_EQ(FriendCiA402Controller::group_control_word(enable, SW_READY_TO_SWITCH_ON), 0x07);
+  EXPECT_EQ(FriendCiA402Controller::group_control_word(enable, SW_SWITCH_ON), 0x0F);
+  EXPECT_EQ(FriendCiA402Controller::group_control_word(enable, SW_OPERATION_ENABLED), 0x0F);
+  // a faulted drive is not enabled by a group command
+  EXPECT_EQ(FriendCiA402Controller::group_control_word(enable, SW_FAULT), 0x00);
+}
+
+TEST(TestCiA402Controller, GroupControlWordStopsAndReleases)
+{
+  EXPECT_EQ(
+    FriendCiA402Controller::group_control_word(
+      GroupCommandSrv::Request::COMMAND_SHUTDOWN, SW_OPERATION_ENABLED), 0x06);
+  EXPECT_EQ(
+    FriendCiA402Controller::group_control_word(
+      GroupCommandSrv::Request::COMMAND_SHUTDOWN, SW_QUICK_STOP_ACTIVE), 0x00);
+  EXPECT_EQ(
+    FriendCiA402Controller::group_control_word(
+      GroupCommandSrv::Request::COMMAND_DISABLE, SW_OPERATION_ENABLED), 0x07);
+  EXPECT_EQ(
+    FriendCiA402Controller::group_control_word(
+      GroupCommandSrv::Request::COMMAND_DISABLE, SW_SWITCH_ON_DISABLED), 0x06);
+  EXPECT_EQ(
+    FriendCiA402Controller::group_control_word(
+      GroupCommandSrv::Request::COMMAND_DISABLE_VOLTAGE, SW_OPERATION_ENABLED), 0x00);
+  EXPECT_EQ(
+    FriendCiA402Controller::group_control_word(
+      GroupCommandSrv::Request::COMMAND_QUICK_STOP, SW_OPERATION_ENABLED), 0x02);
+  EXPECT_TRUE(
+    std::isnan(
+      FriendCiA402Controller::group_control_word(
+        GroupCommandSrv::Request::COMMAND_RELEASE, SW_OPERATION_ENABLED)));
+}
+
+TEST(TestCiA402Controller, GroupCommandReached)
+{
+  EXPECT_TRUE(
+    FriendCiA402Controller::group_command_reached(
+      GroupCommandSrv::Request::COMMAND_ENABLE, SW_OPERATION_ENABLED));
+  EXPECT_FALSE(
+    FriendCiA402Controller::group_command_reached(
+      GroupCommandSrv::Request::COMMAND_ENABLE, SW_SWITCH_ON));
+  EXPECT_TRUE(
+    FriendCiA402Controller::group_command_reached(
+      GroupCommandSrv::Request::COMMAND_DISABLE, SW_SWITCH_ON));
+  // depending on its quick stop option code the drive may end up disabled
+  EXPECT_TRUE(
+    FriendCiA402Controller::group_command_reached(
+      GroupCommandSrv::Request::COMMAND_QUICK_STOP, SW_QUICK_STOP_ACTIVE));
+  EXPECT_TRUE(
+    FriendCiA402Controller::group_command_reached(
+      GroupCommandSrv::Request::COMMAND_QUICK_STOP, SW_SWITCH_ON_DISABLED));
+}
+
+TEST(TestCiA402Controller, GroupCommandCompletedOnAllDrives)
+{
+  FriendCiA402Controller::GroupCommand command;
+  command.command = GroupCommandSrv::Request::COMMAND_ENABLE;
+  command.dofs = {2, 0};
+  std::vector<uint16_t> status_words = {SW_OPERATION_ENABLED, SW_SWITCH_ON, SW_SWITCH_ON};
+  std::vector<int> modes_display = {8, 8, 8};
+  std::vector<bool> completed;
+
+  // dof 1 is not part of the group
+  EXPECT_FALSE(
+    FriendCiA402Controller::group_command_completed(
+      command, status_words, modes_display, completed));
+  EXPECT_THAT(completed, ::testing::ElementsAre(false, true));
+
+  status_words[2] = SW_OPERATION_ENABLED;
+  EXPECT_TRUE(
+    FriendCiA402Controller::group_command_completed(
+      command, status_words, modes_display, completed));
+  EXPECT_THAT(completed, ::testing::ElementsAre(true, true));
+
+  // the mode of operation must be displayed as well
+  command.mode_of_operation = 9;
+  modes_display[0] = 9;
+  EXPECT_FALSE(
+    FriendCiA402Controller::group_command_completed(
+      command, status_words, modes_display, completed));
+  EXPECT_THAT(completed, ::testing::ElementsAre(false, true));
+}
+
+TEST_F(CiA402ControllerTest, AppliesGroupCommandsSentWithinOnePeriod)
+{
+  SetUpController();
+  ASSERT_EQ(controller_->on_activate(rclcpp_lifecycle::State()), CallbackReturn::SUCCESS);
+  state("joint_1/status_word") = SW_SWITCH_ON_DISABLED;
+  state("joint_2/status_word") = SW_OPERATION_ENABLED;
+
+  send_group_command(GroupCommandSrv::Request::COMMAND_ENABLE, {"joint_1"});
+  send_group_command(GroupCommandSrv::Request::COMMAND_DISABLE_VOLTAGE, {"joint_2"});
+  update();
+  // both commands are applied in the same cycle
+  EXPECT_EQ(command("joint_1/control_word"), 0x06);
+  EXPECT_EQ(command("joint_2/control_word"), 0x00);
+
+  ASSERT_EQ(controller_->pending_group_commands_.size(), 2u);
+  const auto first = controller_->pending_group_commands_[0];
+  const auto second = controller_->pending_group_commands_[1];
+  GroupCommandSrv::Response response;
+  ASSERT_FALSE(controller_->group_command_response(first, false, response));
+  ASSERT_FALSE(controller_->group_command_response(second, false, response));
+
+  // each command completes on its own
+  state("joint_2/status_word") = SW_SWITCH_ON_DISABLED;
+  update();
+  ASSERT_FALSE(controller_->group_command_response(first, false, response));
+  ASSERT_TRUE(controller_->group_command_response(second, false, response));
+  EXPECT_TRUE(response.success);
+  state("joint_1/status_word") = SW_OPERATION_ENABLED;
+  update();
+  response = GroupCommandSrv::Response();
+  ASSERT_TRUE(controller_->group_command_response(first, false, response));
+  EXPECT_TRUE(response.success);
+}
+
+TEST_F(CiA402ControllerTest, AnswersSupersededGroupCommands)
+{
+  SetUpController();
+  ASSERT_EQ(controller_->on_activate(rclcpp_lifecycle::State()), CallbackReturn::SUCCESS);
+  state("joint_1/status_word") = SW_OPERATION_ENABLED;
+  state("joint_2/status_word") = SW_OPERATION_ENABLED;
+
+  send_group_command(GroupCommandSrv::Request::COMMAND_ENABLE, {"joint_1", "joint_2"});
+  send_group_command(GroupCommandSrv::Request::COMMAND_DISABLE, {"joint_2"});
+  update();
+  // the later command takes joint_2 over in the same cycle
+  EXPECT_EQ(command("joint_1/control_word"), 0x0F);
+  EXPECT_EQ(command("joint_2/control_word"), 0x07);
+
+  // the first command is answered at once, even though its drives are enabled
+  ASSERT_EQ(controller_->pending_group_commands_.size(), 2u);
+  GroupCommandSrv::Response response;
+  ASSERT_TRUE(
+    controller_->group_command_response(
+      controller_->pending_group_commands_[0], false, response));
+  EXPECT_FALSE(response.success);
+  EXPECT_THAT(response.return_message, ::testing::HasSubstr("superseded"));
+  EXPECT_THAT(response.completed, ::testing::ElementsAre(true, false));
+
+  response = GroupCommandSrv::Response();
+  ASSERT_FALSE(
+    controller_->group_command_response(
+      controller_->pending_group_commands_[1], false, response));
+  state("joint_2/status_word") = SW_SWITCH_ON;
+  update();
+  ASSERT_TRUE(
+    controller_->group_command_response(
+      controller_->pending_group_commands_[1], false, response));
+  EXPECT_TRUE(response.success);
+}
+
+TEST_F(CiA402ControllerTest, HoldsGatedCommandsUntilOperationEnabled)
+{
+  SetUpController({"position", "velocity", "effort"});
+  ASSERT_EQ(reference_interfaces_.size(), 6u);
+  ASSERT_EQ(controller_->on_activate(rclcpp_lifecycle::State()), CallbackReturn::SUCCESS);
+  state("joint_1/status_word") = SW_SWITCH_ON;
+  state("joint_1/position") = 1.5;
+  state("joint_2/status_word") = SW_READY_TO_SWITCH_ON;
+  state("joint_2/position") = -0.5;
+  for (auto & reference : reference_interfaces_) {
+    reference.set_value(3.0);
+  }
+
+  // the position is held at the measured one, velocity and effort are zero
+  update();
+  EXPECT_EQ(command("joint_1/position"), 1.5);
+  EXPECT_EQ(command("joint_1/velocity"), 0.0);
+  EXPECT_EQ(command("joint_1/effort"), 0.0);
+  EXPECT_EQ(command("joint_2/position"), -0.5);
+  EXPECT_EQ(command("joint_2/velocity"), 0.0);
+  EXPECT_EQ(command("joint_2/effort"), 0.0);
+  state("joint_1/position") = 1.6;
+  update();
+  EXPECT_EQ(command("joint_1/position"), 1.6);
+
+  // the references pass through once the drive is enabled, per dof
+  state("joint_1/status_word") = SW_OPERATION_ENABLED;
+  update();
+  EXPECT_EQ(command("joint_1/position"), 3.0);
+  EXPECT_EQ(command("joint_1/velocity"), 3.0);
+  EXPECT_EQ(command("joint_1/effort"), 3.0);
+  EXPECT_EQ(command("joint_2/position"), -0.5);
+  EXPECT_EQ(command("joint_2/velocity"), 0.0);
+
+  // and are gated again if it leaves OPERATION_ENABLED
+  state("joint_1/status_word") = SW_FAULT;
+  update();
+  EXPECT_EQ(command("joint_1/position"), 1.6);
+  EXPECT_EQ(command("joint_1/velocity"), 0.0);
+}
+
+TEST_F(CiA402ControllerTest, DoesNotForwardStaleReferencesAfterReactivation)
+{
+  SetUpController({"velocity"});
+  ASSERT_EQ(controller_->on_activate(rclcpp_lifecycle::State()), CallbackReturn::SUCCESS);
+  state("joint_1/status_word") = SW_OPERATION_ENABLED;
+  reference_interfaces_[0].set_value(2.0);
+  update();
+  EXPECT_EQ(command("joint_1/velocity"), 2.0);
+
+  ASSERT_EQ(controller_->on_deactivate(rclcpp_lifecycle::State()), CallbackReturn::SUCCESS);
+  ASSERT_EQ(controller_->on_activate(rclcpp_lifecycle::State()), CallbackReturn::SUCCESS);
+  // no reference was written since the activation
+  update();
+  EXPECT_TRUE(std::isnan(command("joint_1/velocity")));
+  reference_interfaces_[0].set_value(-1.0);
+  update();
+  EXPECT_EQ(command("joint_1/velocity"), -1.0);
+}
@@ -0,0 +1,191 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Scaling of EthercatDriver with the number of slaves, on the simulated bus.
+// For each bus size a synthetic configuration is generated (one CiA402 drive in
+// DRIVE_PERIOD slaves, digital I/O terminals otherwise) and the driver is run through
+// on_init(), on_activate() and CYCLES read()/write() cycles. The costs are also given per
+// slave so that the paths growing faster than the bus show up.
+// usage: bench_scaling [num_slaves...]           default 10 30 100 300 1000
+//        bench_scaling --generate num_slaves dir  write the configuration for a real bus
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hardware_interface/component_parser.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_lifecycle/state.hpp"
+#include "ethercat_driver/ethercat_driver.hpp"
+#include "ethercat_interface/ec_sim_backend.hpp"
+#include "ethercat_interface/ec_sim_cia402_drive.hpp"
+#include "synthetic_bus.hpp"
+
+namespace
+{
+const size_t DRIVE_PERIOD = 4;
+const int CYCLES = 2000;
+/** on_activate() starts cycling the bus one second after the activation of the master */
+const double STARTUP_DELAY_S = 1.0;
+
+struct Result
+{
+  double init_ms = 0;
+  double activate_ms = 0;
+  long init_kb = 0;
+  long activate_kb = 0;
+  double cycle_cpu_us = 0;
+  double cycle_max_us = 0;
+};
+
+double now_s(clockid_t clock)
+{
+  struct timespec t;
+  clock_gettime(clock, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/** resident set size of the process, in kB */
+long rss_kb()
+{
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    if (key == "VmRSS:") {
+      long kb = 0;
+      status >> kb;
+      return kb;
+    }
+    status.ignore(256, '\n');
+  }
+  return 0;
+}
+
+bool run(size_t num_slaves, const std::string & dir, Result & result)
+{
+  ethercat_interface::sim::reset();
+  auto & sim = ethercat_interface::sim::master(0);
+  for (size_t i = 0; i < num_slaves; i++) {
+    if (synthetic_bus::isDrive(i, DRIVE_PERIOD)) {
+      sim.setSlaveModel(i, std::make_shared<ethercat_interface::sim::CiA402DriveModel>());
+    }
+  }
+  const auto infos = hardware_interface::parse_control_resources_from_urdf(
+    synthetic_bus::urdf(num_slaves, DRIVE_PERIOD, dir));
+
+  auto driver = std::make_unique<ethercat_driver::EthercatDriver>();
+  long rss = rss_kb();
+  double start = now_s(CLOCK_MONOTONIC);
+  if (driver->on_init(infos[0]) != CallbackReturn::SUCCESS) {
+    return false;
+  }
+  result.init_ms = (now_s(CLOCK_MONOTONIC) - start) * 1e3;
+  result.init_kb = rss_kb() - rss;
+
+  // the interfaces are bound as the resource manager does
+  auto states = driver->export_state_interfaces();
+  auto commands = driver->export_command_interfaces();
+
+  rss = rss_kb();
+  start = now_s(CLOCK_MONOTONIC);
+  if (driver->on_activate(rclcpp_lifecycle::State()) != CallbackReturn::SUCCESS) {
+    return false;
+  }
+  result.activate_ms = (now_s(CLOCK_MONOTONIC) - start - STARTUP_DELAY_S) * 1e3;
+  result.activate_kb = rss_kb() - rss;
+
+  const rclcpp::Time time(0);
+  const rclcpp::Duration period(0, 1000000);
+  double cpu = 0;
+  for (int i = 0; i < CYCLES; i++) {
+    const double cycle_start = now_s(CLOCK_THREAD_CPUTIME_ID);
+    driver->read(time, period);
+    driver->write(time, period);
+    const double cycle_cpu = now_s(CLOCK_THREAD_CPUTIME_ID) - cycle_start;
+    cpu += cycle_cpu;
+    result.cycle_max_us = std::max(result.cycle_max_us, cycle_cpu * 1e6);
+  }
+  result.cycle_cpu_us = cpu * 1e6 / CYCLES;
+
+  driver->on_deactivate(rclcpp_lifecycle::State());
+  driver.reset();
+  ethercat_interface::sim::reset();
+  return true;
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  if (argc == 4 && std::string(argv[1]) == "--generate") {
+    if (!synthetic_bus::write(std::strtoul(argv[2], NULL, 10), DRIVE_PERIOD, argv[3])) {
+      std::fprintf(stderr, "failed to write the configuration to %s\n", argv[3]);
+      return 1;
+    }
+    return 0;
+  }
+
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; i++) {
+    sizes.push_back(std::strtoul(argv[i], NULL, 10));
+  }
+  if (sizes.empty()) {
+    sizes = {10, 30, 100, 300, 1000};
+  }
+
+  char dir_template[] = "/tmp/bench_scaling_XXXXXX";
+  const char * dir = mkdtemp(dir_template);
+  if (dir == NULL || !synthetic_bus::write(0, DRIVE_PERIOD, dir)) {
+    std::fprintf(stderr, "failed to write the slave configurations\n");
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+  rclcpp::get_logger("EthercatDriver").set_level(rclcpp::Logger::Level::Warn);
+
+  std::printf(
+    "%8s %10s %13s %10s %13s %12s %12s | %10s %10s %12s\n", "slaves", "init [ms]",
+    "activate [ms]", "init [kB]", "activate [kB]", "cycle [us]", "max [us]",
+    "init [us]", "mem [kB]", "cycle [ns]");
+  std::printf("%84s | %s\n", "", "per slave");
+  int ret = 0;
+  for (size_t num_slaves : sizes) {
+    Result result;
+    if (num_slaves == 0 || !run(num_slaves, dir, result)) {
+      std::printf("%8zu failed\n", num_slaves);
+      ret = 1;
+      continue;
+    }
+    std::printf(
+      "%8zu %10.2f %13.2f %10ld %13ld %12.2f %12.2f | %10.2f %10.2f %12.1f\n", num_slaves,
+      result.init_ms, result.activate_ms, result.init_kb, result.activate_kb,
+      result.cycle_cpu_us, result.cycle_max_us,
+      result.init_ms * 1e3 / num_slaves,
+      static_cast<double>(result.init_kb + result.activate_kb) / num_slaves,
+      result.cycle_cpu_us * 1e3 / num_slaves);
+  }
+
+  rclcpp::shutdown();
+  std::remove((std::string(dir) + "/drive.yaml").c_str());
+  std::remove((std::string(dir) + "/io.yaml").c_str());
+  std::remove((std::string(dir) + "/synthetic_bus.urdf").c_str());
+  std::remove(dir);
+  return ret;
+}
@@ -0,0 +1,135 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SYNTHETIC_BUS_HPP_
+#define SYNTHETIC_BUS_HPP_
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/** Synthetic bus configurations: a ros2_control description with num_slaves modules
+ *  and the slave configuration files it refers to. One module in drive_period is a
+ *  CiA402 drive on a joint, the others are digital I/O terminals on gpios. */
+namespace synthetic_bus
+{
+
+const char DRIVE_CONFIG[] =
+  R"(# synthetic CiA402 drive
+vendor_id: 0x00000011
+product_id: 0x07030924
+rpdo:
+  - index: 0x1607
+    channels:
+      - {index: 0x607a, sub_index: 0, type: int32, command_interface: position, default: .nan}
+      - {index: 0x60ff, sub_index: 0, type: int32, command_interface: velocity, default: 0}
+      - {index: 0x6071, sub_index: 0, type: int16, command_interface: effort, default: 0}
+      - {index: 0x6040, sub_index: 0, type: uint16, command_interface: ~, default: 0}
+      - {index: 0x6060, sub_index: 0, type: int8, command_interface: ~, default: 8}
+tpdo:
+  - index: 0x1a07
+    channels:
+      - {index: 0x6064, sub_index: 0, type: int32, state_interface: position}
+      - {index: 0x606c, sub_index: 0, type: int32, state_interface: velocity}
+      - {index: 0x6077, sub_index: 0, type: int16, state_interface: effort}
+      - {index: 0x6041, sub_index: 0, type: uint16, state_interface: ~}
+      - {index: 0x6061, sub_index: 0, type: int8, state_interface: ~}
+sm:
+  - {index: 0, type: output, pdo: ~, watchdog: disable}
+  - {index: 1, type: input, pdo: ~, watchdog: disable}
+  - {index: 2, type: output, pdo: rpdo, watchdog: enable}
+  - {index: 3, type: input, pdo: tpdo, watchdog: disable}
+)";
+
+const char IO_CONFIG[] =
+  R"(# synthetic digital I/O terminal, 8 outputs and 8 inputs
+vendor_id: 0x00000002
+product_id: 0x07d83052
+rpdo:
+  - index: 0x1600
+    channels:
+      - {index: 0x7000, sub_index: 1, type: uint8, command_interface: d_output}
+tpdo:
+  - index: 0x1a00
+    channels:
+      - {index: 0x6000, sub_index: 1, type: uint8, state_interface: d_input}
+sm:
+  - {index: 0, type: output, pdo: rpdo, watchdog: enable}
+  - {index: 1, type: input, pdo: tpdo, watchdog: disable}
+)";
+
+inline bool isDrive(size_t position, size_t drive_period)
+{
+  return drive_period > 0 && position % drive_period == 0;
+}
+
+/** ros2_control description of the bus, the slave configurations are looked up in dir */
+inline std::string urdf(
+  size_t num_slaves, size_t drive_period, const std::string & dir,
+  double control_frequency = 1000)
+{
+  std::ostringstream urdf;
+  urdf << "<?xml version=\"1.0\"?>\n<robot name=\"synthetic_bus\">\n"
+       << "  <ros2_control name=\"synthetic_bus\" type=\"system\">\n"
+       << "    <hardware>\n"
+       << "      <plugin>ethercat_driver/EthercatDriver</plugin>\n"
+       << "      <param name=\"master_id\">0</param>\n"
+       << "      <param name=\"control_frequency\">" << control_frequency << "</param>\n"
+       << "    </hardware>\n";
+  for (size_t i = 0; i < num_slaves; i++) {
+    if (isDrive(i, drive_period)) {
+      urdf << "    <joint name=\"joint_" << i << "\">\n"
+           << "      <state_interface name=\"position\"/>\n"
+           << "      <state_interface name=\"velocity\"/>\n"
+           << "      <command_interface name=\"position\"/>\n"
+           << "      <ec_module name=\"drive_" << i << "\">\n"
+           << "        <plugin>ethercat_generic_plugins/EcCiA402Drive</plugin>\n"
+           << "        <param name=\"alias\">0</param>\n"
+           << "        <param name=\"position\">" << i << "</param>\n"
+           << "        <param name=\"mode_of_operation\">8</param>\n"
+           << "        <param name=\"slave_config\">" << dir << "/drive.yaml</param>\n"
+           << "      </ec_module>\n"
+           << "    </joint>\n";
+    } else {
+      urdf << "    <gpio name=\"io_" << i << "\">\n"
+           << "      <command_interface name=\"d_output\"/>\n"
+           << "      <state_interface name=\"d_input\"/>\n"
+           << "      <ec_module name=\"io_" << i << "\">\n"
+           << "        <plugin>ethercat_generic_plugins/GenericEcSlave</plugin>\n"
+           << "        <param name=\"alias\">0</param>\n"
+           << "        <param name=\"position\">" << i << "</param>\n"
+           << "        <param name=\"slave_config\">" << dir << "/io.yaml</param>\n"
+           << "      </ec_module>\n"
+           << "    </gpio>\n";
+    }
+  }
+  urdf << "  </ros2_control>\n</robot>\n";
+  return urdf.str();
+}
+
+/** write the slave configurations and the description of the bus to dir */
+inline bool write(size_t num_slaves, size_t drive_period, const std::string & dir)
+{
+  std::ofstream drive(dir + "/drive.yaml");
+  std::ofstream io(dir + "/io.yaml");
+  std::ofstream description(dir + "/synthetic_bus.urdf");
+  drive << DRIVE_CONFIG;
+  io << IO_CONFIG;
+  description << urdf(num_slaves, drive_period, dir);
+  return drive.good() && io.good() && description.good();
+}
+
+}  // namespace synthetic_bus
+
+#endif  // SYNTHETIC_BUS_HPP_
@@ -16,31 +16,48 @@
 #define ETHERCAT_DRIVER__ETHERCAT_DRIVER_HPP_
 
 #include <unordered_map>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
+#include <thread>
 #include <pluginlib/class_loader.hpp>
 #include "hardware_interface/handle.hpp"
 #include "hardware_interface/hardware_info.hpp"
 #include "hardware_interface/system_interface.hpp"
 #include "hardware_interface/types/hardware_interface_return_values.hpp"
 #include "rclcpp/macros.hpp"
+#include "rclcpp/node.hpp"
+#include "rclcpp/executors/single_threaded_executor.hpp"
 #include "rclcpp_lifecycle/node_interfaces/lifecycle_node_interface.hpp"
 #include "rclcpp_lifecycle/state.hpp"
 #include "ethercat_driver/visibility_control.h"
 #include "ethercat_interface/ec_slave.hpp"
 #include "ethercat_interface/ec_master.hpp"
+#include "ethercat_interface/ec_shm_commands.hpp"
+#include "ethercat_interface/ec_command_schedule.hpp"
+#include "ethercat_interface/ec_axis_coupling.hpp"
+#include "ethercat_interface/ec_interlock.hpp"
+#include "ethercat_msgs/srv/set_channel_parameters.hpp"
+#include "ethercat_msgs/srv/load_pvt_trajectory.hpp"
+#include "ethercat_msgs/srv/load_cam_table.hpp"
 
 using CallbackReturn = rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn;
 
 namespace ethercat_driver
 {
+using SetChannelParametersSrv = ethercat_msgs::srv::SetChannelParameters;
+using LoadPvtTrajectorySrv = ethercat_msgs::srv::LoadPvtTrajectory;
+using LoadCamTableSrv = ethercat_msgs::srv::LoadCamTable;
 
 class EthercatDriver : public hardware_interface::SystemInterface
 {
 public:
   RCLCPP_SHARED_PTR_DEFINITIONS(EthercatDriver)
 
+  ETHERCAT_DRIVER_PUBLIC
+  ~EthercatDriver();
+
   ETHERCAT_DRIVER_PUBLIC
   CallbackReturn on_init(const hardware_interface::HardwareInfo & info) override;
 
@@ -59,6 +76,16 @@ public:
   ETHERCAT_DRIVER_PUBLIC
   CallbackReturn on_deactivate(const rclcpp_lifecycle::State & previous_state) override;
 
+  ETHERCAT_DRIVER_PUBLIC
+  hardware_interface::return_type prepare_command_mode_switch(
+    const std::vector<std::string> & start_interfaces,
+    const std::vector<std::string> & stop_interfaces) override;
+
+  ETHERCAT_DRIVER_PUBLIC
+  hardware_interface::return_type perform_command_mode_switch(
+    const std::vector<std::string> & start_interfaces,
+    const std::vector<std::string> & stop_interfaces) override;
+
   ETHERCAT_DRIVER_PUBLIC
   hardware_interface::return_type read(const rclcpp::Time &, const rclcpp::Duration &) override;
 
@@ -69,8 +96,79 @@ private:
   std::vector<std::unordered_map<std::string, std::string>> getEcModuleParam(
     std::string & urdf, std::string component_name, std::string component_type);
 
+  /** node serving the runtime services of the driver, spun in its own thread */
+  void start_driver_node();
+  void set_channel_parameters_callback(
+    const std::shared_ptr<SetChannelParametersSrv::Request> request,
+    std::shared_ptr<SetChannelParametersSrv::Response> response);
+  void load_pvt_trajectory_callback(
+    const std::shared_ptr<LoadPvtTrajectorySrv::Request> request,
+    std::shared_ptr<LoadPvtTrajectorySrv::Response> response);
+  void load_cam_table_callback(
+    const std::shared_ptr<LoadCamTableSrv::Request> request,
+    std::shared_ptr<LoadCamTableSrv::Response> response);
+
+  /** bus cycle loop of the bus-rate mode, run in bus_thread_ */
+  void bus_loop();
+  /** substitute the fresh external commands to the ROS commands for a bus cycle */
+  void applyShmCommands();
+  /** restore the ROS commands after the bus cycle */
+  void restoreShmCommands();
+  /** queue the scheduled command interfaces as a batch if the controller set a due key */
+  void scheduleCommands();
+  /** substitute the scheduled commands to the ROS commands for the bus cycle of the given
+   *  number, after applying the batches due */
+  void applyScheduledCommands(uint64_t cycle);
+  /** restore the ROS commands after the bus cycle */
+  void restoreScheduledCommands();
+  /** report the bus cycle and the schedule to the states of the schedule component */
+  void readScheduleStates();
+  /** report the cycle start statistics to the states of the statistics component */
+  void readStatisticsStates();
+  /** set up the couplings declared by the gpios with a coupling_leader parameter */
+  bool setupCouplings(
+    std::vector<std::vector<double>> & joint_states,
+    std::vector<std::vector<double>> & sensor_states,
+    std::vector<std::vector<double>> & gpio_states,
+    std::vector<std::vector<double>> & joint_commands,
+    std::vector<std::vector<double>> & sensor_commands,
+    std::vector<std::vector<double>> & gpio_commands);
+  /** substitute the coupled targets to the follower commands for the bus cycle, from the
+   *  leader positions received in this cycle */
+  void applyCouplings();
+  /** restore the follower commands after the bus cycle */
+  void restoreCouplings();
+  /** command value of the interface "component/interface" in the given vectors,
+   *  NULL if there is no such interface */
+  double * findCommandInterface(
+    const std::string & interface,
+    std::vector<std::vector<double>> & joint_commands,
+    std::vector<std::vector<double>> & sensor_commands,
+    std::vector<std::vector<double>> & gpio_commands);
+  /** state value of the interface "component/interface" in the given vectors,
+   *  NULL if there is no such interface */
+  double * findStateInterface(
+    const std::string & interface,
+    std::vector<std::vector<double>> & joint_states,
+    std::vector<std::vector<double>> & sensor_states,
+    std::vector<std::vector<double>> & gpio_states);
+  /** copy interface values between vectors of the same layout, without allocating */
+  static void copyInterfaces(
+    const std::vector<std::vector<double>> & from,
+    std::vector<std::vector<double>> & to);
+
+  /** interfaces of the component that match the prefix "component_name/", without prefix */
+  std::vector<std::string> componentInterfaces(
+    const std::string & component_name,
+    const std::vector<std::string> & interfaces);
+
   std::vector<std::shared_ptr<ethercat_interface::EcSlave>> ec_modules_;
   std::vector<std::unordered_map<std::string, std::string>> ec_module_parameters_;
+  /** name of the ros2_control component each module belongs to */
+  std::vector<std::string> ec_module_components_;
+  /** per module interfaces of the prepared command mode switch */
+  std::vector<std::vector<std::string>> switch_start_interfaces_;
+  std::vector<std::vector<std::string>> switch_stop_interfaces_;
 
   std::vector<std::vector<double>> hw_joint_commands_;
   std::vector<std::vector<double>> hw_sensor_commands_;
@@ -82,10 +180,96 @@ private:
   pluginlib::ClassLoader<ethercat_interface::EcSlave> ec_loader_{
     "ethercat_interface", "ethercat_interface::EcSlave"};
 
+  /** bus-rate mode, if bus_frequency_ > 0: the bus runs in its own thread and the
+   *  slaves work on mirrors of the interfaces, handed over at read() and write() */
+  std::vector<std::vector<double>> bus_joint_commands_;
+  std::vector<std::vector<double>> bus_sensor_commands_;
+  std::vector<std::vector<double>> bus_gpio_commands_;
+  std::vector<std::vector<double>> bus_joint_states_;
+  std::vector<std::vector<double>> bus_sensor_states_;
+  std::vector<std::vector<double>> bus_gpio_states_;
+
   int control_frequency_;
+  double bus_frequency_ = 0;
+  int bus_thread_priority_ = 0;
   ethercat_interface::EcMaster master_;
   std::mutex ec_mutex_;
   bool activated_;
+  std::atomic<bool> bus_running_{false};
+  std::thread bus_thread_;
+
+  /** command interfaces that external processes can write through shared memory */
+  std::string shm_commands_name_;
+  std::vector<std::string> shm_command_interfaces_;
+  ethercat_interface::ShmCommandChannels shm_commands_;
+  /** external commands older than the timeout give way to the ROS commands */
+  uint64_t shm_command_timeout_ns_ = 1000000;
+  /** per channel: command value used by the slaves, last external value and its stamp,
+   *  ROS value overridden during the bus cycle */
+  std::vector<double *> shm_command_targets_;
+  std::vector<double> shm_command_values_;
+  std::vector<uint64_t> shm_command_stamps_;
+  std::vector<double> shm_command_saved_;
+
+  /** command interfaces applied as batches at a bus cycle or DC time, see scheduleCommands().
+   *  per interface: command value used by the slaves, value set by the controller,
+   *  value of the last batch applied, ROS value overridden during the bus cycle */
+  std::vector<std::string> scheduled_command_interfaces_;
+  std::vector<double *> scheduled_command_targets_;
+  std::vector<double *> scheduled_command_sources_;
+  std::vector<double> scheduled_command_values_;
+  std::vector<double> scheduled_command_saved_;
+  std::vector<double> scheduled_command_batch_;
+  ethercat_interface::CommandSchedule cycle_schedule_;
+  ethercat_interface::CommandSchedule time_schedule_;
+  uint64_t dropped_batches_ = 0;
+  /** interfaces of the schedule component, NULL if not declared */
+  double * scheduled_cycle_command_ = NULL;
+  double * scheduled_time_command_ = NULL;
+  double * bus_cycle_state_ = NULL;
+  double * bus_time_state_ = NULL;
+  double * pending_batches_state_ = NULL;
+  double * dropped_batches_state_ = NULL;
+
+  /** cycle start statistics of the cycles waited for by the driver, taken under ec_mutex_ */
+  ethercat_interface::EcMaster::WakeupStatistics wakeup_statistics_;
+  /** interfaces of the statistics component, NULL if not declared */
+  double * wakeups_state_ = NULL;
+  double * wakeup_lateness_state_ = NULL;
+  double * wakeup_lateness_min_state_ = NULL;
+  double * wakeup_lateness_max_state_ = NULL;
+  double * wakeup_lateness_mean_state_ = NULL;
+  double * wakeup_jitter_state_ = NULL;
+  double * spin_guard_state_ = NULL;
+
+  /** follower command interface coupled to a leader state interface, see AxisCoupling.
+   *  the interfaces are the ones the slaves work on */
+  struct Coupling
+  {
+    std::string name;
+    std::shared_ptr<ethercat_interface::AxisCoupling> coupling;
+    double * leader = NULL;
+    double * follower_command = NULL;
+    double * follower_state = NULL;
+    /** interfaces of the coupling component, NULL if not declared */
+    double * engage_command = NULL;
+    double * state = NULL;
+    double * scale = NULL;
+    /** ROS value overridden during the bus cycle */
+    double saved = 0;
+  };
+  std::vector<Coupling> couplings_;
+  /** period of the bus cycles the couplings are evaluated at, in s */
+  double coupling_period_ = 0.01;
+  /** rules forcing the commands after the couplings, in the bus cycle */
+  ethercat_interface::InterlockEngine interlocks_;
+
+  rclcpp::Node::SharedPtr driver_node_;
+  std::shared_ptr<rclcpp::executors::SingleThreadedExecutor> driver_executor_;
+  std::thread driver_node_thread_;
+  rclcpp::Service<SetChannelParametersSrv>::SharedPtr set_channel_parameters_srv_;
+  rclcpp::Service<LoadPvtTrajectorySrv>::SharedPtr load_pvt_trajectory_srv_;
+  rclcpp::Service<LoadCamTableSrv>::SharedPtr load_cam_table_srv_;
 };
 }  // namespace ethercat_driver
 
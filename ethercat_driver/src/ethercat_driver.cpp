@@ -14,15 +14,36 @@
 
 #include "ethercat_driver/ethercat_driver.hpp"
 
+#include <pthread.h>
+#include <sched.h>
 #include <tinyxml2.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <string>
+#include <sstream>
 #include <regex>
+#include <utility>
 
 #include "hardware_interface/types/hardware_interface_type_values.hpp"
 #include "rclcpp/rclcpp.hpp"
 
 namespace ethercat_driver
 {
+EthercatDriver::~EthercatDriver()
+{
+  bus_running_ = false;
+  if (bus_thread_.joinable()) {
+    bus_thread_.join();
+  }
+  if (driver_executor_) {
+    driver_executor_->cancel();
+  }
+  if (driver_node_thread_.joinable()) {
+    driver_node_thread_.join();
+  }
+}
+
 CallbackReturn EthercatDriver::on_init(
   const hardware_interface::HardwareInfo & info)
 {
@@ -70,6 +91,39 @@ CallbackReturn EthercatDriver::on_init(
       std::numeric_limits<double>::quiet_NaN());
   }
 
+  if (info_.hardware_parameters.find("bus_frequency") != info_.hardware_parameters.end()) {
+    bus_frequency_ = std::stod(info_.hardware_parameters["bus_frequency"]);
+  }
+  if (info_.hardware_parameters.find("bus_thread_priority") != info_.hardware_parameters.end()) {
+    bus_thread_priority_ = std::stoi(info_.hardware_parameters["bus_thread_priority"]);
+  }
+  if (bus_frequency_ > 0) {
+    bus_joint_states_ = hw_joint_states_;
+    bus_sensor_states_ = hw_sensor_states_;
+    bus_gpio_states_ = hw_gpio_states_;
+    bus_joint_commands_ = hw_joint_commands_;
+    bus_sensor_commands_ = hw_sensor_commands_;
+    bus_gpio_commands_ = hw_gpio_commands_;
+  }
+  // cycle rate of the slaves, given to the modules
+  double module_bus_frequency = bus_frequency_;
+  if (module_bus_frequency <= 0) {
+    module_bus_frequency = 100;
+    if (info_.hardware_parameters.find("control_frequency") != info_.hardware_parameters.end()) {
+      module_bus_frequency = std::stod(info_.hardware_parameters["control_frequency"]);
+    }
+  }
+
+  coupling_period_ = 1.0 / module_bus_frequency;
+
+  // interfaces the slaves work on
+  auto & joint_states = bus_frequency_ > 0 ? bus_joint_states_ : hw_joint_states_;
+  auto & sensor_states = bus_frequency_ > 0 ? bus_sensor_states_ : hw_sensor_states_;
+  auto & gpio_states = bus_frequency_ > 0 ? bus_gpio_states_ : hw_gpio_states_;
+  auto & joint_commands = bus_frequency_ > 0 ? bus_joint_commands_ : hw_joint_commands_;
+  auto & sensor_commands = bus_frequency_ > 0 ? bus_sensor_commands_ : hw_sensor_commands_;
+  auto & gpio_commands = bus_frequency_ > 0 ? bus_gpio_commands_ : hw_gpio_commands_;
+
   for (uint j = 0; j < info_.joints.size(); j++) {
     RCLCPP_INFO(rclcpp::get_logger("EthercatDriver"), "joints");
     // check all joints for EC modules and load into ec_modules_
@@ -77,6 +131,7 @@ CallbackReturn EthercatDriver::on_init(
     ec_module_parameters_.insert(
       ec_module_parameters_.end(), module_params.begin(), module_params.end());
     for (auto i = 0ul; i < module_params.size(); i++) {
+      module_params[i]["bus_frequency"] = std::to_string(module_bus_frequency);
       for (auto k = 0ul; k < info_.joints[j].state_interfaces.size(); k++) {
         module_params[i]["state_interface/" +
           info_.joints[j].state_interfaces[k].name] = std::to_string(k);
@@ -88,7 +143,7 @@ CallbackReturn EthercatDriver::on_init(
       try {
         auto module = ec_loader_.createSharedInstance(module_params[i].at("plugin"));
         if (!module->setupSlave(
-            module_params[i], &hw_joint_states_[j], &hw_joint_commands_[j]))
+            module_params[i], &joint_states[j], &joint_commands[j]))
         {
           RCLCPP_FATAL(
             rclcpp::get_logger("EthercatDriver"),
@@ -96,6 +151,7 @@ CallbackReturn EthercatDriver::on_init(
           return CallbackReturn::ERROR;
         }
         ec_modules_.push_back(module);
+        ec_module_components_.push_back(info_.joints[j].name);
       } catch (pluginlib::PluginlibException & ex) {
         RCLCPP_FATAL(
           rclcpp::get_logger("EthercatDriver"),
@@ -111,6 +167,7 @@ CallbackReturn EthercatDriver::on_init(
     ec_module_parameters_.insert(
       ec_module_parameters_.end(), module_params.begin(), module_params.end());
     for (auto i = 0ul; i < module_params.size(); i++) {
+      module_params[i]["bus_frequency"] = std::to_string(module_bus_frequency);
       for (auto k = 0ul; k < info_.gpios[g].state_interfaces.size(); k++) {
         module_params[i]["state_interface/" +
           info_.gpios[g].state_interfaces[k].name] = std::to_string(k);
@@ -122,7 +179,7 @@ CallbackReturn EthercatDriver::on_init(
       try {
         auto module = ec_loader_.createSharedInstance(module_params[i].at("plugin"));
         if (!module->setupSlave(
-            module_params[i], &hw_gpio_states_[g], &hw_gpio_commands_[g]))
+            module_params[i], &gpio_states[g], &gpio_commands[g]))
         {
           RCLCPP_FATAL(
             rclcpp::get_logger("EthercatDriver"),
@@ -130,6 +187,7 @@ CallbackReturn EthercatDriver::on_init(
           return CallbackReturn::ERROR;
         }
         ec_modules_.push_back(module);
+        ec_module_components_.push_back(info_.gpios[g].name);
       } catch (pluginlib::PluginlibException & ex) {
         RCLCPP_FATAL(
           rclcpp::get_logger("EthercatDriver"),
@@ -145,6 +203,7 @@ CallbackReturn EthercatDriver::on_init(
     ec_module_parameters_.insert(
       ec_module_parameters_.end(), module_params.begin(), module_params.end());
     for (auto i = 0ul; i < module_params.size(); i++) {
+      module_params[i]["bus_frequency"] = std::to_string(module_bus_frequency);
       for (auto k = 0ul; k < info_.sensors[s].state_interfaces.size(); k++) {
         module_params[i]["state_interface/" +
           info_.sensors[s].state_interfaces[k].name] = std::to_string(k);
@@ -156,7 +215,7 @@ CallbackReturn EthercatDriver::on_init(
       try {
         auto module = ec_loader_.createSharedInstance(module_params[i].at("plugin"));
         if (!module->setupSlave(
-            module_params[i], &hw_sensor_states_[s], &hw_sensor_commands_[s]))
+            module_params[i], &sensor_states[s], &sensor_commands[s]))
         {
           RCLCPP_FATAL(
             rclcpp::get_logger("EthercatDriver"),
@@ -164,6 +223,7 @@ CallbackReturn EthercatDriver::on_init(
           return CallbackReturn::ERROR;
         }
         ec_modules_.push_back(module);
+        ec_module_components_.push_back(info_.sensors[s].name);
       } catch (pluginlib::PluginlibException & ex) {
         RCLCPP_FATAL(
           rclcpp::get_logger("EthercatDriver"),
@@ -175,15 +235,480 @@ CallbackReturn EthercatDriver::on_init(
 
   RCLCPP_INFO(rclcpp::get_logger("EthercatDriver"), "Got %li modules", ec_modules_.size());
 
+  // command interfaces open to external processes
+  if (info_.hardware_parameters.find("shm_commands") != info_.hardware_parameters.end()) {
+    shm_commands_name_ = info_.hardware_parameters["shm_commands"];
+    if (info_.hardware_parameters.find("shm_command_timeout_us") !=
+      info_.hardware_parameters.end())
+    {
+      shm_command_timeout_ns_ =
+        std::stoul(info_.hardware_parameters["shm_command_timeout_us"]) * 1000;
+    }
+    std::istringstream interfaces(info_.hardware_parameters["shm_command_interfaces"]);
+    std::string interface;
+    while (interfaces >> interface) {
+      double * target = findCommandInterface(
+        interface, joint_commands, sensor_commands, gpio_commands);
+      if (target == NULL) {
+        RCLCPP_FATAL(
+          rclcpp::get_logger("EthercatDriver"),
+          "Shared memory command interface %s not found.", interface.c_str());
+        return CallbackReturn::ERROR;
+      }
+      shm_command_interfaces_.push_back(interface);
+      shm_command_targets_.push_back(target);
+    }
+    if (shm_command_interfaces_.size() > ethercat_interface::ShmCommandChannels::MAX_CHANNELS) {
+      RCLCPP_FATAL(
+        rclcpp::get_logger("EthercatDriver"), "Too many shared memory command interfaces.");
+      return CallbackReturn::ERROR;
+    }
+    shm_command_values_.resize(shm_command_targets_.size());
+    shm_command_stamps_.resize(shm_command_targets_.size(), 0);
+    shm_command_saved_.resize(shm_command_targets_.size());
+  }
+
+  // command interfaces applied at a scheduled bus cycle
+  if (info_.hardware_parameters.find("scheduled_command_interfaces") !=
+    info_.hardware_parameters.end())
+  {
+    std::istringstream interfaces(info_.hardware_parameters["scheduled_command_interfaces"]);
+    std::string interface;
+    while (interfaces >> interface) {
+      double * target = findCommandInterface(
+        interface, joint_commands, sensor_commands, gpio_commands);
+      if (target == NULL) {
+        RCLCPP_FATAL(
+          rclcpp::get_logger("EthercatDriver"),
+          "Scheduled command interface %s not found.", interface.c_str());
+        return CallbackReturn::ERROR;
+      }
+      scheduled_command_interfaces_.push_back(interface);
+      scheduled_command_targets_.push_back(target);
+      scheduled_command_sources_.push_back(
+        findCommandInterface(
+          interface, hw_joint_commands_, hw_sensor_commands_, hw_gpio_commands_));
+    }
+    scheduled_command_values_.resize(
+      scheduled_command_targets_.size(), std::numeric_limits<double>::quiet_NaN());
+    scheduled_command_saved_.resize(scheduled_command_targets_.size());
+    scheduled_command_batch_.resize(scheduled_command_targets_.size());
+
+    size_t queue_size = 16;
+    if (info_.hardware_parameters.find("schedule_queue_size") !=
+      info_.hardware_parameters.end())
+    {
+      queue_size = std::stoul(info_.hardware_parameters["schedule_queue_size"]);
+    }
+    cycle_schedule_.configure(scheduled_command_targets_.size(), queue_size);
+    time_schedule_.configure(scheduled_command_targets_.size(), queue_size);
+
+    // gpio without module carrying the due keys and the bus cycle
+    const std::string component = info_.hardware_parameters["schedule_component"];
+    for (uint g = 0; g < info_.gpios.size(); g++) {
+      if (info_.gpios[g].name != component) {
+        continue;
+      }
+      for (auto k = 0ul; k < info_.gpios[g].command_interfaces.size(); k++) {
+        const std::string & name = info_.gpios[g].command_interfaces[k].name;
+        if (name == "scheduled_cycle") {
+          scheduled_cycle_command_ = &hw_gpio_commands_[g][k];
+        } else if (name == "scheduled_time") {
+          scheduled_time_command_ = &hw_gpio_commands_[g][k];
+        }
+      }
+      for (auto k = 0ul; k < info_.gpios[g].state_interfaces.size(); k++) {
+        const std::string & name = info_.gpios[g].state_interfaces[k].name;
+        if (name == "bus_cycle") {
+          bus_cycle_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "bus_time") {
+          bus_time_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "pending_batches") {
+          pending_batches_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "dropped_batches") {
+          dropped_batches_state_ = &hw_gpio_states_[g][k];
+        }
+      }
+    }
+    if (scheduled_cycle_command_ == NULL && scheduled_time_command_ == NULL) {
+      RCLCPP_FATAL(
+        rclcpp::get_logger("EthercatDriver"),
+        "Schedule component '%s' has no scheduled_cycle or scheduled_time command interface.",
+        component.c_str());
+      return CallbackReturn::ERROR;
+    }
+  }
+
+  // gpio without module reporting the cycle start statistics
+  if (info_.hardware_parameters.find("statistics_component") !=
+    info_.hardware_parameters.end())
+  {
+    const std::string component = info_.hardware_parameters["statistics_component"];
+    for (uint g = 0; g < info_.gpios.size(); g++) {
+      if (info_.gpios[g].name != component) {
+        continue;
+      }
+      for (auto k = 0ul; k < info_.gpios[g].state_interfaces.size(); k++) {
+        const std::string & name = info_.gpios[g].state_interfaces[k].name;
+        if (name == "wakeups") {
+          wakeups_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "wakeup_lateness") {
+          wakeup_lateness_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "wakeup_lateness_min") {
+          wakeup_lateness_min_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "wakeup_lateness_max") {
+          wakeup_lateness_max_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "wakeup_lateness_mean") {
+          wakeup_lateness_mean_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "wakeup_jitter") {
+          wakeup_jitter_state_ = &hw_gpio_states_[g][k];
+        } else if (name == "spin_guard") {
+          spin_guard_state_ = &hw_gpio_states_[g][k];
+        }
+      }
+    }
+  }
+
+  if (!setupCouplings(
+      joint_states, sensor_states, gpio_states, joint_commands, sensor_commands, gpio_commands))
+  {
+    return CallbackReturn::ERROR;
+  }
+
+  if (info_.hardware_parameters.find("interlocks") != info_.hardware_parameters.end()) {
+    const std::string file = info_.hardware_parameters["interlocks"];
+    // the conditions may also test the commands, e.g. the enabling of another output
+    auto inputs = [&](const std::string & name) {
+        double * value = findStateInterface(name, joint_states, sensor_states, gpio_states);
+        if (value == NULL) {
+          value = findCommandInterface(name, joint_commands, sensor_commands, gpio_commands);
+        }
+        return value;
+      };
+    auto outputs = [&](const std::string & name) {
+        return findCommandInterface(name, joint_commands, sensor_commands, gpio_commands);
+      };
+    std::string error;
+    try {
+      if (!interlocks_.load(YAML::LoadFile(file)["interlocks"], inputs, outputs, error)) {
+        RCLCPP_FATAL(
+          rclcpp::get_logger("EthercatDriver"), "Invalid interlock in %s: %s",
+          file.c_str(), error.c_str());
+        return CallbackReturn::ERROR;
+      }
+    } catch (const YAML::Exception & ex) {
+      RCLCPP_FATAL(
+        rclcpp::get_logger("EthercatDriver"), "Failed to load the interlocks %s: %s",
+        file.c_str(), ex.what());
+      return CallbackReturn::ERROR;
+    }
+    RCLCPP_INFO(
+      rclcpp::get_logger("EthercatDriver"), "%zu interlocks compiled into %zu instructions",
+      interlocks_.size(), interlocks_.instructions());
+  }
+
   return CallbackReturn::SUCCESS;
 }
 
+bool EthercatDriver::setupCouplings(
+  std::vector<std::vector<double>> & joint_states,
+  std::vector<std::vector<double>> & sensor_states,
+  std::vector<std::vector<double>> & gpio_states,
+  std::vector<std::vector<double>> & joint_commands,
+  std::vector<std::vector<double>> & sensor_commands,
+  std::vector<std::vector<double>> & gpio_commands)
+{
+  // gpios without module carrying the parameters and the engagement of a coupling
+  for (uint g = 0; g < info_.gpios.size(); g++) {
+    auto & params = info_.gpios[g].parameters;
+    if (params.find("coupling_leader") == params.end()) {
+      continue;
+    }
+    Coupling coupling;
+    coupling.name = info_.gpios[g].name;
+    coupling.coupling = std::make_shared<ethercat_interface::AxisCoupling>();
+    const std::string follower = params["coupling_follower"];
+    const std::string follower_state = params.find("coupling_follower_state") != params.end() ?
+      params["coupling_follower_state"] : follower;
+    coupling.leader = findStateInterface(
+      params["coupling_leader"], joint_states, sensor_states, gpio_states);
+    coupling.follower_command = findCommandInterface(
+      follower, joint_commands, sensor_commands, gpio_commands);
+    coupling.follower_state = findStateInterface(
+      follower_state, joint_states, sensor_states, gpio_states);
+    if (coupling.leader == NULL || coupling.follower_command == NULL ||
+      coupling.follower_state == NULL)
+    {
+      RCLCPP_FATAL(
+        rclcpp::get_logger("EthercatDriver"),
+        "Coupling %s: leader state %s, follower command %s or follower state %s not found.",
+        coupling.name.c_str(), params["coupling_leader"].c_str(), follower.c_str(),
+        follower_state.c_str());
+      return false;
+    }
+
+    if (params.find("gear_ratio") != params.end()) {
+      coupling.coupling->setRatio(std::stod(params["gear_ratio"]));
+    }
+    double engage_ramp = 0;
+    if (params.find("engage_ramp") != params.end()) {
+      engage_ramp = std::stod(params["engage_ramp"]);
+    }
+    double disengage_ramp = engage_ramp;
+    if (params.find("disengage_ramp") != params.end()) {
+      disengage_ramp = std::stod(params["disengage_ramp"]);
+    }
+    coupling.coupling->setRamps(engage_ramp, disengage_ramp);
+
+    // initial cam table, as space separated positions
+    if (params.find("cam_leader") != params.end()) {
+      ethercat_interface::CamTable cam;
+      std::istringstream leader(params["cam_leader"]);
+      std::istringstream follower_positions(params["cam_follower"]);
+      double value;
+      while (leader >> value) {
+        cam.leader.push_back(value);
+      }
+      while (follower_positions >> value) {
+        cam.follower.push_back(value);
+      }
+      cam.periodic = params["cam_periodic"] == "true";
+      if (!coupling.coupling->loadCamTable(cam)) {
+        RCLCPP_FATAL(
+          rclcpp::get_logger("EthercatDriver"),
+          "Coupling %s: invalid cam table.", coupling.name.c_str());
+        return false;
+      }
+    }
+
+    for (auto k = 0ul; k < info_.gpios[g].command_interfaces.size(); k++) {
+      if (info_.gpios[g].command_interfaces[k].name == "engage") {
+        coupling.engage_command = &gpio_commands[g][k];
+      }
+    }
+    for (auto k = 0ul; k < info_.gpios[g].state_interfaces.size(); k++) {
+      const std::string & name = info_.gpios[g].state_interfaces[k].name;
+      if (name == "coupling_state") {
+        coupling.state = &gpio_states[g][k];
+      } else if (name == "coupling_scale") {
+        coupling.scale = &gpio_states[g][k];
+      }
+    }
+    couplings_.push_back(coupling);
+    RCLCPP_INFO(
+      rclcpp::get_logger("EthercatDriver"), "Coupling %s: %s follows %s",
+      coupling.name.c_str(), follower.c_str(), params["coupling_leader"].c_str());
+  }
+  return true;
+}
+
+double * EthercatDriver::findStateInterface(
+  const std::string & interface,
+  std::vector<std::vector<double>> & joint_states,
+  std::vector<std::vector<double>> & sensor_states,
+  std::vector<std::vector<double>> & gpio_states)
+{
+  for (uint j = 0; j < info_.joints.size(); j++) {
+    for (auto k = 0ul; k < info_.joints[j].state_interfaces.size(); k++) {
+      if (interface == info_.joints[j].name + "/" + info_.joints[j].state_interfaces[k].name) {
+        return &joint_states[j][k];
+      }
+    }
+  }
+  for (uint g = 0; g < info_.gpios.size(); g++) {
+    for (auto k = 0ul; k < info_.gpios[g].state_interfaces.size(); k++) {
+      if (interface == info_.gpios[g].name + "/" + info_.gpios[g].state_interfaces[k].name) {
+        return &gpio_states[g][k];
+      }
+    }
+  }
+  for (uint s = 0; s < info_.sensors.size(); s++) {
+    for (auto k = 0ul; k < info_.sensors[s].state_interfaces.size(); k++) {
+      if (interface == info_.sensors[s].name + "/" + info_.sensors[s].state_interfaces[k].name) {
+        return &sensor_states[s][k];
+      }
+    }
+  }
+  return NULL;
+}
+
+double * EthercatDriver::findCommandInterface(
+  const std::string & interface,
+  std::vector<std::vector<double>> & joint_commands,
+  std::vector<std::vector<double>> & sensor_commands,
+  std::vector<std::vector<double>> & gpio_commands)
+{
+  for (uint j = 0; j < info_.joints.size(); j++) {
+    for (auto k = 0ul; k < info_.joints[j].command_interfaces.size(); k++) {
+      if (interface == info_.joints[j].name + "/" + info_.joints[j].command_interfaces[k].name) {
+        return &joint_commands[j][k];
+      }
+    }
+  }
+  for (uint g = 0; g < info_.gpios.size(); g++) {
+    for (auto k = 0ul; k < info_.gpios[g].command_interfaces.size(); k++) {
+      if (interface == info_.gpios[g].name + "/" + info_.gpios[g].command_interfaces[k].name) {
+        return &gpio_commands[g][k];
+      }
+    }
+  }
+  for (uint s = 0; s < info_.sensors.size(); s++) {
+    for (auto k = 0ul; k < info_.sensors[s].command_interfaces.size(); k++) {
+      if (interface ==
+        info_.sensors[s].name + "/" + info_.sensors[s].command_interfaces[k].name)
+      {
+        return &sensor_commands[s][k];
+      }
+    }
+  }
+  return NULL;
+}
+
 CallbackReturn EthercatDriver::on_configure(
   const rclcpp_lifecycle::State & /*previous_state*/)
 {
+  if (!driver_node_) {
+    start_driver_node();
+  }
   return CallbackReturn::SUCCESS;
 }
 
+void EthercatDriver::start_driver_node()
+{
+  driver_node_ = rclcpp::Node::make_shared(info_.name);
+
+  using namespace std::placeholders;
+  set_channel_parameters_srv_ = driver_node_->create_service<SetChannelParametersSrv>(
+    "~/set_channel_parameters",
+    std::bind(&EthercatDriver::set_channel_parameters_callback, this, _1, _2));
+  load_pvt_trajectory_srv_ = driver_node_->create_service<LoadPvtTrajectorySrv>(
+    "~/load_pvt_trajectory",
+    std::bind(&EthercatDriver::load_pvt_trajectory_callback, this, _1, _2));
+  load_cam_table_srv_ = driver_node_->create_service<LoadCamTableSrv>(
+    "~/load_cam_table",
+    std::bind(&EthercatDriver::load_cam_table_callback, this, _1, _2));
+
+  driver_executor_ = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+  driver_executor_->add_node(driver_node_);
+  driver_node_thread_ = std::thread([this]() {driver_executor_->spin();});
+}
+
+void EthercatDriver::set_channel_parameters_callback(
+  const std::shared_ptr<SetChannelParametersSrv::Request> request,
+  std::shared_ptr<SetChannelParametersSrv::Response> response)
+{
+  ethercat_interface::ChannelParameters parameters;
+  parameters.factor = request->factor;
+  parameters.offset = request->offset;
+  parameters.default_value = request->default_value;
+
+  // the new parameter block is built here and swapped in by the RT thread
+  response->success = false;
+  for (auto i = 0ul; i < ec_modules_.size(); i++) {
+    if (std::stoi(ec_module_parameters_[i].at("position")) != request->slave_position) {
+      continue;
+    }
+    if (ec_modules_[i]->setChannelParameters(
+        request->channel_index, request->channel_subindex, parameters))
+    {
+      response->success = true;
+    }
+  }
+
+  std::stringstream return_stream;
+  if (response->success) {
+    return_stream << "Parameters of channel 0x" << std::hex << request->channel_index <<
+      ":" << static_cast<int>(request->channel_subindex) << std::dec <<
+      " transmitted to module at position " << request->slave_position;
+  } else {
+    return_stream << "Abort. Channel 0x" << std::hex << request->channel_index <<
+      ":" << static_cast<int>(request->channel_subindex) << std::dec <<
+      " not configured for module at position " << request->slave_position;
+  }
+  response->return_message = return_stream.str();
+  RCLCPP_INFO(rclcpp::get_logger("EthercatDriver"), "%s", response->return_message.c_str());
+}
+
+void EthercatDriver::load_pvt_trajectory_callback(
+  const std::shared_ptr<LoadPvtTrajectorySrv::Request> request,
+  std::shared_ptr<LoadPvtTrajectorySrv::Response> response)
+{
+  response->success = false;
+  response->loaded = 0;
+  if (request->velocities.size() != request->positions.size() ||
+    request->durations.size() != request->positions.size())
+  {
+    response->return_message = "Abort. Positions, velocities and durations differ in size";
+    RCLCPP_ERROR(rclcpp::get_logger("EthercatDriver"), "%s", response->return_message.c_str());
+    return;
+  }
+  std::vector<ethercat_interface::PvtPoint> points(request->positions.size());
+  for (auto i = 0ul; i < points.size(); i++) {
+    points[i].position = request->positions[i];
+    points[i].velocity = request->velocities[i];
+    points[i].duration = request->durations[i];
+  }
+
+  // the buffer of the slave is lock-free, the RT thread is never blocked here
+  bool found = false;
+  for (auto i = 0ul; i < ec_modules_.size(); i++) {
+    if (std::stoi(ec_module_parameters_[i].at("position")) != request->slave_position) {
+      continue;
+    }
+    found = true;
+    bool success = !request->stop || ec_modules_[i]->runTrajectory(false);
+    response->loaded = ec_modules_[i]->loadTrajectory(points);
+    success = success && response->loaded == points.size();
+    response->success = success && (!request->start || ec_modules_[i]->runTrajectory(true));
+  }
+
+  std::stringstream return_stream;
+  if (found) {
+    return_stream << response->loaded << " of " << points.size() <<
+      " trajectory points loaded into module at position " << request->slave_position;
+    if (!response->success) {
+      return_stream << ", the module has no trajectory buffer or it is full";
+    }
+  } else {
+    return_stream << "Abort. No module at position " << request->slave_position;
+  }
+  response->return_message = return_stream.str();
+  RCLCPP_INFO(rclcpp::get_logger("EthercatDriver"), "%s", response->return_message.c_str());
+}
+
+void EthercatDriver::load_cam_table_callback(
+  const std::shared_ptr<LoadCamTableSrv::Request> request,
+  std::shared_ptr<LoadCamTableSrv::Response> response)
+{
+  ethercat_interface::CamTable cam;
+  cam.leader = request->leader_positions;
+  cam.follower = request->follower_positions;
+  cam.periodic = request->periodic;
+
+  // the table is built here and swapped in by the RT thread
+  response->success = false;
+  bool found = false;
+  for (auto & coupling : couplings_) {
+    if (coupling.name == request->coupling) {
+      found = true;
+      response->success = coupling.coupling->loadCamTable(cam);
+    }
+  }
+
+  std::stringstream return_stream;
+  if (response->success) {
+    return_stream << "Cam table of " << cam.leader.size() << " points loaded into coupling " <<
+      request->coupling;
+  } else if (found) {
+    return_stream << "Abort. Invalid cam table for coupling " << request->coupling <<
+      ", leader positions must be strictly increasing";
+  } else {
+    return_stream << "Abort. No coupling " << request->coupling;
+  }
+  response->return_message = return_stream.str();
+  RCLCPP_INFO(rclcpp::get_logger("EthercatDriver"), "%s", response->return_message.c_str());
+}
+
 std::vector<hardware_interface::StateInterface>
 EthercatDriver::export_state_interfaces()
 {
@@ -280,15 +805,63 @@ CallbackReturn EthercatDriver::on_activate(
     return CallbackReturn::ERROR;
   }
 
+  if (bus_frequency_ > 0 && bus_frequency_ < control_frequency_) {
+    RCLCPP_FATAL(
+      rclcpp::get_logger("EthercatDriver"), "Bus frequency lower than the control frequency!");
+    return CallbackReturn::ERROR;
+  }
+
   // start EC and wait until state operative
 
-  master_.setCtrlFrequency(control_frequency_);
+  master_.setCtrlFrequency(bus_frequency_ > 0 ? bus_frequency_ : control_frequency_);
+
+  if (info_.hardware_parameters.find("wakeup_strategy") != info_.hardware_parameters.end()) {
+    const std::string strategy = info_.hardware_parameters["wakeup_strategy"];
+    if (strategy == "sleep_spin") {
+      uint32_t spin_guard_us = 50;
+      if (info_.hardware_parameters.find("spin_guard_us") != info_.hardware_parameters.end()) {
+        spin_guard_us = std::stoul(info_.hardware_parameters["spin_guard_us"]);
+      }
+      bool adaptive_guard = true;
+      if (info_.hardware_parameters.find("adaptive_spin_guard") !=
+        info_.hardware_parameters.end())
+      {
+        adaptive_guard = info_.hardware_parameters["adaptive_spin_guard"] == "true";
+      }
+      master_.setWakeupStrategy(
+        ethercat_interface::EcMaster::WakeupStrategy::SLEEP_SPIN,
+        spin_guard_us * 1000, adaptive_guard);
+    } else if (strategy != "sleep") {
+      RCLCPP_FATAL(
+        rclcpp::get_logger("EthercatDriver"), "Invalid wakeup strategy '%s'!", strategy.c_str());
+      return CallbackReturn::ERROR;
+    }
+  }
+
+  // SYNC0 shift calibrated at a previous activation
+  std::string sync0_shift_file;
+  if (info_.hardware_parameters.find("sync0_shift_file") != info_.hardware_parameters.end()) {
+    sync0_shift_file = info_.hardware_parameters["sync0_shift_file"];
+    std::ifstream file(sync0_shift_file);
+    int32_t sync0_shift;
+    if (file >> sync0_shift) {
+      master_.setSync0Shift(sync0_shift);
+      RCLCPP_INFO(
+        rclcpp::get_logger("EthercatDriver"), "Using calibrated SYNC0 shift of %d ns", sync0_shift);
+    }
+  }
 
   for (auto i = 0ul; i < ec_modules_.size(); i++) {
-    master_.addSlave(
-      std::stod(ec_module_parameters_[i]["alias"]),
-      std::stod(ec_module_parameters_[i]["position"]),
-      ec_modules_[i].get());
+    if (!master_.addSlave(
+        std::stod(ec_module_parameters_[i]["alias"]),
+        std::stod(ec_module_parameters_[i]["position"]),
+        ec_modules_[i].get()))
+    {
+      RCLCPP_FATAL(
+        rclcpp::get_logger("EthercatDriver"), "Failed to configure module at position %s",
+        ec_module_parameters_[i]["position"].c_str());
+      return CallbackReturn::ERROR;
+    }
   }
 
   // configure SDO
@@ -311,12 +884,35 @@ CallbackReturn EthercatDriver::on_activate(
     }
   }
 
+  // signals copied from slave to slave by the master, without controller round trip
+  if (info_.hardware_parameters.find("pdo_routes") != info_.hardware_parameters.end()) {
+    std::vector<ethercat_interface::PdoRoute> routes;
+    if (!ethercat_interface::PdoRoute::loadFile(info_.hardware_parameters["pdo_routes"], routes)) {
+      RCLCPP_FATAL(
+        rclcpp::get_logger("EthercatDriver"), "Invalid PDO routes in %s",
+        info_.hardware_parameters["pdo_routes"].c_str());
+      return CallbackReturn::ERROR;
+    }
+    for (const auto & route : routes) {
+      master_.addRoute(route);
+    }
+    RCLCPP_INFO(rclcpp::get_logger("EthercatDriver"), "Got %li PDO routes", routes.size());
+  }
+
   if (!master_.activate()) {
     RCLCPP_ERROR(rclcpp::get_logger("EthercatDriver"), "Activate EcMaster failed");
     return CallbackReturn::ERROR;
   }
   RCLCPP_INFO(rclcpp::get_logger("EthercatDriver"), "Activated EcMaster!");
 
+  uint32_t sync0_calibration_cycles = 0;
+  if (info_.hardware_parameters.find("sync0_calibration_cycles") !=
+    info_.hardware_parameters.end())
+  {
+    sync0_calibration_cycles = std::stoul(info_.hardware_parameters["sync0_calibration_cycles"]);
+  }
+  master_.startSync0Calibration(sync0_calibration_cycles);
+
   // start after one second
   struct timespec t;
   clock_gettime(CLOCK_MONOTONIC, &t);
@@ -325,7 +921,7 @@ CallbackReturn EthercatDriver::on_activate(
   bool running = true;
   while (running) {
     // wait until next shot
-    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+    master_.sleepUntil(t);
     // update EtherCAT bus
 
     master_.update();
@@ -336,7 +932,7 @@ CallbackReturn EthercatDriver::on_activate(
     for (auto & module : ec_modules_) {
       isAllInit = isAllInit && module->initialized();
     }
-    if (isAllInit) {
+    if (isAllInit && master_.sync0CalibrationDone()) {
       running = false;
     }
     // calculate next shot. carry over nanoseconds into microseconds.
@@ -347,17 +943,91 @@ CallbackReturn EthercatDriver::on_activate(
     }
   }
 
+  if (sync0_calibration_cycles > 0) {
+    uint32_t margin_us = 10;
+    if (info_.hardware_parameters.find("sync0_shift_margin_us") !=
+      info_.hardware_parameters.end())
+    {
+      margin_us = std::stoul(info_.hardware_parameters["sync0_shift_margin_us"]);
+    }
+    const auto calibration = master_.getSync0Calibration(margin_us * 1000);
+    if (calibration.samples == 0) {
+      RCLCPP_WARN(
+        rclcpp::get_logger("EthercatDriver"),
+        "SYNC0 calibration failed: no reference clock time received");
+    } else {
+      RCLCPP_INFO(
+        rclcpp::get_logger("EthercatDriver"),
+        "SYNC0 calibration over %u cycles: frame delay min %d ns, median %d ns, "
+        "p99 %d ns, max %d ns -> SYNC0 shift %d ns",
+        calibration.samples, calibration.min_delay_ns, calibration.median_delay_ns,
+        calibration.p99_delay_ns, calibration.max_delay_ns, calibration.shift_ns);
+      // the DC configuration is only taken over at activation
+      if (calibration.shift_ns < 0) {
+        RCLCPP_WARN(
+          rclcpp::get_logger("EthercatDriver"),
+          "SYNC0 calibration rejected: the frame delay plus margin exceeds the cycle");
+      } else if (!sync0_shift_file.empty()) {
+        std::ofstream file(sync0_shift_file);
+        file << calibration.shift_ns << std::endl;
+        RCLCPP_INFO(
+          rclcpp::get_logger("EthercatDriver"),
+          "SYNC0 shift saved to %s, applied at next activation", sync0_shift_file.c_str());
+      }
+    }
+  }
+
+  // without bus thread, read() and write() are not timed by the driver: the statistics
+  // reported are the ones of the startup cycles
+  wakeup_statistics_ = master_.getWakeupStatistics();
+  RCLCPP_INFO(
+    rclcpp::get_logger("EthercatDriver"),
+    "Startup cycle start lateness: mean %.1f us, max %.1f us, jitter %.1f us",
+    wakeup_statistics_.mean_ns / 1000.0, wakeup_statistics_.max_ns / 1000.0,
+    wakeup_statistics_.jitter_ns / 1000.0);
+
   RCLCPP_INFO(
     rclcpp::get_logger("EthercatDriver"), "System Successfully started!");
 
+  if (!shm_commands_name_.empty()) {
+    if (!shm_commands_.create(shm_commands_name_, shm_command_interfaces_)) {
+      RCLCPP_FATAL(
+        rclcpp::get_logger("EthercatDriver"),
+        "Failed to create the shared memory command region %s", shm_commands_name_.c_str());
+      return CallbackReturn::ERROR;
+    }
+    std::fill(shm_command_stamps_.begin(), shm_command_stamps_.end(), 0);
+    RCLCPP_INFO(
+      rclcpp::get_logger("EthercatDriver"), "Accepting %li commands through shared memory %s",
+      shm_command_interfaces_.size(), shm_commands_name_.c_str());
+  }
+
+  std::fill(
+    scheduled_command_values_.begin(), scheduled_command_values_.end(),
+    std::numeric_limits<double>::quiet_NaN());
+  cycle_schedule_.clear();
+  time_schedule_.clear();
+  dropped_batches_ = 0;
+
   activated_ = true;
 
+  if (bus_frequency_ > 0) {
+    RCLCPP_INFO(
+      rclcpp::get_logger("EthercatDriver"), "Running the bus at %.0f Hz", bus_frequency_);
+    bus_running_ = true;
+    bus_thread_ = std::thread(&EthercatDriver::bus_loop, this);
+  }
+
   return CallbackReturn::SUCCESS;
 }
 
 CallbackReturn EthercatDriver::on_deactivate(
   const rclcpp_lifecycle::State & /*previous_state*/)
 {
+  bus_running_ = false;
+  if (bus_thread_.joinable()) {
+    bus_thread_.join();
+  }
   const std::lock_guard<std::mutex> lock(ec_mutex_);
   activated_ = false;
 
@@ -365,6 +1035,7 @@ CallbackReturn EthercatDriver::on_deactivate(
 
   // stop EC and disconnect
   master_.stop();
+  shm_commands_.close();
 
   RCLCPP_INFO(
     rclcpp::get_logger("EthercatDriver"), "System successfully stopped!");
@@ -372,14 +1043,279 @@ CallbackReturn EthercatDriver::on_deactivate(
   return CallbackReturn::SUCCESS;
 }
 
+hardware_interface::return_type EthercatDriver::prepare_command_mode_switch(
+  const std::vector<std::string> & start_interfaces,
+  const std::vector<std::string> & stop_interfaces)
+{
+  // filter the interfaces per module here, so that the RT switch does not allocate
+  switch_start_interfaces_.resize(ec_modules_.size());
+  switch_stop_interfaces_.resize(ec_modules_.size());
+  for (auto i = 0ul; i < ec_modules_.size(); i++) {
+    switch_start_interfaces_[i] = componentInterfaces(ec_module_components_[i], start_interfaces);
+    switch_stop_interfaces_[i] = componentInterfaces(ec_module_components_[i], stop_interfaces);
+    if (switch_start_interfaces_[i].empty() && switch_stop_interfaces_[i].empty()) {
+      continue;
+    }
+    if (!ec_modules_[i]->prepareCommandModeSwitch(
+        switch_start_interfaces_[i], switch_stop_interfaces_[i]))
+    {
+      RCLCPP_ERROR(
+        rclcpp::get_logger("EthercatDriver"),
+        "Module %s of component %s rejected the command mode switch.",
+        ec_module_parameters_[i].at("name").c_str(), ec_module_components_[i].c_str());
+      return hardware_interface::return_type::ERROR;
+    }
+  }
+  return hardware_interface::return_type::OK;
+}
+
+hardware_interface::return_type EthercatDriver::perform_command_mode_switch(
+  const std::vector<std::string> & /*start_interfaces*/,
+  const std::vector<std::string> & /*stop_interfaces*/)
+{
+  // called between read() and write(), the new modes are sent with the next write()
+  std::unique_lock<std::mutex> lock(ec_mutex_, std::defer_lock);
+  if (bus_frequency_ > 0) {
+    // the bus thread runs the slaves concurrently
+    lock.lock();
+  }
+  for (auto i = 0ul; i < switch_start_interfaces_.size(); i++) {
+    if (switch_start_interfaces_[i].empty() && switch_stop_interfaces_[i].empty()) {
+      continue;
+    }
+    if (!ec_modules_[i]->performCommandModeSwitch(
+        switch_start_interfaces_[i], switch_stop_interfaces_[i]))
+    {
+      return hardware_interface::return_type::ERROR;
+    }
+  }
+  return hardware_interface::return_type::OK;
+}
+
+std::vector<std::string> EthercatDriver::componentInterfaces(
+  const std::string & component_name,
+  const std::vector<std::string> & interfaces)
+{
+  std::vector<std::string> component_interfaces;
+  const std::string prefix = component_name + "/";
+  for (const auto & interface : interfaces) {
+    if (interface.compare(0, prefix.size(), prefix) == 0) {
+      component_interfaces.push_back(interface.substr(prefix.size()));
+    }
+  }
+  return component_interfaces;
+}
+
+void EthercatDriver::bus_loop()
+{
+  if (bus_thread_priority_ > 0) {
+    struct sched_param param;
+    param.sched_priority = bus_thread_priority_;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+      RCLCPP_WARN(
+        rclcpp::get_logger("EthercatDriver"),
+        "Failed to set the bus thread priority to %d", bus_thread_priority_);
+    }
+  }
+
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  while (bus_running_) {
+    t.tv_nsec += master_.getInterval();
+    while (t.tv_nsec >= 1000000000) {
+      t.tv_nsec -= 1000000000;
+      t.tv_sec++;
+    }
+    master_.sleepUntil(t);
+    const std::lock_guard<std::mutex> lock(ec_mutex_);
+    wakeup_statistics_ = master_.getWakeupStatistics();
+    // the frame sent by update() is the one of the next cycle
+    applyScheduledCommands(master_.elapsedCycles() + 1);
+    applyShmCommands();
+    if (couplings_.empty() && interlocks_.size() == 0) {
+      master_.update();
+    } else {
+      // the followers and the interlocks act on the inputs received in this cycle
+      master_.readData();
+      applyCouplings();
+      interlocks_.apply();
+      master_.writeData();
+      interlocks_.restore();
+      restoreCouplings();
+    }
+    restoreShmCommands();
+    restoreScheduledCommands();
+  }
+}
+
+void EthercatDriver::scheduleCommands()
+{
+  const std::pair<double *, ethercat_interface::CommandSchedule *> keys[] = {
+    {scheduled_cycle_command_, &cycle_schedule_}, {scheduled_time_command_, &time_schedule_}};
+  for (const auto & key : keys) {
+    if (key.first == NULL || std::isnan(*key.first)) {
+      continue;
+    }
+    for (auto i = 0ul; i < scheduled_command_sources_.size(); i++) {
+      scheduled_command_batch_[i] = *scheduled_command_sources_[i];
+    }
+    const uint64_t due = *key.first > 0 ? static_cast<uint64_t>(*key.first) : 0;
+    if (!key.second->push(due, scheduled_command_batch_.data())) {
+      dropped_batches_++;
+    }
+    // consumed, the controller sets a new key for the next batch
+    *key.first = std::numeric_limits<double>::quiet_NaN();
+  }
+}
+
+void EthercatDriver::applyScheduledCommands(uint64_t cycle)
+{
+  if (scheduled_command_targets_.empty()) {
+    return;
+  }
+  cycle_schedule_.apply(cycle, scheduled_command_values_.data());
+  // application time of the frame about to be sent
+  time_schedule_.apply(
+    master_.getApplicationTime() + master_.getInterval(), scheduled_command_values_.data());
+  for (auto i = 0ul; i < scheduled_command_targets_.size(); i++) {
+    scheduled_command_saved_[i] = *scheduled_command_targets_[i];
+    *scheduled_command_targets_[i] = scheduled_command_values_[i];
+  }
+}
+
+void EthercatDriver::restoreScheduledCommands()
+{
+  for (auto i = 0ul; i < scheduled_command_targets_.size(); i++) {
+    *scheduled_command_targets_[i] = scheduled_command_saved_[i];
+  }
+}
+
+void EthercatDriver::readScheduleStates()
+{
+  if (bus_cycle_state_ != NULL) {
+    *bus_cycle_state_ = static_cast<double>(master_.elapsedCycles());
+  }
+  if (bus_time_state_ != NULL) {
+    *bus_time_state_ = static_cast<double>(master_.getApplicationTime());
+  }
+  if (pending_batches_state_ != NULL) {
+    *pending_batches_state_ = cycle_schedule_.pending() + time_schedule_.pending();
+  }
+  if (dropped_batches_state_ != NULL) {
+    *dropped_batches_state_ = static_cast<double>(dropped_batches_);
+  }
+}
+
+void EthercatDriver::readStatisticsStates()
+{
+  const std::pair<double *, double> states[] = {
+    {wakeups_state_, static_cast<double>(wakeup_statistics_.wakeups)},
+    {wakeup_lateness_state_, static_cast<double>(wakeup_statistics_.last_ns)},
+    {wakeup_lateness_min_state_, static_cast<double>(wakeup_statistics_.min_ns)},
+    {wakeup_lateness_max_state_, static_cast<double>(wakeup_statistics_.max_ns)},
+    {wakeup_lateness_mean_state_, wakeup_statistics_.mean_ns},
+    {wakeup_jitter_state_, wakeup_statistics_.jitter_ns},
+    {spin_guard_state_, static_cast<double>(wakeup_statistics_.spin_guard_ns)}};
+  for (const auto & state : states) {
+    if (state.first != NULL) {
+      *state.first = state.second;
+    }
+  }
+}
+
+void EthercatDriver::applyCouplings()
+{
+  for (auto & coupling : couplings_) {
+    const bool engage = coupling.engage_command != NULL && *coupling.engage_command > 0;
+    coupling.saved = *coupling.follower_command;
+    double target;
+    if (coupling.coupling->update(
+        coupling_period_, engage, *coupling.leader, *coupling.follower_state, target))
+    {
+      *coupling.follower_command = target;
+    }
+    if (coupling.state != NULL) {
+      *coupling.state = coupling.coupling->state();
+    }
+    if (coupling.scale != NULL) {
+      *coupling.scale = coupling.coupling->scale();
+    }
+  }
+}
+
+void EthercatDriver::restoreCouplings()
+{
+  for (auto & coupling : couplings_) {
+    *coupling.follower_command = coupling.saved;
+  }
+}
+
+void EthercatDriver::applyShmCommands()
+{
+  if (!shm_commands_.isOpen()) {
+    return;
+  }
+  const uint64_t now = ethercat_interface::ShmCommandChannels::now();
+  for (auto i = 0ul; i < shm_command_targets_.size(); i++) {
+    // keep the last value if a write is in progress
+    shm_commands_.read(i, shm_command_values_[i], shm_command_stamps_[i]);
+    shm_command_saved_[i] = *shm_command_targets_[i];
+    if (ethercat_interface::ShmCommandChannels::fresh(
+        shm_command_stamps_[i], now, shm_command_timeout_ns_))
+    {
+      *shm_command_targets_[i] = shm_command_values_[i];
+    }
+  }
+}
+
+void EthercatDriver::restoreShmCommands()
+{
+  if (!shm_commands_.isOpen()) {
+    return;
+  }
+  for (auto i = 0ul; i < shm_command_targets_.size(); i++) {
+    *shm_command_targets_[i] = shm_command_saved_[i];
+  }
+}
+
+void EthercatDriver::copyInterfaces(
+  const std::vector<std::vector<double>> & from,
+  std::vector<std::vector<double>> & to)
+{
+  for (auto i = 0ul; i < from.size(); i++) {
+    std::copy(from[i].begin(), from[i].end(), to[i].begin());
+  }
+}
+
 hardware_interface::return_type EthercatDriver::read(
   const rclcpp::Time & /*time*/,
   const rclcpp::Duration & /*period*/)
 {
+  if (bus_frequency_ > 0) {
+    // the bus thread holds the lock for one bus cycle at most
+    const std::lock_guard<std::mutex> lock(ec_mutex_);
+    if (activated_) {
+      copyInterfaces(bus_joint_states_, hw_joint_states_);
+      copyInterfaces(bus_sensor_states_, hw_sensor_states_);
+      copyInterfaces(bus_gpio_states_, hw_gpio_states_);
+      for (auto & module : ec_modules_) {
+        module->resetStateAggregation();
+      }
+      readScheduleStates();
+      readStatisticsStates();
+    }
+    return hardware_interface::return_type::OK;
+  }
+
   // try to lock so we can avoid blocking the read/write loop on the lock.
   const std::unique_lock<std::mutex> lock(ec_mutex_, std::try_to_lock);
   if (lock.owns_lock() && activated_) {
     master_.readData();
+    for (auto & module : ec_modules_) {
+      module->resetStateAggregation();
+    }
+    readScheduleStates();
+    readStatisticsStates();
   }
   return hardware_interface::return_type::OK;
 }
@@ -388,10 +1324,35 @@ hardware_interface::return_type EthercatDriver::write(
   const rclcpp::Time & /*time*/,
   const rclcpp::Duration & /*period*/)
 {
+  if (bus_frequency_ > 0) {
+    const std::lock_guard<std::mutex> lock(ec_mutex_);
+    if (activated_) {
+      copyInterfaces(hw_joint_commands_, bus_joint_commands_);
+      copyInterfaces(hw_sensor_commands_, bus_sensor_commands_);
+      copyInterfaces(hw_gpio_commands_, bus_gpio_commands_);
+      scheduleCommands();
+    }
+    return hardware_interface::return_type::OK;
+  }
+
+  // the schedule is only used by this thread here, a batch is never lost to the try-lock,
+  // at worst applied one cycle late
+  if (activated_) {
+    scheduleCommands();
+  }
   // try to lock so we can avoid blocking the read/write loop on the lock.
   const std::unique_lock<std::mutex> lock(ec_mutex_, std::try_to_lock);
   if (lock.owns_lock() && activated_) {
+    // readData() counted the cycle whose frame is sent here
+    applyScheduledCommands(master_.elapsedCycles());
+    applyShmCommands();
+    applyCouplings();
+    interlocks_.apply();
     master_.writeData();
+    interlocks_.restore();
+    restoreCouplings();
+    restoreShmCommands();
+    restoreScheduledCommands();
   }
   return hardware_interface::return_type::OK;
 }
@@ -0,0 +1,219 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Command to feedback latency of EcCiA402Drive on the simulated bus.
+// A position step is commanded to all drives and the control cycles until the
+// feedback reaches half of the step are counted, for the ways the driver runs the bus:
+//   update      one EcMaster::update() per control cycle, commands sent at the next cycle
+//   read_write  readData() before and writeData() after the controller (driver default)
+//   bus_rate    N bus cycles per control cycle, with the interface handover of the
+//               bus_frequency hardware parameter
+// usage: bench_cia402_latency [drives=4] [response_delay_cycles=1] [steps=50] [bus_ratio=4]
+
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ethercat_interface/ec_master.hpp"
+#include "ethercat_interface/ec_sim_backend.hpp"
+#include "ethercat_interface/ec_sim_cia402_drive.hpp"
+#include "ethercat_generic_plugins/generic_ec_cia402_drive.hpp"
+
+namespace
+{
+const double STEP = 1000;
+const int MAX_CYCLES = 200;
+
+typedef std::vector<std::vector<double>> Interfaces;
+
+struct Options
+{
+  size_t drives = 4;
+  unsigned int response_delay_cycles = 1;
+  int steps = 50;
+  unsigned int bus_ratio = 4;
+};
+
+struct Result
+{
+  int min_cycles = MAX_CYCLES;
+  int max_cycles = 0;
+  double mean_cycles = 0;
+  double cycle_us = 0;
+};
+
+uint64_t now_ns()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+}
+
+void copy(const Interfaces & from, Interfaces & to)
+{
+  for (size_t i = 0; i < from.size(); i++) {
+    std::copy(from[i].begin(), from[i].end(), to[i].begin());
+  }
+}
+
+/** run the steps with one driver mode, bus_ratio 0 for the update mode and 1 for read_write */
+bool run(const Options & options, unsigned int bus_ratio, Result & result)
+{
+  ethercat_interface::sim::reset();
+  auto & sim = ethercat_interface::sim::master(0);
+  ethercat_interface::sim::CiA402DriveConfig drive_config;
+  drive_config.time_constant = 0;
+  drive_config.response_delay_cycles = options.response_delay_cycles;
+
+  // interfaces seen by the controller, and by the slaves in bus_rate mode
+  Interfaces states(options.drives, std::vector<double>(3, 0));
+  Interfaces commands(options.drives, std::vector<double>(3, std::nan("")));
+  Interfaces bus_states = states;
+  Interfaces bus_commands = commands;
+  Interfaces & slave_states = bus_ratio > 1 ? bus_states : states;
+  Interfaces & slave_commands = bus_ratio > 1 ? bus_commands : commands;
+
+  ethercat_interface::EcMaster master(0);
+  master.setCtrlFrequency(1000.0 * std::max(1u, bus_ratio));
+  std::vector<std::unique_ptr<ethercat_generic_plugins::EcCiA402Drive>> drives;
+  for (size_t i = 0; i < options.drives; i++) {
+    sim.setSlaveModel(i, std::make_shared<ethercat_interface::sim::CiA402DriveModel>(drive_config));
+    drives.push_back(std::make_unique<ethercat_generic_plugins::EcCiA402Drive>());
+    std::unordered_map<std::string, std::string> parameters = {
+      {"slave_config", BENCHMARK_CONFIG_DIR "/sim_cia402_drive.yaml"},
+      {"mode_of_operation", "8"},
+      {"state_interface/position", "0"}, {"state_interface/velocity", "1"},
+      {"state_interface/effort", "2"},
+      {"command_interface/position", "0"}, {"command_interface/velocity", "1"},
+      {"command_interface/effort", "2"}};
+    if (!drives.back()->setupSlave(parameters, &slave_states[i], &slave_commands[i]) ||
+      !master.addSlave(0, i, drives.back().get()))
+    {
+      return false;
+    }
+  }
+  if (!master.activate()) {
+    return false;
+  }
+
+  // startup until all drives are enabled
+  int startup = 0;
+  bool enabled = false;
+  while (!enabled && startup++ < 1000) {
+    master.update();
+    enabled = true;
+    for (auto & drive : drives) {
+      enabled = enabled && drive->initialized();
+    }
+  }
+  if (!enabled) {
+    return false;
+  }
+  master.update();
+  copy(slave_states, states);
+
+  std::function<void()> read, write;
+  if (bus_ratio == 0) {
+    read = [&]() {master.update();};
+    write = []() {};
+  } else if (bus_ratio == 1) {
+    read = [&]() {master.readData();};
+    write = [&]() {master.writeData();};
+  } else {
+    read = [&]() {
+        copy(bus_states, states);
+        for (auto & drive : drives) {
+          drive->resetStateAggregation();
+        }
+      };
+    write = [&]() {
+        copy(commands, bus_commands);
+        for (unsigned int i = 0; i < bus_ratio; i++) {
+          master.update();
+        }
+      };
+  }
+
+  double sum = 0;
+  uint64_t cycles = 0;
+  const uint64_t start = now_ns();
+  double target = states[0][0];
+  for (int step = 0; step < options.steps; step++) {
+    target += (step % 2 == 0) ? STEP : -STEP;
+    for (auto & command : commands) {
+      command[0] = target;
+    }
+    write();
+    int latency = 1;
+    for (; latency < MAX_CYCLES; latency++) {
+      read();
+      cycles++;
+      const bool reached = std::abs(states[0][0] - target) <= STEP / 2;
+      write();
+      if (reached) {
+        break;
+      }
+    }
+    result.min_cycles = std::min(result.min_cycles, latency);
+    result.max_cycles = std::max(result.max_cycles, latency);
+    sum += latency;
+    // settle
+    for (int i = 0; i < 5; i++) {
+      read();
+      write();
+      cycles++;
+    }
+  }
+  result.mean_cycles = sum / options.steps;
+  result.cycle_us = (now_ns() - start) / 1000.0 / cycles;
+  return true;
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  Options options;
+  if (argc > 1) {options.drives = std::strtoul(argv[1], NULL, 10);}
+  if (argc > 2) {options.response_delay_cycles = std::strtoul(argv[2], NULL, 10);}
+  if (argc > 3) {options.steps = std::max(1l, std::strtol(argv[3], NULL, 10));}
+  if (argc > 4) {options.bus_ratio = std::max(2ul, std::strtoul(argv[4], NULL, 10));}
+
+  std::printf(
+    "%zu drives, response delay %u cycles, %d steps\n",
+    options.drives, options.response_delay_cycles, options.steps);
+  std::printf(
+    "%-12s %10s %26s %14s\n", "mode", "bus/ctrl", "latency [ctrl cycles]", "cycle [us]");
+  const std::vector<std::pair<std::string, unsigned int>> modes = {
+    {"update", 0}, {"read_write", 1}, {"bus_rate", options.bus_ratio}};
+  for (const auto & mode : modes) {
+    Result result;
+    if (!run(options, mode.second, result)) {
+      std::printf("%-12s failed to start the drives\n", mode.first.c_str());
+      return 1;
+    }
+    std::printf(
+      "%-12s %10u %8d / %6.2f / %6d %14.2f\n", mode.first.c_str(), std::max(1u, mode.second),
+      result.min_cycles, result.mean_cycles, result.max_cycles, result.cycle_us);
+  }
+  ethercat_interface::sim::reset();
+  return 0;
+}
@@ -20,6 +20,13 @@
 #define CiA402D_RPDO_VELOCITY  ((uint16_t) 0x60ff)
 #define CiA402D_RPDO_EFFORT  ((uint16_t) 0x6071)
 #define CiA402D_RPDO_MODE_OF_OPERATION  ((uint16_t) 0x6060)
+#define CiA402D_RPDO_IP_DATA_RECORD  ((uint16_t) 0x60c1)
+
+#define CiA402D_SDO_IP_TIME_PERIOD  ((uint16_t) 0x60c2)
+#define CiA402D_SDO_IP_DATA_CONFIGURATION  ((uint16_t) 0x60c4)
+
+/** controlword bit enabling the interpolation in interpolated position mode */
+#define CiA402D_CONTROLWORD_ENABLE_IP  ((uint16_t) 0x0010)
 
 #define CiA402D_TPDO_POSITION ((uint16_t) 0x6064)
 #define CiA402D_TPDO_STATUSWORD  ((uint16_t) 0x6041)
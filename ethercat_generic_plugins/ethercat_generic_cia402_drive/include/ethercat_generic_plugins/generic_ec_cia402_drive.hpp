@@ -17,6 +17,7 @@
 #ifndef ETHERCAT_GENERIC_PLUGINS__GENERIC_EC_CIA402_DRIVE_HPP_
 #define ETHERCAT_GENERIC_PLUGINS__GENERIC_EC_CIA402_DRIVE_HPP_
 
+#include <array>
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -27,6 +28,8 @@
 #include "ethercat_interface/ec_pdo_channel_manager.hpp"
 #include "ethercat_generic_plugins/generic_ec_slave.hpp"
 #include "ethercat_generic_plugins/cia402_common_defs.hpp"
+#include "ethercat_generic_plugins/pvt_buffer.hpp"
+#include "ethercat_generic_plugins/soft_limits.hpp"
 
 namespace ethercat_generic_plugins
 {
@@ -40,13 +43,30 @@ public:
    *  The transition through the state machine is handled automatically. */
   bool initialized() const;
 
+  /** sample the PVT trajectory for the bus cycle */
+  virtual void newCycle(uint32_t domain);
   virtual void processData(size_t index, uint8_t * domain_address);
+  /** update the drive state from the status word read in the cycle */
+  virtual void cycleEnd(uint32_t domain);
 
   virtual bool setupSlave(
     std::unordered_map<std::string, std::string> slave_paramters,
     std::vector<double> * state_interface,
     std::vector<double> * command_interface);
 
+  /** select the cyclic synchronous mode matching the claimed command interfaces:
+   *  position -> CSP, velocity -> CSV, effort -> CST */
+  virtual bool prepareCommandModeSwitch(
+    const std::vector<std::string> & start_interfaces,
+    const std::vector<std::string> & stop_interfaces);
+  virtual bool performCommandModeSwitch(
+    const std::vector<std::string> & start_interfaces,
+    const std::vector<std::string> & stop_interfaces);
+
+  /** queue points into the PVT buffer, executed at bus rate into 0x607A and 0x60FF */
+  virtual size_t loadTrajectory(const std::vector<ethercat_interface::PvtPoint> & points);
+  virtual bool runTrajectory(bool run);
+
   int8_t mode_of_operation_display_ = 0;
   int8_t mode_of_operation_ = -1;
 
@@ -64,6 +84,34 @@ protected:
   int fault_reset_command_interface_index_ = -1;
   bool last_fault_reset_command_ = false;
   double last_position_ = std::numeric_limits<double>::quiet_NaN();
+  /** mode prepared by a command mode switch, -1 if none */
+  int8_t switch_mode_of_operation_ = -1;
+  /** true until the drive confirms the switched mode in 0x6061 */
+  bool mode_switch_pending_ = false;
+
+  /** PVT trajectory buffer, disabled if empty */
+  PvtBuffer pvt_buffer_;
+  /** nominal bus cycle time the trajectory advances by, in s */
+  double bus_cycle_time_ = 0;
+  PvtBuffer::State pvt_state_ = PvtBuffer::IDLE;
+  double pvt_position_ = 0;
+  double pvt_velocity_ = 0;
+  int pvt_state_interface_index_ = -1;
+  int pvt_underruns_interface_index_ = -1;
+  int pvt_queued_interface_index_ = -1;
+
+  /** interpolated position mode: the points of the PVT buffer are sent as records of the
+   *  drive buffer (0x60C1), one per interpolation period of ip_cycles_ bus cycles */
+  double ip_period_ = 0;
+  uint32_t ip_cycles_ = 0;
+  uint32_t ip_counter_ = 0;
+  PvtBuffer::State ip_state_ = PvtBuffer::IDLE;
+  double ip_position_ = 0;
+
+  /** software limits of the targets, the last stage before they are sent */
+  SoftLimits limits_;
+  /** state interfaces of the violation counts by SoftLimits::Limit, -1 if not declared */
+  std::array<int, SoftLimits::LIMITS> limit_violations_interface_index_ = {-1, -1, -1, -1};
 
   /** returns device state based upon the status_word */
   DeviceState deviceState(uint16_t status_word);
@@ -71,6 +119,10 @@ protected:
   uint16_t transition(DeviceState state, uint16_t control_word);
   /** set up of the drive configuration from yaml node*/
   bool setup_from_config(YAML::Node drive_config);
+  /** set up of the interpolated position mode and its startup SDOs from yaml node */
+  bool setup_interpolated_position(YAML::Node ip_config);
+  /** limit the target written by the RPDO channel, if it is a limited target. RT */
+  void applyLimits(ethercat_interface::EcPdoChannelManager & channel, uint8_t * domain_address);
   /** set up of the drive configuration from yaml file*/
   bool setup_from_config_file(std::string config_file);
 };
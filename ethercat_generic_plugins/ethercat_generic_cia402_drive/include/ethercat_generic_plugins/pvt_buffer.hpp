@@ -0,0 +1,223 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_GENERIC_PLUGINS__PVT_BUFFER_HPP_
+#define ETHERCAT_GENERIC_PLUGINS__PVT_BUFFER_HPP_
+
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "ethercat_interface/ec_slave.hpp"
+
+namespace ethercat_generic_plugins
+{
+
+/** Position-velocity-time trajectory executed at bus rate.
+ *  A non-RT producer queues the points and starts the execution, the bus cycle samples
+ *  the trajectory with a cubic Hermite interpolation between the points. The queue is a
+ *  single producer single consumer ring, neither side ever waits for the other.
+ *  When the queue runs empty, the trajectory holds the last point at zero velocity; if
+ *  the last point was not at rest, this is counted as an underrun. */
+class PvtBuffer
+{
+public:
+  enum State
+  {
+    /** not executing, the commands come from the controller */
+    IDLE = 0,
+    RUNNING = 1,
+    /** holding the last point until new points are queued or the execution stops */
+    HOLDING = 2
+  };
+
+  /** allocate the queue for capacity points. non-RT, before use */
+  void resize(size_t capacity)
+  {
+    ring_.resize(capacity + 1);
+    head_ = 0;
+    tail_ = 0;
+  }
+
+  size_t capacity() const {return ring_.empty() ? 0 : ring_.size() - 1;}
+
+  /** queue the points, up to the first point with an invalid duration or the queue full.
+   *  returns the number of points queued. producer */
+  size_t push(const std::vector<ethercat_interface::PvtPoint> & points)
+  {
+    if (ring_.empty()) {
+      return 0;
+    }
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t pushed = 0;
+    for (const auto & point : points) {
+      const size_t next = (tail + 1) % ring_.size();
+      if (next == head_.load(std::memory_order_acquire) || !(point.duration > 0) ||
+        !std::isfinite(point.position) || !std::isfinite(point.velocity))
+      {
+        break;
+      }
+      ring_[tail] = point;
+      tail = next;
+      pushed++;
+      // publish each point, the execution may already be running
+      tail_.store(tail, std::memory_order_release);
+    }
+    return pushed;
+  }
+
+  /** request the start or the stop of the execution. producer */
+  void run(bool run)
+  {
+    (run ? start_requested_ : stop_requested_).store(true, std::memory_order_release);
+  }
+
+  /** advance the trajectory by dt seconds, starting from the position if the execution
+   *  starts now, and return the sampled position and velocity. returns IDLE if the
+   *  trajectory is not executed, the outputs are then unchanged. consumer, RT */
+  State sample(double dt, double position, double & out_position, double & out_velocity)
+  {
+    takeStopRequest();
+    if (state_ == IDLE) {
+      if (!start_requested_.exchange(false, std::memory_order_acquire) || !begin(position)) {
+        return IDLE;
+      }
+    } else if (state_ == HOLDING) {
+      if (!begin(start_position_)) {
+        out_position = start_position_;
+        out_velocity = 0;
+        return HOLDING;
+      }
+    } else {
+      time_ += dt;
+    }
+
+    while (time_ >= segment_.duration) {
+      time_ -= segment_.duration;
+      start_position_ = segment_.position;
+      start_velocity_ = segment_.velocity;
+      if (!pop(segment_)) {
+        if (start_velocity_ != 0) {
+          underruns_++;
+        }
+        state_ = HOLDING;
+        out_position = start_position_;
+        out_velocity = 0;
+        return HOLDING;
+      }
+    }
+
+    // cubic Hermite between the start of the segment and its point
+    const double T = segment_.duration;
+    const double s = time_ / T;
+    const double s2 = s * s;
+    const double s3 = s2 * s;
+    out_position =
+      (2 * s3 - 3 * s2 + 1) * start_position_ + (s3 - 2 * s2 + s) * T * start_velocity_ +
+      (-2 * s3 + 3 * s2) * segment_.position + (s3 - s2) * T * segment_.velocity;
+    out_velocity =
+      ((6 * s2 - 6 * s) * start_position_ + (-6 * s2 + 6 * s) * segment_.position) / T +
+      (3 * s2 - 4 * s + 1) * start_velocity_ + (3 * s2 - 2 * s) * segment_.velocity;
+    return state_;
+  }
+
+  /** take the next point as a whole, for the drives interpolating between the points
+   *  themselves. returns IDLE if the trajectory is not executed and HOLDING if no point is
+   *  queued, the point is then unchanged. consumer, RT */
+  State next(ethercat_interface::PvtPoint & point)
+  {
+    takeStopRequest();
+    if (state_ == IDLE && !start_requested_.exchange(false, std::memory_order_acquire)) {
+      return IDLE;
+    }
+    if (!pop(segment_)) {
+      if (state_ == RUNNING && segment_.velocity != 0) {
+        underruns_++;
+      }
+      segment_.velocity = 0;
+      state_ = HOLDING;
+      return HOLDING;
+    }
+    point = segment_;
+    state_ = RUNNING;
+    return RUNNING;
+  }
+
+  State state() const {return state_;}
+  uint64_t underruns() const {return underruns_;}
+
+  /** number of points queued */
+  size_t size() const
+  {
+    if (ring_.empty()) {
+      return 0;
+    }
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return (tail + ring_.size() - head) % ring_.size();
+  }
+
+private:
+  void takeStopRequest()
+  {
+    if (stop_requested_.exchange(false, std::memory_order_acquire)) {
+      head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+      start_requested_.store(false, std::memory_order_relaxed);
+      state_ = IDLE;
+    }
+  }
+
+  /** start a segment from the position at rest, false if no point is queued */
+  bool begin(double position)
+  {
+    if (!pop(segment_)) {
+      return false;
+    }
+    start_position_ = position;
+    start_velocity_ = 0;
+    time_ = 0;
+    state_ = RUNNING;
+    return true;
+  }
+
+  bool pop(ethercat_interface::PvtPoint & point)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    point = ring_[head];
+    head_.store((head + 1) % ring_.size(), std::memory_order_release);
+    return true;
+  }
+
+  /** ring of the queued points, one slot kept free to tell full from empty */
+  std::vector<ethercat_interface::PvtPoint> ring_;
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+  std::atomic<bool> start_requested_{false};
+  std::atomic<bool> stop_requested_{false};
+
+  // consumer side
+  State state_ = IDLE;
+  ethercat_interface::PvtPoint segment_;
+  double start_position_ = 0;
+  double start_velocity_ = 0;
+  /** time since the start of the segment, in s */
+  double time_ = 0;
+  uint64_t underruns_ = 0;
+};
+
+}  // namespace ethercat_generic_plugins
+#endif  // ETHERCAT_GENERIC_PLUGINS__PVT_BUFFER_HPP_
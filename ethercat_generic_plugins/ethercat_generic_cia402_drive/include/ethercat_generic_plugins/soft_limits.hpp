@@ -0,0 +1,228 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_GENERIC_PLUGINS__SOFT_LIMITS_HPP_
+#define ETHERCAT_GENERIC_PLUGINS__SOFT_LIMITS_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+
+#include "yaml-cpp/yaml.h"
+
+namespace ethercat_generic_plugins
+{
+
+/** Software limits of the targets sent to a drive at each bus cycle, in the units of the
+ *  command interfaces. The position target is clamped to its range, or kept from leaving
+ *  it further if the last target was out of it, and as a stream its velocity and
+ *  acceleration from cycle to cycle are limited; the velocity target is
+ *  clamped and as a stream its acceleration is limited; the torque target is saturated.
+ *  The targets can be limited several times in a cycle, the last ones are kept by
+ *  commit() as the start of the next cycle and their violations are counted. */
+class SoftLimits
+{
+public:
+  enum Limit
+  {
+    POSITION = 0,
+    VELOCITY = 1,
+    ACCELERATION = 2,
+    TORQUE = 3,
+    LIMITS = 4
+  };
+
+  /** set up from a yaml node {position: {min, max}, velocity, acceleration, torque},
+   *  all optional. non-RT */
+  bool load(const YAML::Node & config)
+  {
+    try {
+      if (config["position"]) {
+        if (config["position"]["min"]) {
+          min_position_ = config["position"]["min"].as<double>();
+        }
+        if (config["position"]["max"]) {
+          max_position_ = config["position"]["max"].as<double>();
+        }
+      }
+      if (config["velocity"]) {
+        max_velocity_ = config["velocity"].as<double>();
+      }
+      if (config["acceleration"]) {
+        max_acceleration_ = config["acceleration"].as<double>();
+      }
+      if (config["torque"]) {
+        max_torque_ = config["torque"].as<double>();
+      }
+    } catch (const YAML::Exception & ex) {
+      std::cerr << "SoftLimits: invalid limits: " << ex.what() << std::endl;
+      return false;
+    }
+    if (!(min_position_ <= max_position_) || !(max_velocity_ >= 0) ||
+      !(max_acceleration_ >= 0) || !(max_torque_ >= 0))
+    {
+      std::cerr << "SoftLimits: expected min <= max and positive limits." << std::endl;
+      return false;
+    }
+    enabled_ = true;
+    return true;
+  }
+
+  bool enabled() const {return enabled_;}
+  /** true if the velocity or acceleration is limited, which needs the cycle time */
+  bool limitsRates() const
+  {
+    return std::isfinite(max_velocity_) || std::isfinite(max_acceleration_);
+  }
+  /** bus cycle time in s. non-RT, before use */
+  void setCycleTime(double cycle_time) {cycle_time_ = cycle_time;}
+
+  /** limit the position target. the velocity and the acceleration are only limited for a
+   *  stream of targets the drive follows, other targets are passed through. RT */
+  double position(double target, bool stream)
+  {
+    position_violations_ = 0;
+    position_ = target;
+    position_velocity_ = 0;
+    if (std::isnan(target) || !stream) {
+      return target;
+    }
+    double limited = target;
+    const bool follows = std::isfinite(last_position_) && cycle_time_ > 0;
+    if (follows) {
+      double velocity = (target - last_position_) / cycle_time_;
+      velocity = clamp(
+        velocity, last_position_velocity_ - max_acceleration_ * cycle_time_,
+        last_position_velocity_ + max_acceleration_ * cycle_time_, ACCELERATION,
+        position_violations_);
+      velocity = clamp(velocity, -max_velocity_, max_velocity_, VELOCITY, position_violations_);
+      limited = last_position_ + velocity * cycle_time_;
+    }
+    // a stream starting out of the range may only move back into it
+    const double min = std::isfinite(last_position_) ?
+      std::min(min_position_, last_position_) : min_position_;
+    const double max = std::isfinite(last_position_) ?
+      std::max(max_position_, last_position_) : max_position_;
+    limited = clamp(limited, min, max, POSITION, position_violations_);
+    position_ = limited;
+    position_velocity_ = follows ? (limited - last_position_) / cycle_time_ : 0;
+    return limited;
+  }
+
+  /** clamp a position target to the range only, for targets not sent at each cycle. RT */
+  double positionRange(double target)
+  {
+    position_violations_ = 0;
+    if (std::isnan(target)) {
+      return target;
+    }
+    return clamp(target, min_position_, max_position_, POSITION, position_violations_);
+  }
+
+  /** limit the velocity target. the acceleration is only limited for a stream of targets
+   *  the drive follows. RT */
+  double velocity(double target, bool stream)
+  {
+    velocity_violations_ = 0;
+    velocity_ = target;
+    if (std::isnan(target)) {
+      return target;
+    }
+    double limited = target;
+    if (stream && std::isfinite(last_velocity_) && cycle_time_ > 0) {
+      limited = clamp(
+        limited, last_velocity_ - max_acceleration_ * cycle_time_,
+        last_velocity_ + max_acceleration_ * cycle_time_, ACCELERATION, velocity_violations_);
+    }
+    limited = clamp(limited, -max_velocity_, max_velocity_, VELOCITY, velocity_violations_);
+    velocity_ = stream ? limited : std::numeric_limits<double>::quiet_NaN();
+    return limited;
+  }
+
+  /** saturate the torque target. RT */
+  double torque(double target)
+  {
+    torque_violations_ = 0;
+    if (std::isnan(target)) {
+      return target;
+    }
+    return clamp(target, -max_torque_, max_torque_, TORQUE, torque_violations_);
+  }
+
+  /** the targets of the cycle were sent, count their violations and start a new cycle
+   *  from them. a target not limited in the cycle starts its stream again. RT */
+  void commit()
+  {
+    const unsigned int violations = position_violations_ | velocity_violations_ |
+      torque_violations_;
+    for (int limit = 0; limit < LIMITS; limit++) {
+      if (violations & (1u << limit)) {
+        violations_[limit]++;
+      }
+    }
+    last_position_ = position_;
+    last_position_velocity_ = position_velocity_;
+    last_velocity_ = velocity_;
+    position_ = std::numeric_limits<double>::quiet_NaN();
+    position_velocity_ = 0;
+    velocity_ = std::numeric_limits<double>::quiet_NaN();
+    position_violations_ = 0;
+    velocity_violations_ = 0;
+    torque_violations_ = 0;
+  }
+
+  /** number of cycles a target was modified by the limit */
+  uint64_t violations(Limit limit) const {return violations_[limit];}
+
+private:
+  static double clamp(
+    double value, double min, double max, Limit limit, unsigned int & violations)
+  {
+    if (value < min) {
+      violations |= 1u << limit;
+      return min;
+    } else if (value > max) {
+      violations |= 1u << limit;
+      return max;
+    }
+    return value;
+  }
+
+  bool enabled_ = false;
+  double min_position_ = -std::numeric_limits<double>::infinity();
+  double max_position_ = std::numeric_limits<double>::infinity();
+  double max_velocity_ = std::numeric_limits<double>::infinity();
+  double max_acceleration_ = std::numeric_limits<double>::infinity();
+  double max_torque_ = std::numeric_limits<double>::infinity();
+  double cycle_time_ = 0;
+
+  /** targets sent in the last cycle, NaN if none */
+  double last_position_ = std::numeric_limits<double>::quiet_NaN();
+  double last_position_velocity_ = 0;
+  double last_velocity_ = std::numeric_limits<double>::quiet_NaN();
+  /** targets of the current cycle */
+  double position_ = std::numeric_limits<double>::quiet_NaN();
+  double position_velocity_ = 0;
+  double velocity_ = std::numeric_limits<double>::quiet_NaN();
+  unsigned int position_violations_ = 0;
+  unsigned int velocity_violations_ = 0;
+  unsigned int torque_violations_ = 0;
+  std::array<uint64_t, LIMITS> violations_ = {};
+};
+
+}  // namespace ethercat_generic_plugins
+#endif  // ETHERCAT_GENERIC_PLUGINS__SOFT_LIMITS_HPP_
@@ -14,7 +14,9 @@
 //
 // Author: Maciej Bednarczyk (macbednarczyk@gmail.com)
 
+#include <cmath>
 #include <numeric>
+#include <algorithm>
 
 #include "ethercat_generic_plugins/generic_ec_cia402_drive.hpp"
 
@@ -27,8 +29,41 @@ EcCiA402Drive::~EcCiA402Drive() {}
 
 bool EcCiA402Drive::initialized() const {return initialized_;}
 
-void EcCiA402Drive::processData(size_t index, uint8_t * domain_address)
+void EcCiA402Drive::newCycle(uint32_t domain)
 {
+  GenericEcSlave::newCycle(domain);
+  // the targets limited in the previous cycle were sent
+  if (limits_.enabled()) {
+    limits_.commit();
+  }
+  if (pvt_buffer_.capacity() == 0) {
+    return;
+  }
+  if (ip_cycles_ > 0 && mode_of_operation_display_ == ModeOfOperation::MODE_INTERPOLATED_POSITION) {
+    // the drive interpolates between the records, one record per interpolation period
+    pvt_state_ = PvtBuffer::IDLE;
+    if (ip_counter_++ % ip_cycles_ == 0) {
+      ethercat_interface::PvtPoint record;
+      ip_state_ = pvt_buffer_.next(record);
+      if (ip_state_ == PvtBuffer::RUNNING) {
+        ip_position_ = record.position;
+      }
+    }
+    if (ip_state_ == PvtBuffer::IDLE) {
+      ip_position_ = last_position_;
+      ip_counter_ = 0;
+    }
+    return;
+  }
+  ip_state_ = PvtBuffer::IDLE;
+  ip_position_ = last_position_;
+  pvt_state_ = pvt_buffer_.sample(bus_cycle_time_, last_position_, pvt_position_, pvt_velocity_);
+}
+
+void EcCiA402Drive::processData(size_t entry, uint8_t * domain_address)
+{
+  const size_t index = domain_map_[entry];
+
   // Special case: ControlWord
   if (pdo_channels_info_[index].index == CiA402D_RPDO_CONTROLWORD) {
     if (is_operational_) {
@@ -50,6 +85,19 @@ void EcCiA402Drive::processData(size_t index, uint8_t * domain_address)
           state_,
           pdo_channels_info_[index].ec_read(domain_address));
       }
+      // the drive interpolates while records are sent
+      if (ip_cycles_ > 0 &&
+        mode_of_operation_display_ == ModeOfOperation::MODE_INTERPOLATED_POSITION &&
+        !std::isnan(pdo_channels_info_[index].default_value))
+      {
+        uint16_t control_word = pdo_channels_info_[index].default_value;
+        if (ip_state_ != PvtBuffer::IDLE && state_ == STATE_OPERATION_ENABLED) {
+          control_word |= CiA402D_CONTROLWORD_ENABLE_IP;
+        } else {
+          control_word &= ~CiA402D_CONTROLWORD_ENABLE_IP;
+        }
+        pdo_channels_info_[index].default_value = control_word;
+      }
     }
   }
 
@@ -69,13 +117,52 @@ void EcCiA402Drive::processData(size_t index, uint8_t * domain_address)
     if (mode_of_operation_ >= 0 && mode_of_operation_ <= 10) {
       pdo_channels_info_[index].default_value = mode_of_operation_;
     }
+    // a mode set by a command mode switch has priority until the drive confirms it
+    pdo_channels_info_[index].override_command = mode_switch_pending_;
   }
 
-  pdo_channels_info_[index].ec_update(domain_address);
+  pdo_channels_info_[index].ec_update(domain_address, read_inputs_);
+
+  // the executed trajectory replaces the targets of the controller
+  if (pvt_state_ != PvtBuffer::IDLE &&
+    pdo_channels_info_[index].pdo_type == ethercat_interface::RPDO &&
+    pdo_channels_info_[index].allow_ec_write)
+  {
+    if (pdo_channels_info_[index].index == CiA402D_RPDO_POSITION) {
+      pdo_channels_info_[index].ec_write(
+        domain_address,
+        pdo_channels_info_[index].factor * pvt_position_ + pdo_channels_info_[index].offset);
+    } else if (pdo_channels_info_[index].index == CiA402D_RPDO_VELOCITY) {
+      pdo_channels_info_[index].ec_write(
+        domain_address,
+        pdo_channels_info_[index].factor * pvt_velocity_ + pdo_channels_info_[index].offset);
+    }
+  }
+  // interpolation data record, the actual position while no trajectory is executed
+  if (ip_cycles_ > 0 && pdo_channels_info_[index].index == CiA402D_RPDO_IP_DATA_RECORD &&
+    pdo_channels_info_[index].pdo_type == ethercat_interface::RPDO &&
+    pdo_channels_info_[index].allow_ec_write && !std::isnan(ip_position_))
+  {
+    pdo_channels_info_[index].ec_write(
+      domain_address,
+      pdo_channels_info_[index].factor * ip_position_ + pdo_channels_info_[index].offset);
+  }
+
+  // whatever their source, the targets are limited before they are sent
+  if (limits_.enabled() && pdo_channels_info_[index].pdo_type == ethercat_interface::RPDO &&
+    pdo_channels_info_[index].allow_ec_write)
+  {
+    applyLimits(pdo_channels_info_[index], domain_address);
+  }
 
   // get mode_of_operation_display_
   if (pdo_channels_info_[index].index == CiA402D_TPDO_MODE_OF_OPERATION_DISPLAY) {
     mode_of_operation_display_ = pdo_channels_info_[index].last_value;
+    if (mode_switch_pending_ && mode_of_operation_display_ == mode_of_operation_) {
+      mode_switch_pending_ = false;
+      std::cout << "MODE OF OPERATION: switched to " <<
+        static_cast<int>(mode_of_operation_display_) << std::endl;
+    }
   }
 
   if (pdo_channels_info_[index].index == CiA402D_TPDO_POSITION) {
@@ -86,26 +173,90 @@ void EcCiA402Drive::processData(size_t index, uint8_t * domain_address)
   if (pdo_channels_info_[index].index == CiA402D_TPDO_STATUSWORD) {
     status_word_ = pdo_channels_info_[index].last_value;
   }
+}
 
-
+void EcCiA402Drive::cycleEnd(uint32_t domain)
+{
   // CHECK FOR STATE CHANGE
-  if (index == all_channels_.size() - 1) {  // if last entry  in domain
-    if (status_word_ != last_status_word_) {
-      state_ = deviceState(status_word_);
-      if (state_ != last_state_) {
-        std::cout << "STATE: " << DEVICE_STATE_STR.at(state_)
-                  << " with status word :" << status_word_ << std::endl;
-      }
+  if (status_word_ != last_status_word_) {
+    state_ = deviceState(status_word_);
+    if (state_ != last_state_) {
+      std::cout << "STATE: " << DEVICE_STATE_STR.at(state_)
+                << " with status word :" << status_word_ << std::endl;
     }
-    initialized_ = ((state_ == STATE_OPERATION_ENABLED) &&
-      (last_state_ == STATE_OPERATION_ENABLED)) ? true : false;
+  }
+  initialized_ = ((state_ == STATE_OPERATION_ENABLED) &&
+    (last_state_ == STATE_OPERATION_ENABLED)) ? true : false;
+
+  last_status_word_ = status_word_;
+  last_state_ = state_;
+  counter_++;
 
-    last_status_word_ = status_word_;
-    last_state_ = state_;
-    counter_++;
+  if (pvt_state_interface_index_ >= 0) {
+    state_interface_ptr_->at(pvt_state_interface_index_) =
+      ip_state_ != PvtBuffer::IDLE ? ip_state_ : pvt_state_;
+  }
+  if (pvt_underruns_interface_index_ >= 0) {
+    state_interface_ptr_->at(pvt_underruns_interface_index_) = pvt_buffer_.underruns();
+  }
+  if (pvt_queued_interface_index_ >= 0) {
+    state_interface_ptr_->at(pvt_queued_interface_index_) = pvt_buffer_.size();
+  }
+  for (int limit = 0; limit < SoftLimits::LIMITS; limit++) {
+    if (limit_violations_interface_index_[limit] >= 0) {
+      state_interface_ptr_->at(limit_violations_interface_index_[limit]) =
+        limits_.violations(static_cast<SoftLimits::Limit>(limit));
+    }
+  }
+  // virtual channels of the drive configuration
+  GenericEcSlave::cycleEnd(domain);
+}
+
+void EcCiA402Drive::applyLimits(
+  ethercat_interface::EcPdoChannelManager & channel, uint8_t * domain_address)
+{
+  const uint16_t index = channel.index;
+  if ((index != CiA402D_RPDO_POSITION && index != CiA402D_RPDO_IP_DATA_RECORD &&
+    index != CiA402D_RPDO_VELOCITY && index != CiA402D_RPDO_EFFORT) || channel.factor == 0)
+  {
+    return;
+  }
+  // the value written, back in the units of the command interface
+  const double target = (channel.last_value - channel.offset) / channel.factor;
+  double limited = target;
+  if (index == CiA402D_RPDO_POSITION) {
+    limited = limits_.position(
+      target, mode_of_operation_display_ == ModeOfOperation::MODE_CYCLIC_SYNC_POSITION);
+  } else if (index == CiA402D_RPDO_IP_DATA_RECORD) {
+    // the records change once per interpolation period, only their range is limited
+    if (ip_state_ != PvtBuffer::IDLE) {
+      limited = limits_.positionRange(target);
+    }
+  } else if (index == CiA402D_RPDO_VELOCITY) {
+    limited = limits_.velocity(
+      target, mode_of_operation_display_ == ModeOfOperation::MODE_CYCLIC_SYNC_VELOCITY);
+  } else {
+    limited = limits_.torque(target);
+  }
+  if (limited != target) {
+    channel.ec_write(domain_address, channel.factor * limited + channel.offset);
   }
 }
 
+size_t EcCiA402Drive::loadTrajectory(const std::vector<ethercat_interface::PvtPoint> & points)
+{
+  return pvt_buffer_.push(points);
+}
+
+bool EcCiA402Drive::runTrajectory(bool run)
+{
+  if (pvt_buffer_.capacity() == 0) {
+    return false;
+  }
+  pvt_buffer_.run(run);
+  return true;
+}
+
 bool EcCiA402Drive::setupSlave(
   std::unordered_map<std::string, std::string> slave_paramters,
   std::vector<double> * state_interface,
@@ -135,6 +286,83 @@ bool EcCiA402Drive::setupSlave(
     fault_reset_command_interface_index_ = std::stoi(paramters_["command_interface/reset_fault"]);
   }
 
+  if (pvt_buffer_.capacity() > 0) {
+    if (paramters_.find("bus_frequency") == paramters_.end()) {
+      std::cerr << "EcCiA402Drive: the PVT buffer needs the 'bus_frequency' parameter." <<
+        std::endl;
+      return false;
+    }
+    bus_cycle_time_ = 1.0 / std::stod(paramters_["bus_frequency"]);
+    if (ip_period_ > 0) {
+      ip_cycles_ = std::max(1l, std::lround(ip_period_ / bus_cycle_time_));
+    }
+  } else if (ip_period_ > 0) {
+    std::cerr << "EcCiA402Drive: interpolated position mode needs a 'pvt_buffer_size'." <<
+      std::endl;
+    return false;
+  }
+  if (paramters_.find("state_interface/pvt_state") != paramters_.end()) {
+    pvt_state_interface_index_ = std::stoi(paramters_["state_interface/pvt_state"]);
+  }
+  if (paramters_.find("state_interface/pvt_underruns") != paramters_.end()) {
+    pvt_underruns_interface_index_ = std::stoi(paramters_["state_interface/pvt_underruns"]);
+  }
+  if (paramters_.find("state_interface/pvt_queued") != paramters_.end()) {
+    pvt_queued_interface_index_ = std::stoi(paramters_["state_interface/pvt_queued"]);
+  }
+
+  if (limits_.enabled()) {
+    if (paramters_.find("bus_frequency") != paramters_.end()) {
+      limits_.setCycleTime(1.0 / std::stod(paramters_["bus_frequency"]));
+    } else if (limits_.limitsRates()) {
+      std::cerr << "EcCiA402Drive: the velocity and acceleration limits need the " <<
+        "'bus_frequency' parameter." << std::endl;
+      return false;
+    }
+  }
+  const char * limit_names[SoftLimits::LIMITS] = {
+    "position_limit_violations", "velocity_limit_violations", "acceleration_limit_violations",
+    "torque_limit_violations"};
+  for (int limit = 0; limit < SoftLimits::LIMITS; limit++) {
+    const std::string name = std::string("state_interface/") + limit_names[limit];
+    if (paramters_.find(name) != paramters_.end()) {
+      limit_violations_interface_index_[limit] = std::stoi(paramters_[name]);
+    }
+  }
+
+  return true;
+}
+
+bool EcCiA402Drive::prepareCommandModeSwitch(
+  const std::vector<std::string> & start_interfaces,
+  const std::vector<std::string> & /*stop_interfaces*/)
+{
+  auto claimed = [&start_interfaces](const std::string & name) {
+      return std::find(start_interfaces.begin(), start_interfaces.end(), name) !=
+             start_interfaces.end();
+    };
+  // position takes precedence as velocity and effort can be claimed as feed-forward
+  if (claimed("position")) {
+    switch_mode_of_operation_ = ModeOfOperation::MODE_CYCLIC_SYNC_POSITION;
+  } else if (claimed("velocity")) {
+    switch_mode_of_operation_ = ModeOfOperation::MODE_CYCLIC_SYNC_VELOCITY;
+  } else if (claimed("effort")) {
+    switch_mode_of_operation_ = ModeOfOperation::MODE_CYCLIC_SYNC_TORQUE;
+  } else {
+    switch_mode_of_operation_ = -1;
+  }
+  return true;
+}
+
+bool EcCiA402Drive::performCommandModeSwitch(
+  const std::vector<std::string> & /*start_interfaces*/,
+  const std::vector<std::string> & /*stop_interfaces*/)
+{
+  if (switch_mode_of_operation_ >= 0) {
+    mode_of_operation_ = switch_mode_of_operation_;
+    mode_switch_pending_ = (mode_of_operation_display_ != mode_of_operation_);
+    switch_mode_of_operation_ = -1;
+  }
   return true;
 }
 
@@ -148,6 +376,19 @@ bool EcCiA402Drive::setup_from_config(YAML::Node drive_config)
   if (drive_config["auto_state_transitions"]) {
     auto_state_transitions_ = drive_config["auto_state_transitions"].as<bool>();
   }
+  if (drive_config["pvt_buffer_size"]) {
+    pvt_buffer_.resize(drive_config["pvt_buffer_size"].as<size_t>());
+  }
+  if (drive_config["limits"]) {
+    if (!limits_.load(drive_config["limits"])) {
+      return false;
+    }
+  }
+  if (drive_config["interpolated_position"]) {
+    if (!setup_interpolated_position(drive_config["interpolated_position"])) {
+      return false;
+    }
+  }
 
   // Find the default mode of operation if it was specified in the configuration file
   for (auto & channel : pdo_channels_info_) {
@@ -162,6 +403,41 @@ bool EcCiA402Drive::setup_from_config(YAML::Node drive_config)
   return true;
 }
 
+bool EcCiA402Drive::setup_interpolated_position(YAML::Node ip_config)
+{
+  auto add_sdo = [this](uint16_t index, uint8_t sub_index, std::string type, int value) {
+      ethercat_interface::SdoConfigEntry sdo;
+      sdo.index = index;
+      sdo.sub_index = sub_index;
+      sdo.data_type = type;
+      sdo.data = value;
+      sdo_config.push_back(sdo);
+    };
+
+  // interpolation time period: value * 10^index s
+  const int period = ip_config["period"] ? ip_config["period"].as<int>() : 1;
+  const int period_index = ip_config["period_index"] ? ip_config["period_index"].as<int>() : -3;
+  if (period <= 0 || period > 255 || period_index < -128 || period_index > 63) {
+    std::cerr << "EcCiA402Drive: invalid interpolation time period " << period << "e" <<
+      period_index << " s." << std::endl;
+    return false;
+  }
+  ip_period_ = period * std::pow(10.0, period_index);
+  add_sdo(CiA402D_SDO_IP_TIME_PERIOD, 1, "uint8", period);
+  add_sdo(CiA402D_SDO_IP_TIME_PERIOD, 2, "int8", period_index);
+
+  // drive buffer: size in records, 0 FIFO or 1 ring, then cleared and enabled
+  if (ip_config["buffer_size"]) {
+    add_sdo(CiA402D_SDO_IP_DATA_CONFIGURATION, 2, "uint32", ip_config["buffer_size"].as<int>());
+  }
+  if (ip_config["buffer_organization"]) {
+    add_sdo(
+      CiA402D_SDO_IP_DATA_CONFIGURATION, 3, "uint8", ip_config["buffer_organization"].as<int>());
+  }
+  add_sdo(CiA402D_SDO_IP_DATA_CONFIGURATION, 6, "uint8", 1);
+  return true;
+}
+
 bool EcCiA402Drive::setup_from_config_file(std::string config_file)
 {
   // Read drive configuration from YAML file
@@ -347,3 +347,417 @@ TEST_F(EcCiA402DriveTest, EcWriteDefaultTargetPosition)
     "Target position is NOT correctly set to actual value "
     "when command is NaN in velocity mode of operation (9)";
 }
+
+TEST_F(EcCiA402DriveTest, CommandModeSwitch)
+{
+  std::unordered_map<std::string, std::string> slave_paramters;
+  std::vector<double> command_interface = {
+    std::numeric_limits<double>::quiet_NaN(),
+    8};
+  slave_paramters["command_interface/mode_of_operation"] = "1";
+  plugin_->paramters_ = slave_paramters;
+  plugin_->command_interface_ptr_ = &command_interface;
+  plugin_->setup_from_config(YAML::Load(test_drive_config));
+  plugin_->setup_interface_mapping();
+  plugin_->is_operational_ = true;
+  plugin_->mode_of_operation_display_ = 8;
+  uint8_t domain_address[2];
+
+  ASSERT_TRUE(plugin_->prepareCommandModeSwitch({"velocity"}, {"position"}));
+  // nothing changes before the switch is performed
+  plugin_->processData(5, domain_address);
+  ASSERT_EQ(EC_READ_S8(domain_address), 8);
+
+  ASSERT_TRUE(plugin_->performCommandModeSwitch({"velocity"}, {"position"}));
+  ASSERT_TRUE(plugin_->mode_switch_pending_);
+  // switched mode overrides the command interface until confirmed by the drive
+  plugin_->processData(5, domain_address);
+  ASSERT_EQ(EC_READ_S8(domain_address), 9);
+  plugin_->processData(10, domain_address);
+  ASSERT_EQ(plugin_->mode_of_operation_display_, 9);
+  ASSERT_FALSE(plugin_->mode_switch_pending_);
+
+  // position has priority over velocity
+  ASSERT_TRUE(plugin_->prepareCommandModeSwitch({"velocity", "position"}, {}));
+  ASSERT_TRUE(plugin_->performCommandModeSwitch({"velocity", "position"}, {}));
+  ASSERT_EQ(plugin_->mode_of_operation_, 8);
+
+  // releasing interfaces only does not change the mode
+  ASSERT_TRUE(plugin_->prepareCommandModeSwitch({}, {"position"}));
+  ASSERT_TRUE(plugin_->performCommandModeSwitch({}, {"position"}));
+  ASSERT_EQ(plugin_->mode_of_operation_, 8);
+}
+
+TEST_F(EcCiA402DriveTest, StateUpdatedAtCycleEnd)
+{
+  std::vector<double> state_interface(10);
+  plugin_->state_interface_ptr_ = &state_interface;
+  plugin_->setup_from_config(YAML::Load(test_drive_config));
+  plugin_->setup_interface_mapping();
+  uint8_t domain_address[2];
+  EC_WRITE_U16(domain_address, 0x0027);  // operation enabled
+  plugin_->processData(9, domain_address);  // read status word
+  ASSERT_EQ(plugin_->state_, STATE_START);
+
+  plugin_->cycleEnd(0);
+  ASSERT_EQ(plugin_->state_, STATE_OPERATION_ENABLED);
+  ASSERT_FALSE(plugin_->initialized());
+  plugin_->cycleEnd(0);
+  ASSERT_TRUE(plugin_->initialized());
+}
+
+TEST(PvtBufferTest, InterpolatesBetweenPoints)
+{
+  ethercat_generic_plugins::PvtBuffer buffer;
+  buffer.resize(4);
+  ASSERT_EQ(buffer.push({{1.0, 0.0, 1.0}, {3.0, 0.0, 1.0}, {4.0, 0.0, -1.0}}), 2u);
+
+  double position = 0, velocity = 0;
+  // queued points wait for the start
+  ASSERT_EQ(
+    buffer.sample(0.25, 0.0, position, velocity), ethercat_generic_plugins::PvtBuffer::IDLE);
+  buffer.run(true);
+  ASSERT_EQ(
+    buffer.sample(0.25, 0.0, position, velocity), ethercat_generic_plugins::PvtBuffer::RUNNING);
+  ASSERT_DOUBLE_EQ(position, 0.0);
+  buffer.sample(0.25, 0.0, position, velocity);
+  buffer.sample(0.25, 0.0, position, velocity);
+  // middle of the first segment
+  ASSERT_DOUBLE_EQ(position, 0.5);
+  ASSERT_DOUBLE_EQ(velocity, 1.5);
+  for (int i = 0; i < 4; i++) {
+    buffer.sample(0.25, 0.0, position, velocity);
+  }
+  ASSERT_DOUBLE_EQ(position, 2.0);
+  ASSERT_DOUBLE_EQ(velocity, 3.0);
+
+  // ends at rest, no underrun
+  for (int i = 0; i < 3; i++) {
+    buffer.sample(0.25, 0.0, position, velocity);
+  }
+  ASSERT_EQ(
+    buffer.sample(0.25, 0.0, position, velocity), ethercat_generic_plugins::PvtBuffer::HOLDING);
+  ASSERT_DOUBLE_EQ(position, 3.0);
+  ASSERT_DOUBLE_EQ(velocity, 0.0);
+  ASSERT_EQ(buffer.underruns(), 0u);
+
+  buffer.run(false);
+  ASSERT_EQ(
+    buffer.sample(0.25, 0.0, position, velocity), ethercat_generic_plugins::PvtBuffer::IDLE);
+}
+
+TEST(PvtBufferTest, HoldsOnUnderrun)
+{
+  ethercat_generic_plugins::PvtBuffer buffer;
+  buffer.resize(2);
+  ASSERT_EQ(buffer.push({{1.0, 2.0, 0.5}, {2.0, 2.0, 0.5}, {3.0, 2.0, 0.5}}), 2u);
+  buffer.run(true);
+
+  double position = 0, velocity = 0;
+  for (int i = 0; i < 4; i++) {
+    buffer.sample(0.25, 0.0, position, velocity);
+  }
+  ASSERT_DOUBLE_EQ(position, 1.5);
+  // the points are consumed, the queue accepts more while running
+  ASSERT_EQ(buffer.push({{3.0, 2.0, 0.5}}), 1u);
+  for (int i = 0; i < 4; i++) {
+    buffer.sample(0.25, 0.0, position, velocity);
+  }
+  ASSERT_DOUBLE_EQ(position, 3.0);
+
+  // the trajectory ran dry while moving
+  ASSERT_EQ(
+    buffer.sample(0.25, 0.0, position, velocity), ethercat_generic_plugins::PvtBuffer::HOLDING);
+  ASSERT_DOUBLE_EQ(position, 3.0);
+  ASSERT_DOUBLE_EQ(velocity, 0.0);
+  ASSERT_EQ(buffer.underruns(), 1u);
+
+  // new points resume from the hold position
+  buffer.push({{4.0, 0.0, 0.5}});
+  ASSERT_EQ(
+    buffer.sample(0.25, 0.0, position, velocity), ethercat_generic_plugins::PvtBuffer::RUNNING);
+  ASSERT_DOUBLE_EQ(position, 3.0);
+}
+
+TEST(PvtBufferTest, TakesWholePoints)
+{
+  ethercat_generic_plugins::PvtBuffer buffer;
+  buffer.resize(4);
+  buffer.push({{1.0, 1.0, 0.5}, {2.0, 1.0, 0.5}});
+  ethercat_interface::PvtPoint point;
+  ASSERT_EQ(buffer.next(point), ethercat_generic_plugins::PvtBuffer::IDLE);
+  ASSERT_EQ(buffer.size(), 2u);
+
+  buffer.run(true);
+  ASSERT_EQ(buffer.next(point), ethercat_generic_plugins::PvtBuffer::RUNNING);
+  ASSERT_DOUBLE_EQ(point.position, 1.0);
+  ASSERT_EQ(buffer.size(), 1u);
+  ASSERT_EQ(buffer.next(point), ethercat_generic_plugins::PvtBuffer::RUNNING);
+  ASSERT_DOUBLE_EQ(point.position, 2.0);
+  // empty while moving: the point is kept and the underrun counted once
+  ASSERT_EQ(buffer.next(point), ethercat_generic_plugins::PvtBuffer::HOLDING);
+  ASSERT_EQ(buffer.next(point), ethercat_generic_plugins::PvtBuffer::HOLDING);
+  ASSERT_DOUBLE_EQ(point.position, 2.0);
+  ASSERT_EQ(buffer.underruns(), 1u);
+
+  buffer.run(false);
+  ASSERT_EQ(buffer.next(point), ethercat_generic_plugins::PvtBuffer::IDLE);
+}
+
+TEST_F(EcCiA402DriveTest, ExecutesPvtTrajectory)
+{
+  std::vector<double> state_interface(2);
+  std::vector<double> command_interface = {
+    100,  // target position
+    std::numeric_limits<double>::quiet_NaN(),  // target velocity
+    std::numeric_limits<double>::quiet_NaN(),  // target torque
+    std::numeric_limits<double>::quiet_NaN(),  // max torque
+    std::numeric_limits<double>::quiet_NaN(),  // control word
+    8  // mode of operation
+  };
+  plugin_->paramters_["state_interface/position"] = "0";
+  plugin_->paramters_["state_interface/pvt_state"] = "1";
+  plugin_->paramters_["command_interface/position"] = "0";
+  plugin_->state_interface_ptr_ = &state_interface;
+  plugin_->command_interface_ptr_ = &command_interface;
+  YAML::Node config = YAML::Load(test_drive_config);
+  config["pvt_buffer_size"] = 16;
+  plugin_->setup_from_config(config);
+  plugin_->setup_interface_mapping();
+  plugin_->pvt_state_interface_index_ = 1;
+  plugin_->bus_cycle_time_ = 0.001;
+  plugin_->mode_of_operation_display_ = 8;
+
+  uint8_t domain_address[4];
+  EC_WRITE_S32(domain_address, 1000);
+  plugin_->processData(6, domain_address);  // read position actual value
+
+  // without trajectory the command of the controller is sent
+  plugin_->newCycle(0);
+  plugin_->processData(0, domain_address);
+  ASSERT_EQ(EC_READ_S32(domain_address), 100);
+
+  ASSERT_EQ(plugin_->loadTrajectory({{1010, 0, 0.002}}), 1u);
+  ASSERT_TRUE(plugin_->runTrajectory(true));
+  plugin_->newCycle(0);
+  plugin_->processData(0, domain_address);
+  plugin_->cycleEnd(0);
+  // starts from the actual position
+  ASSERT_EQ(EC_READ_S32(domain_address), 1000);
+  ASSERT_EQ(state_interface[1], ethercat_generic_plugins::PvtBuffer::RUNNING);
+
+  // processed twice in a split cycle, sampled once
+  plugin_->newCycle(0);
+  plugin_->processData(0, domain_address);
+  plugin_->processData(0, domain_address);
+  ASSERT_EQ(EC_READ_S32(domain_address), 1005);
+  plugin_->processData(1, domain_address);
+  ASSERT_EQ(EC_READ_S32(domain_address), 7500);
+
+  plugin_->newCycle(0);
+  plugin_->newCycle(0);
+  plugin_->processData(0, domain_address);
+  plugin_->cycleEnd(0);
+  ASSERT_EQ(EC_READ_S32(domain_address), 1010);
+  ASSERT_EQ(state_interface[1], ethercat_generic_plugins::PvtBuffer::HOLDING);
+
+  ASSERT_TRUE(plugin_->runTrajectory(false));
+  plugin_->newCycle(0);
+  plugin_->processData(0, domain_address);
+  ASSERT_EQ(EC_READ_S32(domain_address), 100);
+}
+
+TEST_F(EcCiA402DriveTest, SetupInterpolatedPosition)
+{
+  YAML::Node config = YAML::Load(test_drive_config);
+  config["interpolated_position"] =
+    YAML::Load("{period: 2, period_index: -3, buffer_size: 8, buffer_organization: 0}");
+  ASSERT_TRUE(plugin_->setup_from_config(config));
+  ASSERT_DOUBLE_EQ(plugin_->ip_period_, 0.002);
+
+  // appended to the startup SDOs of the configuration
+  ASSERT_EQ(plugin_->sdo_config.size(), 7u);
+  ASSERT_EQ(plugin_->sdo_config[2].index, 0x60C2);
+  ASSERT_EQ(plugin_->sdo_config[2].sub_index, 1);
+  ASSERT_EQ(plugin_->sdo_config[2].data, 2);
+  ASSERT_EQ(plugin_->sdo_config[3].sub_index, 2);
+  ASSERT_EQ(plugin_->sdo_config[3].data_type, "int8");
+  ASSERT_EQ(plugin_->sdo_config[3].data, -3);
+  ASSERT_EQ(plugin_->sdo_config[4].index, 0x60C4);
+  ASSERT_EQ(plugin_->sdo_config[4].sub_index, 2);
+  ASSERT_EQ(plugin_->sdo_config[4].data, 8);
+  ASSERT_EQ(plugin_->sdo_config[6].sub_index, 6);
+  ASSERT_EQ(plugin_->sdo_config[6].data, 1);
+
+  plugin_->sdo_config.clear();
+  config["interpolated_position"]["period"] = 0;
+  ASSERT_FALSE(plugin_->setup_from_config(config));
+}
+
+TEST_F(EcCiA402DriveTest, FeedsInterpolatedPositionRecords)
+{
+  std::vector<double> state_interface(3);
+  std::vector<double> command_interface(6, std::numeric_limits<double>::quiet_NaN());
+  command_interface[5] = 7;
+  plugin_->paramters_["state_interface/pvt_state"] = "0";
+  plugin_->paramters_["state_interface/pvt_underruns"] = "1";
+  plugin_->paramters_["state_interface/pvt_queued"] = "2";
+  plugin_->paramters_["command_interface/mode_of_operation"] = "5";
+  plugin_->state_interface_ptr_ = &state_interface;
+  plugin_->command_interface_ptr_ = &command_interface;
+  YAML::Node config = YAML::Load(test_drive_config);
+  config["pvt_buffer_size"] = 8;
+  config["interpolated_position"] = YAML::Load("{period: 2, period_index: -3}");
+  // interpolation data record in place of the max torque
+  config["rpdo"][0]["channels"][3] =
+    YAML::Load("{index: 0x60c1, sub_index: 1, type: int32, command_interface: ~}");
+  plugin_->setup_from_config(config);
+  plugin_->setup_interface_mapping();
+  plugin_->pvt_state_interface_index_ = 0;
+  plugin_->pvt_underruns_interface_index_ = 1;
+  plugin_->pvt_queued_interface_index_ = 2;
+  plugin_->bus_cycle_time_ = 0.001;
+  plugin_->ip_cycles_ = 2;
+  plugin_->is_operational_ = true;
+  plugin_->mode_of_operation_display_ = 7;
+
+  uint8_t domain_address[4];
+  uint8_t domain_address_cw[2];
+  EC_WRITE_U16(domain_address_cw, 0x0027);  // operation enabled
+  plugin_->processData(9, domain_address_cw);  // read status word
+  plugin_->cycleEnd(0);
+  EC_WRITE_S32(domain_address, 1000);
+  plugin_->processData(6, domain_address);  // read position actual value
+
+  // idle: the record follows the actual position and the interpolation is disabled
+  plugin_->newCycle(0);
+  plugin_->processData(3, domain_address);
+  ASSERT_EQ(EC_READ_S32(domain_address), 1000);
+  EC_WRITE_U16(domain_address_cw, 0x001f);
+  plugin_->processData(4, domain_address_cw);
+  ASSERT_EQ(EC_READ_U16(domain_address_cw), 0x000f);
+
+  plugin_->loadTrajectory({{1010, 0, 0.002}, {1020, 0, 0.002}});
+  plugin_->runTrajectory(true);
+  std::vector<int32_t> records;
+  for (int i = 0; i < 6; i++) {
+    plugin_->newCycle(0);
+    plugin_->processData(3, domain_address);
+    records.push_back(EC_READ_S32(domain_address));
+    plugin_->processData(4, domain_address_cw);
+    ASSERT_EQ(EC_READ_U16(domain_address_cw), 0x001f);
+    plugin_->cycleEnd(0);
+    if (i == 0) {
+      ASSERT_EQ(state_interface[0], ethercat_generic_plugins::PvtBuffer::RUNNING);
+      ASSERT_EQ(state_interface[2], 1);
+    }
+  }
+  // one record per interpolation period, then the last one is held
+  ASSERT_EQ(records, std::vector<int32_t>({1010, 1010, 1020, 1020, 1020, 1020}));
+  ASSERT_EQ(state_interface[0], ethercat_generic_plugins::PvtBuffer::HOLDING);
+  ASSERT_EQ(state_interface[1], 0);
+
+  plugin_->runTrajectory(false);
+  plugin_->newCycle(0);
+  plugin_->processData(4, domain_address_cw);
+  ASSERT_EQ(EC_READ_U16(domain_address_cw), 0x000f);
+}
+
+TEST(SoftLimitsTest, LimitsPositionStream)
+{
+  ethercat_generic_plugins::SoftLimits limits;
+  ASSERT_TRUE(
+    limits.load(YAML::Load("{position: {min: -1, max: 1}, velocity: 10, acceleration: 100}")));
+  limits.setCycleTime(0.01);
+  // the first target of a stream is only clamped
+  ASSERT_EQ(limits.position(0, true), 0);
+  limits.commit();
+  std::vector<double> targets;
+  for (int i = 0; i < 30; i++) {
+    targets.push_back(limits.position(5, true));
+    limits.commit();
+  }
+  // accelerated at 100, up to 10, and stopped at the max
+  ASSERT_NEAR(targets[0], 0.01, 1e-12);
+  ASSERT_NEAR(targets[1], 0.03, 1e-12);
+  ASSERT_NEAR(targets[10] - targets[9], 0.1, 1e-12);
+  ASSERT_NEAR(targets[12] - targets[11], 0.1, 1e-12);
+  ASSERT_EQ(targets.back(), 1);
+  ASSERT_EQ(limits.violations(ethercat_generic_plugins::SoftLimits::ACCELERATION), 30u);
+  ASSERT_GT(limits.violations(ethercat_generic_plugins::SoftLimits::VELOCITY), 0u);
+  ASSERT_GT(limits.violations(ethercat_generic_plugins::SoftLimits::POSITION), 0u);
+
+  // targets the drive does not follow are passed through, a stream starting out of the
+  // range can only move back into it
+  ASSERT_EQ(limits.position(-5, false), -5);
+  limits.commit();
+  ASSERT_EQ(limits.position(-6, true), -5);
+  ASSERT_NEAR(limits.position(-0.5, true), -4.99, 1e-12);
+  ASSERT_TRUE(std::isnan(limits.position(std::nan(""), true)));
+
+  ASSERT_FALSE(limits.load(YAML::Load("{position: {min: 1, max: -1}}")));
+  ASSERT_FALSE(limits.load(YAML::Load("{torque: -1}")));
+}
+
+TEST(SoftLimitsTest, LimitsVelocityAndTorque)
+{
+  ethercat_generic_plugins::SoftLimits limits;
+  ASSERT_TRUE(limits.load(YAML::Load("{velocity: 2, acceleration: 10, torque: 3}")));
+  limits.setCycleTime(0.1);
+  ASSERT_EQ(limits.velocity(0, true), 0);
+  limits.commit();
+  ASSERT_EQ(limits.velocity(5, true), 1);
+  limits.commit();
+  ASSERT_EQ(limits.velocity(5, true), 2);
+  limits.commit();
+  ASSERT_EQ(limits.velocity(-5, false), -2);
+  ASSERT_EQ(limits.torque(-4), -3);
+  ASSERT_EQ(limits.torque(2.5), 2.5);
+  limits.commit();
+  ASSERT_EQ(limits.violations(ethercat_generic_plugins::SoftLimits::ACCELERATION), 2u);
+  ASSERT_EQ(limits.violations(ethercat_generic_plugins::SoftLimits::VELOCITY), 1u);
+  ASSERT_EQ(limits.violations(ethercat_generic_plugins::SoftLimits::TORQUE), 0u);
+}
+
+TEST_F(EcCiA402DriveTest, LimitsTargets)
+{
+  std::vector<double> state_interface(2);
+  std::vector<double> command_interface = {500, 42};
+  plugin_->paramters_["command_interface/position"] = "0";
+  plugin_->paramters_["command_interface/effort"] = "1";
+  plugin_->paramters_["state_interface/position_limit_violations"] = "0";
+  plugin_->paramters_["state_interface/torque_limit_violations"] = "1";
+  plugin_->paramters_["bus_frequency"] = "1000";
+  plugin_->state_interface_ptr_ = &state_interface;
+  plugin_->command_interface_ptr_ = &command_interface;
+  YAML::Node config = YAML::Load(test_drive_config);
+  config["limits"] = YAML::Load("{position: {min: -100, max: 100}, torque: 20}");
+  config["rpdo"][0]["channels"][2]["factor"] = 2;
+  ASSERT_TRUE(plugin_->setup_from_config(config));
+  plugin_->setup_interface_mapping();
+  plugin_->limits_.setCycleTime(0.001);
+  plugin_->limit_violations_interface_index_[0] = 0;
+  plugin_->limit_violations_interface_index_[3] = 1;
+  plugin_->mode_of_operation_display_ = 8;
+
+  uint8_t domain_address[4];
+  for (int cycle = 0; cycle < 2; cycle++) {
+    plugin_->newCycle(0);
+    plugin_->processData(0, domain_address);
+    ASSERT_EQ(EC_READ_S32(domain_address), 100);
+    // in the units of the command interface, before the factor
+    plugin_->processData(2, domain_address);
+    ASSERT_EQ(EC_READ_S16(domain_address), 40);
+    plugin_->cycleEnd(0);
+  }
+  plugin_->newCycle(0);
+  plugin_->cycleEnd(0);
+  ASSERT_EQ(state_interface[0], 2);
+  ASSERT_EQ(state_interface[1], 2);
+
+  // out of the position modes, the target follows the actual position out of the range
+  plugin_->mode_of_operation_display_ = 9;
+  plugin_->last_position_ = -500;
+  plugin_->processData(0, domain_address);
+  ASSERT_EQ(EC_READ_S32(domain_address), -500);
+}
@@ -37,6 +37,12 @@ class FriendEcCiA402Drive : public ethercat_generic_plugins::EcCiA402Drive
   // FRIEND_TEST(EcCiA402DriveTest, FaultReset);
   FRIEND_TEST(EcCiA402DriveTest, SwitchModeOfOperation);
   FRIEND_TEST(EcCiA402DriveTest, EcWriteDefaultTargetPosition);
+  FRIEND_TEST(EcCiA402DriveTest, CommandModeSwitch);
+  FRIEND_TEST(EcCiA402DriveTest, StateUpdatedAtCycleEnd);
+  FRIEND_TEST(EcCiA402DriveTest, ExecutesPvtTrajectory);
+  FRIEND_TEST(EcCiA402DriveTest, SetupInterpolatedPosition);
+  FRIEND_TEST(EcCiA402DriveTest, FeedsInterpolatedPositionRecords);
+  FRIEND_TEST(EcCiA402DriveTest, LimitsTargets);
 };
 
 class EcCiA402DriveTest : public ::testing::Test
@@ -17,6 +17,7 @@
 #ifndef ETHERCAT_GENERIC_PLUGINS__GENERIC_EC_SLAVE_HPP_
 #define ETHERCAT_GENERIC_PLUGINS__GENERIC_EC_SLAVE_HPP_
 
+#include <limits>
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -25,6 +26,8 @@
 #include "ethercat_interface/ec_slave.hpp"
 #include "ethercat_interface/ec_pdo_channel_manager.hpp"
 #include "ethercat_interface/ec_sync_manager.hpp"
+#include "ethercat_interface/ec_expression.hpp"
+#include "ethercat_interface/ec_lut.hpp"
 
 namespace ethercat_generic_plugins
 {
@@ -35,8 +38,12 @@ public:
   GenericEcSlave();
   virtual ~GenericEcSlave();
   virtual int assign_activate_dc_sync();
+  virtual ethercat_interface::DcSyncConfig dc_sync_config() const;
 
   virtual void processData(size_t index, uint8_t * domain_address);
+  virtual void newCycle(uint32_t domain);
+  virtual void writePass(uint32_t domain);
+  virtual void cycleEnd(uint32_t domain);
 
   virtual const ec_sync_info_t * syncs();
   virtual size_t syncSize();
@@ -48,6 +55,12 @@ public:
     std::vector<double> * state_interface,
     std::vector<double> * command_interface);
 
+  virtual bool setChannelParameters(
+    uint16_t index, uint8_t sub_index,
+    const ethercat_interface::ChannelParameters & parameters);
+
+  virtual void resetStateAggregation();
+
 protected:
   uint32_t counter_ = 0;
   std::vector<ec_pdo_info_t> rpdos_;
@@ -59,12 +72,33 @@ protected:
   std::vector<unsigned int> domain_map_;
   YAML::Node slave_config_;
   uint32_t assign_activate_ = 0;
+  ethercat_interface::DcSyncConfig dc_sync_config_;
+  /** false in the write pass of a cycle, whose inputs were read in its read pass */
+  bool read_inputs_ = true;
+
+  /** calibration curves of the channels with a lut, by their index in pdo_channels_info_ */
+  ethercat_interface::LookupTableBatch lut_batch_;
+  std::vector<size_t> lut_channels_;
+
+  /** state interface computed from the other channels of the slave at each cycle */
+  struct VirtualChannel
+  {
+    std::string interface_name;
+    int expression = -1;
+    int interface_index = -1;
+    double value = std::numeric_limits<double>::quiet_NaN();
+  };
+  std::vector<VirtualChannel> virtual_channels_;
+  ethercat_interface::ExpressionProgram virtual_program_;
 
   /** set up of the drive configuration from yaml node*/
   bool setup_from_config(YAML::Node slave_config);
   /** set up of the drive configuration from yaml file*/
   bool setup_from_config_file(std::string config_file);
 
+  /** compile the virtual channels of the configuration, after the PDO channels */
+  bool setup_virtual_channels(YAML::Node virtual_config);
+
   void setup_syncs();
 
   void setup_interface_mapping();
@@ -40,10 +40,36 @@ GenericEcSlave::GenericEcSlave()
 : EcSlave(0, 0) {}
 GenericEcSlave::~GenericEcSlave() {}
 int GenericEcSlave::assign_activate_dc_sync() {return assign_activate_;}
+ethercat_interface::DcSyncConfig GenericEcSlave::dc_sync_config() const {return dc_sync_config_;}
 
 void GenericEcSlave::processData(size_t index, uint8_t * domain_address)
 {
-  pdo_channels_info_[domain_map_[index]].ec_update(domain_address);
+  pdo_channels_info_[domain_map_[index]].ec_update(domain_address, read_inputs_);
+}
+
+void GenericEcSlave::newCycle(uint32_t /*domain*/) {read_inputs_ = true;}
+void GenericEcSlave::writePass(uint32_t /*domain*/) {read_inputs_ = false;}
+
+void GenericEcSlave::cycleEnd(uint32_t /*domain*/)
+{
+  // the channels of the slave were all decoded in this pass
+  if (!lut_channels_.empty()) {
+    double * inputs = lut_batch_.inputs();
+    for (auto i = 0ul; i < lut_channels_.size(); i++) {
+      inputs[i] = pdo_channels_info_[lut_channels_[i]].last_value;
+    }
+    lut_batch_.evaluate();
+    const double * outputs = lut_batch_.outputs();
+    for (auto i = 0ul; i < lut_channels_.size(); i++) {
+      pdo_channels_info_[lut_channels_[i]].update_state(outputs[i]);
+    }
+  }
+  for (auto & channel : virtual_channels_) {
+    channel.value = virtual_program_.evaluate(channel.expression);
+    if (channel.interface_index >= 0) {
+      state_interface_ptr_->at(channel.interface_index) = channel.value;
+    }
+  }
 }
 
 const ec_sync_info_t * GenericEcSlave::syncs()
@@ -116,6 +142,27 @@ bool GenericEcSlave::setupSlave(
   return true;
 }
 
+bool GenericEcSlave::setChannelParameters(
+  uint16_t index, uint8_t sub_index,
+  const ethercat_interface::ChannelParameters & parameters)
+{
+  bool found = false;
+  for (auto & channel : pdo_channels_info_) {
+    if (channel.index == index && channel.sub_index == sub_index) {
+      channel.set_parameters(parameters);
+      found = true;
+    }
+  }
+  return found;
+}
+
+void GenericEcSlave::resetStateAggregation()
+{
+  for (auto & channel : pdo_channels_info_) {
+    channel.reset_aggregation();
+  }
+}
+
 bool GenericEcSlave::setup_from_config(YAML::Node slave_config)
 {
   if (slave_config.size() != 0) {
@@ -134,6 +181,21 @@ bool GenericEcSlave::setup_from_config(YAML::Node slave_config)
     if (slave_config["assign_activate"]) {
       assign_activate_ = slave_config["assign_activate"].as<uint32_t>();
     }
+    if (slave_config["dc"]) {
+      const auto dc = slave_config["dc"];
+      if (dc["sync0_cycle"]) {
+        dc_sync_config_.sync0_cycle = dc["sync0_cycle"].as<uint32_t>();
+      }
+      if (dc["sync0_shift"]) {
+        dc_sync_config_.sync0_shift = dc["sync0_shift"].as<int32_t>();
+      }
+      if (dc["sync1_cycle"]) {
+        dc_sync_config_.sync1_cycle = dc["sync1_cycle"].as<uint32_t>();
+      }
+      if (dc["sync1_shift"]) {
+        dc_sync_config_.sync1_shift = dc["sync1_shift"].as<int32_t>();
+      }
+    }
 
     if (slave_config["sm"]) {
       for (const auto & sm : slave_config["sm"]) {
@@ -197,7 +259,9 @@ bool GenericEcSlave::setup_from_config(YAML::Node slave_config)
         for (auto c = 0ul; c < tpdo_channels_size; c++) {
           ethercat_interface::EcPdoChannelManager channel_info;
           channel_info.pdo_type = ethercat_interface::TPDO;
-          channel_info.load_from_config(slave_config["tpdo"][i]["channels"][c]);
+          if (!channel_info.load_from_config(slave_config["tpdo"][i]["channels"][c])) {
+            return false;
+          }
           pdo_channels_info_.push_back(channel_info);
           all_channels_.push_back(channel_info.get_pdo_entry_info());
         }
@@ -219,6 +283,18 @@ bool GenericEcSlave::setup_from_config(YAML::Node slave_config)
       }
     }
 
+    // calibration curves evaluated together in cycleEnd()
+    for (auto i = 0ul; i < pdo_channels_info_.size(); i++) {
+      if (!pdo_channels_info_[i].lut.input.empty()) {
+        pdo_channels_info_[i].deferred_state = true;
+        lut_batch_.add(pdo_channels_info_[i].lut);
+        lut_channels_.push_back(i);
+      }
+    }
+
+    if (slave_config["virtual_channels"]) {
+      return setup_virtual_channels(slave_config["virtual_channels"]);
+    }
     return true;
   } else {
     std::cerr << "GenericEcSlave: failed to load slave configuration: empty configuration" <<
@@ -245,6 +321,47 @@ bool GenericEcSlave::setup_from_config_file(std::string config_file)
   return true;
 }
 
+bool GenericEcSlave::setup_virtual_channels(YAML::Node virtual_config)
+{
+  // the expressions point to the channel values, which must not move anymore
+  virtual_channels_.reserve(virtual_config.size());
+  auto resolve = [this](const std::string & name) -> const double * {
+      for (const auto & channel : virtual_channels_) {
+        if (channel.interface_name == name) {
+          return &channel.value;
+        }
+      }
+      for (const auto pdo_type : {ethercat_interface::TPDO, ethercat_interface::RPDO}) {
+        for (const auto & channel : pdo_channels_info_) {
+          if (channel.pdo_type == pdo_type && channel.interface_name == name) {
+            return &channel.last_value;
+          }
+        }
+      }
+      return NULL;
+    };
+  for (const auto & config : virtual_config) {
+    VirtualChannel channel;
+    std::string expression;
+    try {
+      channel.interface_name = config["state_interface"].as<std::string>();
+      expression = config["expression"].as<std::string>();
+    } catch (const YAML::Exception & ex) {
+      std::cerr << "GenericEcSlave: invalid virtual channel: " << ex.what() << std::endl;
+      return false;
+    }
+    std::string error;
+    channel.expression = virtual_program_.compile(expression, resolve, error);
+    if (channel.expression < 0) {
+      std::cerr << "GenericEcSlave: virtual channel " << channel.interface_name << ": " <<
+        error << std::endl;
+      return false;
+    }
+    virtual_channels_.push_back(channel);
+  }
+  return true;
+}
+
 void GenericEcSlave::setup_interface_mapping()
 {
   for (auto & channel : pdo_channels_info_) {
@@ -263,6 +380,11 @@ void GenericEcSlave::setup_interface_mapping()
 
     channel.setup_interface_ptrs(state_interface_ptr_, command_interface_ptr_);
   }
+  for (auto & channel : virtual_channels_) {
+    if (paramters_.find("state_interface/" + channel.interface_name) != paramters_.end()) {
+      channel.interface_index = std::stoi(paramters_["state_interface/" + channel.interface_name]);
+    }
+  }
 }
 
 }  // namespace ethercat_generic_plugins
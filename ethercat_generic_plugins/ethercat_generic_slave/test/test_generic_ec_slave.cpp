@@ -23,6 +23,7 @@ const char test_slave_config[] =
 vendor_id: 0x00000011
 product_id: 0x07030924
 assign_activate: 0x0321  # DC Synch register
+dc: {sync0_shift: 250000, sync1_cycle: 2000000}  # DC sync signals in ns
 sdo:  # sdo data to be transferred at slave startup
   - {index: 0x60C2, sub_index: 1, type: int8, value: 10}
   - {index: 0x60C2, sub_index: 2, type: int8, value: -3}
@@ -111,6 +112,10 @@ TEST_F(GenericEcSlaveTest, SlaveSetupSlaveFromConfig)
   ASSERT_EQ(plugin_->vendor_id_, 0x00000011);
   ASSERT_EQ(plugin_->product_id_, 0x07030924);
   ASSERT_EQ(plugin_->assign_activate_, 0x0321);
+  ASSERT_EQ(plugin_->dc_sync_config_.sync0_cycle, 0u);
+  ASSERT_EQ(*plugin_->dc_sync_config_.sync0_shift, 250000);
+  ASSERT_EQ(plugin_->dc_sync_config_.sync1_cycle, 2000000u);
+  ASSERT_EQ(plugin_->dc_sync_config_.sync1_shift, 0);
 
   ASSERT_EQ(plugin_->rpdos_.size(), 1);
   ASSERT_EQ(plugin_->rpdos_[0].index, 0x1607);
@@ -250,3 +255,112 @@ TEST_F(GenericEcSlaveTest, SlaveSetupSyncManagerConfig)
   ASSERT_EQ(plugin_->sm_configs_[2].pdo_name, "rpdo");
   ASSERT_EQ(plugin_->sm_configs_[2].watchdog, EC_WD_ENABLE);
 }
+
+TEST_F(GenericEcSlaveTest, VirtualChannelsFromExpressions)
+{
+  SetUp();
+  YAML::Node config = YAML::Load(test_slave_config);
+  config["virtual_channels"] = YAML::Load(
+    "[{state_interface: analog_difference, expression: 'analog_input1 - analog_input2'},"
+    " {state_interface: analog_word, expression: 'analog_input1 * 65536 + analog_input2'},"
+    " {state_interface: difference_ok, expression: 'analog_difference < 0'}]");
+  std::unordered_map<std::string, std::string> slave_paramters;
+  std::vector<double> state_interface = {0, 0, 0};
+  plugin_->state_interface_ptr_ = &state_interface;
+  slave_paramters["state_interface/analog_difference"] = "0";
+  slave_paramters["state_interface/difference_ok"] = "2";
+  plugin_->paramters_ = slave_paramters;
+  ASSERT_TRUE(plugin_->setup_from_config(config));
+  plugin_->setup_interface_mapping();
+  ASSERT_EQ(plugin_->virtual_channels_.size(), 3);
+  ASSERT_EQ(plugin_->virtual_channels_[0].interface_index, 0);
+  ASSERT_EQ(plugin_->virtual_channels_[1].interface_index, -1);
+
+  uint8_t domain_address[2];
+  EC_WRITE_S16(domain_address, 3);
+  plugin_->processData(11, domain_address);
+  EC_WRITE_S16(domain_address, 5);
+  plugin_->processData(12, domain_address);
+  plugin_->cycleEnd(0);
+  ASSERT_EQ(state_interface[0], -2);
+  ASSERT_EQ(plugin_->virtual_channels_[1].value, 3 * 65536 + 5);
+  ASSERT_EQ(state_interface[2], 1);
+}
+
+TEST_F(GenericEcSlaveTest, SlaveSetupInvalidVirtualChannel)
+{
+  SetUp();
+  YAML::Node config = YAML::Load(test_slave_config);
+  config["virtual_channels"] = YAML::Load(
+    "[{state_interface: sum, expression: 'analog_input1 + unknown_input'}]");
+  ASSERT_FALSE(plugin_->setup_from_config(config));
+}
+
+TEST_F(GenericEcSlaveTest, LutChannelsCalibrateStates)
+{
+  SetUp();
+  YAML::Node config = YAML::Load(test_slave_config);
+  config["tpdo"][1]["channels"][0]["lut"] = YAML::Load("{input: [0, 10, 20], output: [0, 5, 20]}");
+  config["tpdo"][1]["channels"][1]["factor"] = 2;
+  config["tpdo"][1]["channels"][1]["lut"] = YAML::Load("{input: [0, 10], output: [100, 0]}");
+  config["virtual_channels"] = YAML::Load(
+    "[{state_interface: analog_sum, expression: 'analog_input1 + analog_input2'}]");
+  std::unordered_map<std::string, std::string> slave_paramters;
+  std::vector<double> state_interface = {0, 0, 0};
+  plugin_->state_interface_ptr_ = &state_interface;
+  slave_paramters["state_interface/analog_input1"] = "0";
+  slave_paramters["state_interface/analog_input2"] = "1";
+  slave_paramters["state_interface/analog_sum"] = "2";
+  plugin_->paramters_ = slave_paramters;
+  ASSERT_TRUE(plugin_->setup_from_config(config));
+  plugin_->setup_interface_mapping();
+  ASSERT_EQ(plugin_->lut_channels_, std::vector<size_t>({11, 12}));
+
+  uint8_t domain_address[2];
+  EC_WRITE_S16(domain_address, 15);
+  plugin_->processData(11, domain_address);
+  EC_WRITE_S16(domain_address, 3);
+  plugin_->processData(12, domain_address);
+  // the states are written once the curves are applied, after factor and offset
+  ASSERT_EQ(state_interface[0], 0);
+  plugin_->cycleEnd(0);
+  ASSERT_EQ(state_interface[0], 12.5);
+  ASSERT_EQ(state_interface[1], 40);
+  ASSERT_EQ(state_interface[2], 52.5);
+
+  config["tpdo"][1]["channels"][1]["lut"] = YAML::Load("{input: [0, 10], output: [100]}");
+  SetUp();
+  ASSERT_FALSE(plugin_->setup_from_config(config));
+}
+
+TEST_F(GenericEcSlaveTest, InputsAggregatedOncePerCycle)
+{
+  SetUp();
+  YAML::Node config = YAML::Load(test_slave_config);
+  config["tpdo"][1]["channels"][0]["aggregation"] = "sum";
+  config["tpdo"][1]["channels"][0]["lut"] = YAML::Load("{input: [0, 10], output: [0, 20]}");
+  config["tpdo"][1]["channels"][1]["aggregation"] = "sum";
+  std::unordered_map<std::string, std::string> slave_paramters;
+  std::vector<double> state_interface = {0, 0};
+  plugin_->state_interface_ptr_ = &state_interface;
+  slave_paramters["state_interface/analog_input1"] = "0";
+  slave_paramters["state_interface/analog_input2"] = "1";
+  plugin_->paramters_ = slave_paramters;
+  ASSERT_TRUE(plugin_->setup_from_config(config));
+  plugin_->setup_interface_mapping();
+
+  uint8_t domain_address[2];
+  EC_WRITE_S16(domain_address, 3);
+  for (int cycle = 1; cycle <= 2; cycle++) {
+    // read pass and write pass of a split cycle
+    plugin_->newCycle(0);
+    plugin_->processData(11, domain_address);
+    plugin_->processData(12, domain_address);
+    plugin_->cycleEnd(0);
+    plugin_->writePass(0);
+    plugin_->processData(11, domain_address);
+    plugin_->processData(12, domain_address);
+    ASSERT_EQ(state_interface[0], 6 * cycle);
+    ASSERT_EQ(state_interface[1], 3 * cycle);
+  }
+}
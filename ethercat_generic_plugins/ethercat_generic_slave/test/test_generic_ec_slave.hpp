@@ -36,6 +36,10 @@ class FriendGenericEcSlave : public ethercat_generic_plugins::GenericEcSlave
   FRIEND_TEST(GenericEcSlaveTest, EcWriteRPDODefaultValue);
   FRIEND_TEST(GenericEcSlaveTest, SlaveSetupSDOConfig);
   FRIEND_TEST(GenericEcSlaveTest, SlaveSetupSyncManagerConfig);
+  FRIEND_TEST(GenericEcSlaveTest, VirtualChannelsFromExpressions);
+  FRIEND_TEST(GenericEcSlaveTest, SlaveSetupInvalidVirtualChannel);
+  FRIEND_TEST(GenericEcSlaveTest, LutChannelsCalibrateStates);
+  FRIEND_TEST(GenericEcSlaveTest, InputsAggregatedOncePerCycle);
 };
 
 class GenericEcSlaveTest : public ::testing::Test
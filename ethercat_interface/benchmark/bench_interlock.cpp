@@ -0,0 +1,154 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cost of the interlock rules evaluated at each bus cycle by InterlockEngine.
+// For each number of rules, typical interlock conditions over digital and analog inputs
+// are compiled and apply()/restore() are run for CYCLES cycles with changing inputs.
+// The allocations made by the cycles are counted through the global operator new, the
+// benchmark fails if there is any.
+// usage: bench_interlock [num_rules...]  default 1 10 100 1000
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ethercat_interface/ec_interlock.hpp"
+
+namespace
+{
+const int CYCLES = 100000;
+std::atomic<uint64_t> allocations{0};
+
+uint64_t now_ns()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+}
+
+struct Result
+{
+  size_t instructions = 0;
+  double cycle_ns = 0;
+  double max_cycle_ns = 0;
+  uint64_t allocations = 0;
+  size_t active = 0;
+};
+
+bool run(size_t num_rules, Result & result)
+{
+  // 8 digital inputs and 2 analog inputs per rule, one output
+  std::vector<double> inputs(num_rules * 10);
+  std::vector<double> outputs(num_rules, 1);
+  ethercat_interface::InterlockEngine engine;
+  auto resolve = [&inputs](const std::string & name) -> double * {
+      const size_t index = std::strtoul(name.c_str() + 2, NULL, 10);
+      return index < inputs.size() ? &inputs[index] : NULL;
+    };
+  for (size_t r = 0; r < num_rules; r++) {
+    const std::string in = "in" + std::to_string(r * 10);
+    std::string condition;
+    for (size_t k = 0; k < 8; k++) {
+      condition += "in" + std::to_string(r * 10 + k) + (k < 7 ? " && " : "");
+    }
+    condition = "!(" + condition + ") || in" + std::to_string(r * 10 + 8) + " > 4.5 || in" +
+      std::to_string(r * 10 + 9) + " < -4.5";
+    std::string error;
+    if (!engine.addRule(condition, &outputs[r], 0, std::nan(""), resolve, error)) {
+      std::fprintf(stderr, "%s: %s\n", condition.c_str(), error.c_str());
+      return false;
+    }
+  }
+  result.instructions = engine.instructions();
+
+  uint64_t total = 0;
+  uint64_t max = 0;
+  const uint64_t allocations_before = allocations;
+  for (int c = 0; c < CYCLES; c++) {
+    // inputs toggling at different rates so that the rules switch
+    for (size_t i = 0; i < inputs.size(); i++) {
+      inputs[i] = i % 10 < 8 ? ((c >> (i % 7)) & 1) == 0 : (c % 20) - 10.0;
+    }
+    const uint64_t start = now_ns();
+    result.active += engine.apply();
+    engine.restore();
+    const uint64_t duration = now_ns() - start;
+    total += duration;
+    max = std::max(max, duration);
+  }
+  result.allocations = allocations - allocations_before;
+  result.cycle_ns = static_cast<double>(total) / CYCLES;
+  result.max_cycle_ns = static_cast<double>(max);
+  return true;
+}
+}  // namespace
+
+void * operator new(size_t size)
+{
+  allocations++;
+  void * p = std::malloc(size);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void * p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+  std::free(p);
+}
+
+int main(int argc, char ** argv)
+{
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; i++) {
+    sizes.push_back(std::strtoul(argv[i], NULL, 10));
+  }
+  if (sizes.empty()) {
+    sizes = {1, 10, 100, 1000};
+  }
+
+  std::printf(
+    "%8s %13s %12s %12s %12s %14s %12s\n", "rules", "instructions", "cycle [ns]", "max [ns]",
+    "rule [ns]", "instr. [ns]", "allocations");
+  int ret = 0;
+  for (size_t num_rules : sizes) {
+    Result result;
+    if (num_rules == 0 || !run(num_rules, result)) {
+      std::printf("%8zu failed\n", num_rules);
+      ret = 1;
+      continue;
+    }
+    std::printf(
+      "%8zu %13zu %12.1f %12.1f %12.2f %14.3f %12lu\n", num_rules, result.instructions,
+      result.cycle_ns, result.max_cycle_ns, result.cycle_ns / num_rules,
+      result.cycle_ns / result.instructions, result.allocations);
+    if (result.allocations != 0) {
+      std::printf("%8s allocations in the cycle!\n", "");
+      ret = 1;
+    }
+  }
+  return ret;
+}
@@ -0,0 +1,149 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Lookup table linearization of sensor channels at bus rate against a controller.
+// 1. cost per sample of the calibration curves of all the channels of a slave evaluated
+//    together by LookupTableBatch at each bus cycle, against a controller looping over the
+//    channels with LookupTable::evaluate().
+// 2. error of a controller applying the curve to the mean of the samples of a decimation
+//    window, against the mean of the calibrated samples, for a noisy thermocouple.
+// usage: bench_lut [points] [decimation]  default 32 10
+
+#include <time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "ethercat_interface/ec_lut.hpp"
+
+namespace
+{
+const int CYCLES = 20000;
+
+uint64_t now_ns()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+}
+
+/** a monotonic curve of the given number of points with uneven spacing */
+ethercat_interface::LookupTable curve(size_t points, double shift)
+{
+  ethercat_interface::LookupTable table;
+  for (size_t i = 0; i < points; i++) {
+    const double x = i + 0.3 * std::sin(i + shift);
+    table.input.push_back(x);
+    table.output.push_back(x * x * 0.01 + shift);
+  }
+  return table;
+}
+
+/** type K thermocouple, mV to degC */
+ethercat_interface::LookupTable thermocouple()
+{
+  ethercat_interface::LookupTable table;
+  table.input = {-5.891, -3.554, 0, 2.023, 4.096, 8.138, 12.209, 16.397, 20.644, 24.905, 29.129};
+  table.output = {-200, -100, 0, 50, 100, 200, 300, 400, 500, 600, 700};
+  return table;
+}
+
+volatile double sink = 0;
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  const size_t points = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 32;
+  const size_t decimation = argc > 2 ? std::strtoul(argv[2], NULL, 10) : 10;
+  if (points < 2 || decimation < 1) {
+    std::fprintf(stderr, "usage: bench_lut [points >= 2] [decimation >= 1]\n");
+    return 1;
+  }
+  std::mt19937 generator(42);
+
+  std::printf("calibration cost, %zu points per curve\n", points);
+  std::printf(
+    "%9s %16s %17s %9s\n", "channels", "batch [ns/smp]", "scalar [ns/smp]", "speedup");
+  for (size_t channels : {1, 4, 16, 64, 256}) {
+    std::vector<ethercat_interface::LookupTable> tables;
+    ethercat_interface::LookupTableBatch batch;
+    for (size_t c = 0; c < channels; c++) {
+      tables.push_back(curve(points, c));
+      batch.add(tables.back());
+    }
+    std::uniform_real_distribution<double> distribution(-1, points);
+    std::vector<double> samples(channels * 64);
+    for (auto & sample : samples) {
+      sample = distribution(generator);
+    }
+    std::vector<double> outputs(channels);
+
+    uint64_t start = now_ns();
+    for (int cycle = 0; cycle < CYCLES; cycle++) {
+      const double * cycle_samples = &samples[(cycle % 64) * channels];
+      double * inputs = batch.inputs();
+      for (size_t c = 0; c < channels; c++) {
+        inputs[c] = cycle_samples[c];
+      }
+      batch.evaluate();
+      sink = batch.outputs()[cycle % channels];
+    }
+    const double batch_ns = static_cast<double>(now_ns() - start) / CYCLES / channels;
+
+    start = now_ns();
+    for (int cycle = 0; cycle < CYCLES; cycle++) {
+      const double * cycle_samples = &samples[(cycle % 64) * channels];
+      for (size_t c = 0; c < channels; c++) {
+        outputs[c] = tables[c].evaluate(cycle_samples[c]);
+      }
+      sink = outputs[cycle % channels];
+    }
+    const double scalar_ns = static_cast<double>(now_ns() - start) / CYCLES / channels;
+    std::printf(
+      "%9zu %16.2f %17.2f %9.2f\n", channels, batch_ns, scalar_ns, scalar_ns / batch_ns);
+  }
+
+  // the curve does not commute with the mean over a window when it is not linear there
+  const ethercat_interface::LookupTable table = thermocouple();
+  std::printf("\nthermocouple, mean of %zu samples with noise\n", decimation);
+  std::printf(
+    "%10s %10s %17s %17s %13s\n", "mV", "noise mV", "bus rate [degC]", "controller [degC]",
+    "max error [K]");
+  for (double noise : {0.1, 0.5, 1.0}) {
+    for (double mv : {-4.0, 1.0, 10.0}) {
+      std::normal_distribution<double> distribution(mv, noise);
+      double worst = 0;
+      double bus_mean = 0;
+      double controller = 0;
+      for (int window = 0; window < 1000; window++) {
+        double calibrated_sum = 0;
+        double raw_sum = 0;
+        for (size_t i = 0; i < decimation; i++) {
+          const double sample = distribution(generator);
+          calibrated_sum += table.evaluate(sample);
+          raw_sum += sample;
+        }
+        bus_mean = calibrated_sum / decimation;
+        controller = table.evaluate(raw_sum / decimation);
+        worst = std::max(worst, std::abs(controller - bus_mean));
+      }
+      std::printf(
+        "%10.1f %10.1f %17.2f %17.2f %13.3f\n", mv, noise, bus_mean, controller, worst);
+    }
+  }
+  return 0;
+}
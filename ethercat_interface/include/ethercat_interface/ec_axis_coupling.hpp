@@ -0,0 +1,183 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_AXIS_COUPLING_HPP_
+#define ETHERCAT_INTERFACE__EC_AXIS_COUPLING_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ethercat_interface/ec_realtime_exchange.hpp"
+
+namespace ethercat_interface
+{
+
+/** Follower position as a function of the leader position, linearly interpolated
+ *  between the points. A periodic table repeats over the leader range of its points,
+ *  shifted by the follower range at each period. */
+struct CamTable
+{
+  std::vector<double> leader;
+  std::vector<double> follower;
+  bool periodic = false;
+
+  /** at least two points, finite, with strictly increasing leader positions */
+  bool valid() const
+  {
+    if (leader.size() < 2 || follower.size() != leader.size()) {
+      return false;
+    }
+    for (auto i = 0ul; i < leader.size(); i++) {
+      if (!std::isfinite(leader[i]) || !std::isfinite(follower[i]) ||
+        (i > 0 && !(leader[i] > leader[i - 1])))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** follower position at the leader position, the table must be valid. RT */
+  double evaluate(double position) const
+  {
+    double shift = 0;
+    if (periodic) {
+      const double period = leader.back() - leader.front();
+      const double periods = std::floor((position - leader.front()) / period);
+      position -= periods * period;
+      shift = periods * (follower.back() - follower.front());
+    } else if (position <= leader.front()) {
+      return follower.front();
+    } else if (position >= leader.back()) {
+      return follower.back();
+    }
+    // first point after the position, the segment ends there
+    size_t i = std::upper_bound(leader.begin(), leader.end(), position) - leader.begin();
+    i = std::min<size_t>(std::max<size_t>(i, 1), leader.size() - 1);
+    const double s = (position - leader[i - 1]) / (leader[i] - leader[i - 1]);
+    return follower[i - 1] + s * (follower[i] - follower[i - 1]) + shift;
+  }
+};
+
+/** Electronic gearing or cam coupling of a follower axis to a leader axis, evaluated at
+ *  each bus cycle. The coupling is relative: on engagement the follower target starts at
+ *  the follower position and then moves by the increments of the gear ratio or the cam
+ *  table over the leader motion. These increments are scaled by a factor ramped from 0 to 1
+ *  over the engage ramp, and back to 0 over the disengage ramp, so that the follower is
+ *  smoothly accelerated to and from the leader motion.
+ *  A cam table replaces the gear ratio once loaded, it can be replaced at any time from a
+ *  non-RT thread. update() does not allocate. */
+class AxisCoupling
+{
+public:
+  enum State
+  {
+    DISENGAGED = 0,
+    ENGAGING = 1,
+    ENGAGED = 2,
+    DISENGAGING = 3
+  };
+
+  AxisCoupling() {}
+  AxisCoupling(const AxisCoupling &) = delete;
+  AxisCoupling & operator=(const AxisCoupling &) = delete;
+
+  /** gear ratio, follower over leader increments, used without cam table. non-RT, before use */
+  void setRatio(double ratio) {ratio_ = ratio;}
+  /** duration of the engage and disengage ramps, in s. non-RT, before use */
+  void setRamps(double engage_time, double disengage_time)
+  {
+    engage_time_ = engage_time;
+    disengage_time_ = disengage_time;
+  }
+
+  /** publish a new cam table, returns false if it is not valid. non-RT */
+  bool loadCamTable(const CamTable & table)
+  {
+    if (!table.valid()) {
+      return false;
+    }
+    cam_exchange_.writeFromNonRT(table);
+    return true;
+  }
+
+  /** advance the coupling by dt seconds with the engagement request and the positions of
+   *  the leader and the follower. returns false if disengaged, otherwise the follower
+   *  target is set. a non-finite leader position freezes the follower target. RT */
+  bool update(double dt, bool engage, double leader, double follower, double & target)
+  {
+    cam_ = cam_exchange_.readFromRT();
+    if (engage && state_ == DISENGAGED) {
+      if (!std::isfinite(leader) || !std::isfinite(follower)) {
+        return false;
+      }
+      target_ = follower;
+      last_leader_ = leader;
+      state_ = ENGAGING;
+    } else if (engage && state_ == DISENGAGING) {
+      state_ = ENGAGING;
+    } else if (!engage && (state_ == ENGAGING || state_ == ENGAGED)) {
+      state_ = DISENGAGING;
+    }
+    if (state_ == DISENGAGED) {
+      return false;
+    }
+
+    if (state_ == ENGAGING) {
+      scale_ = engage_time_ > 0 ? std::min(1.0, scale_ + dt / engage_time_) : 1.0;
+      if (scale_ >= 1.0) {
+        state_ = ENGAGED;
+      }
+    } else if (state_ == DISENGAGING) {
+      scale_ = disengage_time_ > 0 ? std::max(0.0, scale_ - dt / disengage_time_) : 0.0;
+    }
+
+    if (std::isfinite(leader)) {
+      target_ += scale_ * (transfer(leader) - transfer(last_leader_));
+      last_leader_ = leader;
+    }
+    target = target_;
+    if (state_ == DISENGAGING && scale_ <= 0.0) {
+      // the last target is still sent in this cycle
+      state_ = DISENGAGED;
+    }
+    return true;
+  }
+
+  State state() const {return state_;}
+  /** current scale of the coupled motion, 0 to 1 */
+  double scale() const {return scale_;}
+
+private:
+  double transfer(double leader) const
+  {
+    return cam_ != NULL ? cam_->evaluate(leader) : ratio_ * leader;
+  }
+
+  double ratio_ = 1.0;
+  double engage_time_ = 0;
+  double disengage_time_ = 0;
+  RealtimeExchange<CamTable> cam_exchange_;
+
+  // RT side
+  const CamTable * cam_ = NULL;
+  State state_ = DISENGAGED;
+  double scale_ = 0;
+  double target_ = 0;
+  double last_leader_ = 0;
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_AXIS_COUPLING_HPP_
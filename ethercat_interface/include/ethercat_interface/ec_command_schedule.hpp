@@ -0,0 +1,117 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_COMMAND_SCHEDULE_HPP_
+#define ETHERCAT_INTERFACE__EC_COMMAND_SCHEDULE_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ethercat_interface
+{
+
+/** Batches of command values, each applied as a whole once it is due.
+ *  The due key is a bus cycle number or a DC time, the earliest batch comes out first
+ *  and batches with the same key in the order they were pushed.
+ *  Storage is allocated by configure(), push() and apply() do not allocate. */
+class CommandSchedule
+{
+public:
+  /** batches of size values, at most capacity of them pending. non-RT */
+  void configure(size_t size, size_t capacity)
+  {
+    size_ = size;
+    values_.assign(size * capacity, 0);
+    heap_.clear();
+    heap_.reserve(capacity);
+    free_.resize(capacity);
+    for (size_t i = 0; i < capacity; i++) {
+      free_[i] = capacity - 1 - i;
+    }
+    sequence_ = 0;
+  }
+
+  size_t size() const {return size_;}
+  size_t pending() const {return heap_.size();}
+
+  /** queue a batch of size() values due at the key. returns false if the queue is full. RT */
+  bool push(uint64_t due, const double * values)
+  {
+    if (free_.empty()) {
+      return false;
+    }
+    const size_t slot = free_.back();
+    free_.pop_back();
+    std::copy(values, values + size_, values_.begin() + slot * size_);
+    heap_.push_back({due, sequence_++, slot});
+    std::push_heap(heap_.begin(), heap_.end(), later);
+    return true;
+  }
+
+  /** merge the batches due at the key into values, oldest first. the NaN values of a batch
+   *  leave the value unchanged. returns the number of batches applied. RT */
+  size_t apply(uint64_t now, double * values)
+  {
+    size_t applied = 0;
+    while (!heap_.empty() && heap_.front().due <= now) {
+      std::pop_heap(heap_.begin(), heap_.end(), later);
+      const size_t slot = heap_.back().slot;
+      heap_.pop_back();
+      for (size_t i = 0; i < size_; i++) {
+        const double value = values_[slot * size_ + i];
+        if (!std::isnan(value)) {
+          values[i] = value;
+        }
+      }
+      free_.push_back(slot);
+      applied++;
+    }
+    return applied;
+  }
+
+  /** drop the pending batches. RT */
+  void clear()
+  {
+    for (const auto & batch : heap_) {
+      free_.push_back(batch.slot);
+    }
+    heap_.clear();
+  }
+
+private:
+  struct Batch
+  {
+    uint64_t due;
+    uint64_t sequence;
+    size_t slot;
+  };
+
+  /** heap order, the earliest batch on top */
+  static bool later(const Batch & a, const Batch & b)
+  {
+    return a.due != b.due ? a.due > b.due : a.sequence > b.sequence;
+  }
+
+  size_t size_ = 0;
+  /** values of the batches, size_ per slot */
+  std::vector<double> values_;
+  std::vector<Batch> heap_;
+  /** slots not used by a pending batch */
+  std::vector<size_t> free_;
+  uint64_t sequence_ = 0;
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_COMMAND_SCHEDULE_HPP_
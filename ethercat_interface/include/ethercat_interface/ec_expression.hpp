@@ -0,0 +1,348 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_EXPRESSION_HPP_
+#define ETHERCAT_INTERFACE__EC_EXPRESSION_HPP_
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ethercat_interface
+{
+
+/** Expressions over named values evaluated at each bus cycle.
+ *  The expressions combine names and numbers with the arithmetic operators + - * /, the
+ *  comparisons == != < <= > >=, the boolean operators ! && || and parentheses, with the
+ *  precedence of C. The names may contain '/' and '.', a division by a name is written
+ *  with spaces: "a / b". Comparisons and boolean operators give 1 or 0, a value is true if
+ *  it is neither 0 nor NaN.
+ *  The expressions are compiled once into a single flat array of instructions in reverse
+ *  Polish notation, evaluated on a stack allocated at compilation: evaluate() does not
+ *  allocate. */
+class ExpressionProgram
+{
+public:
+  /** value of the name, NULL if there is no such value. the value must stay in place */
+  typedef std::function<const double *(const std::string &)> Resolver;
+
+  /** compile the expression to the end of the program, returns its number or -1 on error.
+   *  non-RT */
+  int compile(const std::string & expression, const Resolver & resolve, std::string & error)
+  {
+    const size_t begin = program_.size();
+    if (!parse(expression, resolve, error)) {
+      program_.resize(begin);
+      return -1;
+    }
+    ranges_.push_back({begin, program_.size()});
+    return static_cast<int>(ranges_.size() - 1);
+  }
+
+  /** value of the compiled expression. RT */
+  double evaluate(size_t expression)
+  {
+    double * top = stack_.data();
+    for (size_t i = ranges_[expression].first; i < ranges_[expression].second; i++) {
+      const Instruction & instruction = program_[i];
+      switch (instruction.op) {
+        case LOAD:
+          *top++ = *instruction.operand;
+          continue;
+        case CONSTANT:
+          *top++ = instruction.value;
+          continue;
+        case NOT:
+          top[-1] = truth(top[-1]) ? 0 : 1;
+          continue;
+        case NEG:
+          top[-1] = -top[-1];
+          continue;
+        default:
+          break;
+      }
+      const double b = *--top;
+      double & a = top[-1];
+      switch (instruction.op) {
+        case ADD:
+          a = a + b;
+          break;
+        case SUB:
+          a = a - b;
+          break;
+        case MUL:
+          a = a * b;
+          break;
+        case DIV:
+          a = a / b;
+          break;
+        case AND:
+          a = truth(a) && truth(b);
+          break;
+        case OR:
+          a = truth(a) || truth(b);
+          break;
+        case EQ:
+          a = a == b;
+          break;
+        case NE:
+          a = a != b;
+          break;
+        case LT:
+          a = a < b;
+          break;
+        case LE:
+          a = a <= b;
+          break;
+        case GT:
+          a = a > b;
+          break;
+        case GE:
+          a = a >= b;
+          break;
+        default:
+          break;
+      }
+    }
+    return stack_[0];
+  }
+
+  static bool truth(double value) {return value != 0 && !std::isnan(value);}
+
+  /** number of expressions */
+  size_t size() const {return ranges_.size();}
+  /** number of instructions of all the expressions */
+  size_t instructions() const {return program_.size();}
+
+private:
+  enum OpCode
+  {
+    LOAD,
+    CONSTANT,
+    NOT,
+    NEG,
+    MUL,
+    DIV,
+    ADD,
+    SUB,
+    AND,
+    OR,
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE,
+    /** parenthesis, only on the operator stack of the compilation */
+    OPEN
+  };
+
+  struct Instruction
+  {
+    OpCode op;
+    const double * operand;
+    double value;
+  };
+
+  static int precedence(OpCode op)
+  {
+    switch (op) {
+      case NOT:
+      case NEG:
+        return 7;
+      case MUL:
+      case DIV:
+        return 6;
+      case ADD:
+      case SUB:
+        return 5;
+      case LT:
+      case LE:
+      case GT:
+      case GE:
+        return 4;
+      case EQ:
+      case NE:
+        return 3;
+      case AND:
+        return 2;
+      case OR:
+        return 1;
+      default:
+        return 0;
+    }
+  }
+
+  static bool isNameCharacter(const std::string & expression, size_t i)
+  {
+    const char c = expression[i];
+    const char next = i + 1 < expression.size() ? expression[i + 1] : '\0';
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' ||
+           (c == '/' && (std::isalpha(static_cast<unsigned char>(next)) || next == '_'));
+  }
+
+  /** move the operators of higher or equal precedence to the program */
+  void reduce(std::vector<OpCode> & operators, int min_precedence)
+  {
+    while (!operators.empty() && operators.back() != OPEN &&
+      precedence(operators.back()) >= min_precedence)
+    {
+      program_.push_back({operators.back(), NULL, 0});
+      operators.pop_back();
+    }
+  }
+
+  /** shunting-yard compilation of the expression to the end of the program */
+  bool parse(const std::string & expression, const Resolver & resolve, std::string & error)
+  {
+    const size_t begin = program_.size();
+    std::vector<OpCode> operators;
+    bool expect_operand = true;
+    size_t i = 0;
+    while (i < expression.size()) {
+      const char c = expression[i];
+      const char next = i + 1 < expression.size() ? expression[i + 1] : '\0';
+      if (std::isspace(static_cast<unsigned char>(c))) {
+        i++;
+        continue;
+      }
+      if (expect_operand) {
+        if (c == '!' || c == '-') {
+          // unary and right associative, nothing to reduce
+          operators.push_back(c == '!' ? NOT : NEG);
+          i++;
+        } else if (c == '(') {
+          operators.push_back(OPEN);
+          i++;
+        } else if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+          char * end;
+          const double value = std::strtod(expression.c_str() + i, &end);
+          if (end == expression.c_str() + i) {
+            error = "invalid number at " + std::to_string(i);
+            return false;
+          }
+          program_.push_back({CONSTANT, NULL, value});
+          i = end - expression.c_str();
+          expect_operand = false;
+        } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+          size_t end = i;
+          while (end < expression.size() && isNameCharacter(expression, end)) {
+            end++;
+          }
+          const std::string name = expression.substr(i, end - i);
+          if (name == "true" || name == "false") {
+            program_.push_back({CONSTANT, NULL, name == "true" ? 1.0 : 0.0});
+          } else {
+            const double * operand = resolve(name);
+            if (operand == NULL) {
+              error = "unknown value " + name;
+              return false;
+            }
+            program_.push_back({LOAD, operand, 0});
+          }
+          i = end;
+          expect_operand = false;
+        } else {
+          error = "operand expected at " + std::to_string(i);
+          return false;
+        }
+        continue;
+      }
+
+      OpCode op;
+      size_t length = 1;
+      if (c == ')') {
+        reduce(operators, 0);
+        if (operators.empty()) {
+          error = "unbalanced ) at " + std::to_string(i);
+          return false;
+        }
+        operators.pop_back();
+        i++;
+        continue;
+      } else if (c == '+') {
+        op = ADD;
+      } else if (c == '-') {
+        op = SUB;
+      } else if (c == '*') {
+        op = MUL;
+      } else if (c == '/') {
+        op = DIV;
+      } else if (c == '&' && next == '&') {
+        op = AND;
+        length = 2;
+      } else if (c == '|' && next == '|') {
+        op = OR;
+        length = 2;
+      } else if (c == '=' && next == '=') {
+        op = EQ;
+        length = 2;
+      } else if (c == '!' && next == '=') {
+        op = NE;
+        length = 2;
+      } else if (c == '<') {
+        op = next == '=' ? LE : LT;
+        length = next == '=' ? 2 : 1;
+      } else if (c == '>') {
+        op = next == '=' ? GE : GT;
+        length = next == '=' ? 2 : 1;
+      } else {
+        error = "operator expected at " + std::to_string(i);
+        return false;
+      }
+      // left associative binary operator
+      reduce(operators, precedence(op));
+      operators.push_back(op);
+      i += length;
+      expect_operand = true;
+    }
+    if (expect_operand) {
+      error = "incomplete expression";
+      return false;
+    }
+    reduce(operators, 0);
+    if (!operators.empty()) {
+      error = "unbalanced (";
+      return false;
+    }
+
+    // the stack holds the deepest expression
+    size_t depth = 0;
+    size_t max_depth = 0;
+    for (size_t k = begin; k < program_.size(); k++) {
+      const OpCode op = program_[k].op;
+      if (op == LOAD || op == CONSTANT) {
+        max_depth = std::max(max_depth, ++depth);
+      } else if (op != NOT && op != NEG) {
+        depth--;
+      }
+    }
+    if (stack_.size() < max_depth) {
+      stack_.resize(max_depth);
+    }
+    return true;
+  }
+
+  std::vector<Instruction> program_;
+  /** instructions of each expression */
+  std::vector<std::pair<size_t, size_t>> ranges_;
+  std::vector<double> stack_;
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_EXPRESSION_HPP_
@@ -0,0 +1,142 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_INTERLOCK_HPP_
+#define ETHERCAT_INTERFACE__EC_INTERLOCK_HPP_
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "yaml-cpp/yaml.h"
+#include "ethercat_interface/ec_expression.hpp"
+
+namespace ethercat_interface
+{
+
+/** Interlock rules evaluated at each bus cycle, forcing a command value while a condition
+ *  on the interface values holds, e.g. "door/closed == 0 || estop/ok < 1".
+ *  The conditions are ExpressionProgram expressions over the interface names, a negated
+ *  missing input triggers. They are compiled once into a single program: apply() and
+ *  restore() do not allocate. */
+class InterlockEngine
+{
+public:
+  /** value of the named interface, NULL if there is no such interface */
+  typedef std::function<double *(const std::string &)> Resolver;
+
+  /** add a rule forcing the output to value while the condition is true, and to otherwise
+   *  while it is false unless otherwise is NaN. non-RT */
+  bool addRule(
+    const std::string & condition, double * output, double value, double otherwise,
+    const Resolver & resolve, std::string & error)
+  {
+    if (output == NULL) {
+      error = "no output";
+      return false;
+    }
+    const int expression = program_.compile(condition, resolve, error);
+    if (expression < 0) {
+      return false;
+    }
+    Rule rule;
+    rule.condition = expression;
+    rule.output = output;
+    rule.value = value;
+    rule.otherwise = otherwise;
+    rules_.push_back(rule);
+    return true;
+  }
+
+  /** add the rules of a yaml list of {when, output, value, otherwise}, the interfaces of the
+   *  conditions and the outputs are looked up by name. non-RT */
+  bool load(
+    const YAML::Node & config, const Resolver & inputs, const Resolver & outputs,
+    std::string & error)
+  {
+    for (const auto & rule : config) {
+      try {
+        const std::string output = rule["output"].as<std::string>();
+        double * output_value = outputs(output);
+        if (output_value == NULL) {
+          error = "output " + output + " not found";
+          return false;
+        }
+        const double otherwise = rule["otherwise"] ? rule["otherwise"].as<double>() :
+          std::numeric_limits<double>::quiet_NaN();
+        if (!addRule(
+            rule["when"].as<std::string>(), output_value,
+            rule["value"] ? rule["value"].as<double>() : 0, otherwise, inputs, error))
+        {
+          error = rule["when"].as<std::string>() + ": " + error;
+          return false;
+        }
+      } catch (const YAML::Exception & ex) {
+        error = ex.what();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** evaluate the rules in order and force their outputs, a later rule on the same output
+   *  has the last word. returns the number of conditions true. RT */
+  size_t apply()
+  {
+    size_t active = 0;
+    for (Rule & rule : rules_) {
+      rule.saved = *rule.output;
+      rule.active = ExpressionProgram::truth(program_.evaluate(rule.condition));
+      if (rule.active) {
+        *rule.output = rule.value;
+        active++;
+      } else if (!std::isnan(rule.otherwise)) {
+        *rule.output = rule.otherwise;
+      }
+    }
+    return active;
+  }
+
+  /** give the outputs their values from before apply(). RT */
+  void restore()
+  {
+    for (auto rule = rules_.rbegin(); rule != rules_.rend(); ++rule) {
+      *rule->output = rule->saved;
+    }
+  }
+
+  size_t size() const {return rules_.size();}
+  size_t instructions() const {return program_.instructions();}
+  /** condition of the rule at the last apply() */
+  bool active(size_t rule) const {return rules_.at(rule).active;}
+
+private:
+  struct Rule
+  {
+    size_t condition = 0;
+    double * output = NULL;
+    double value = 0;
+    double otherwise = 0;
+    double saved = 0;
+    bool active = false;
+  };
+
+  ExpressionProgram program_;
+  std::vector<Rule> rules_;
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_INTERLOCK_HPP_
@@ -0,0 +1,152 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_LUT_HPP_
+#define ETHERCAT_INTERFACE__EC_LUT_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "yaml-cpp/yaml.h"
+
+namespace ethercat_interface
+{
+
+/** Calibration curve of a channel, linearly interpolated between its points and clamped
+ *  to the output of its first and last points outside of them. */
+struct LookupTable
+{
+  std::vector<double> input;
+  std::vector<double> output;
+
+  /** at least two points, finite, with strictly increasing inputs */
+  bool valid() const
+  {
+    if (input.size() < 2 || output.size() != input.size()) {
+      return false;
+    }
+    for (auto i = 0ul; i < input.size(); i++) {
+      if (!std::isfinite(input[i]) || !std::isfinite(output[i]) ||
+        (i > 0 && !(input[i] > input[i - 1])))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** output at the input, the table must be valid */
+  double evaluate(double value) const
+  {
+    if (value <= input.front()) {
+      return output.front();
+    } else if (value >= input.back()) {
+      return output.back();
+    }
+    const size_t i = std::upper_bound(input.begin(), input.end(), value) - input.begin();
+    const double s = (value - input[i - 1]) / (input[i] - input[i - 1]);
+    return output[i - 1] + s * (output[i] - output[i - 1]);
+  }
+
+  /** set up from a yaml node {input: [...], output: [...]}, or from the yaml file it names */
+  bool load(const YAML::Node & config)
+  {
+    try {
+      const YAML::Node table = config.IsScalar() ?
+        YAML::LoadFile(config.as<std::string>()) : config;
+      input = table["input"].as<std::vector<double>>();
+      output = table["output"].as<std::vector<double>>();
+    } catch (const YAML::Exception & ex) {
+      std::cerr << "LookupTable: failed to load the table: " << ex.what() << std::endl;
+      return false;
+    }
+    if (!valid()) {
+      std::cerr << "LookupTable: expected at least 2 finite points with increasing inputs." <<
+        std::endl;
+      return false;
+    }
+    return true;
+  }
+};
+
+/** Lookup tables of several channels evaluated together at each bus cycle.
+ *  The tables are stored as structure of arrays: the breakpoints of all the tables in one
+ *  array, and for each segment the intercept and slope of its line in two others, so that a
+ *  sample costs a branchless search of its segment and one multiply-add. The inputs are
+ *  set in inputs() and the outputs read from outputs(), evaluate() does not allocate. */
+class LookupTableBatch
+{
+public:
+  /** add the table of a channel, returns the channel number in the batch. non-RT */
+  size_t add(const LookupTable & table)
+  {
+    first_.push_back(breakpoints_.size());
+    segments_.push_back(table.input.size() - 1);
+    for (auto i = 0ul; i + 1 < table.input.size(); i++) {
+      const double slope =
+        (table.output[i + 1] - table.output[i]) / (table.input[i + 1] - table.input[i]);
+      breakpoints_.push_back(table.input[i]);
+      slopes_.push_back(slope);
+      intercepts_.push_back(table.output[i] - slope * table.input[i]);
+    }
+    // the last breakpoint only bounds the input
+    breakpoints_.push_back(table.input.back());
+    slopes_.push_back(0);
+    intercepts_.push_back(0);
+    inputs_.push_back(0);
+    outputs_.push_back(0);
+    return first_.size() - 1;
+  }
+
+  size_t size() const {return first_.size();}
+  double * inputs() {return inputs_.data();}
+  const double * outputs() const {return outputs_.data();}
+
+  /** evaluate the tables of all the channels. a NaN input gives a NaN output. RT */
+  void evaluate()
+  {
+    const size_t channels = first_.size();
+    for (size_t c = 0; c < channels; c++) {
+      const size_t first = first_[c];
+      const double * breakpoints = &breakpoints_[first];
+      const size_t segments = segments_[c];
+      // clamped to the first and last breakpoints, NaN passes through
+      const double value = std::min(std::max(inputs_[c], breakpoints[0]), breakpoints[segments]);
+      // last segment starting before the value, without data dependent branches
+      size_t segment = 0;
+      size_t length = segments;
+      while (length > 1) {
+        const size_t half = length / 2;
+        segment = breakpoints[segment + half] <= value ? segment + half : segment;
+        length -= half;
+      }
+      outputs_[c] = intercepts_[first + segment] + slopes_[first + segment] * value;
+    }
+  }
+
+private:
+  std::vector<double> breakpoints_;
+  std::vector<double> slopes_;
+  std::vector<double> intercepts_;
+  std::vector<size_t> first_;
+  std::vector<size_t> segments_;
+  std::vector<double> inputs_;
+  std::vector<double> outputs_;
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_LUT_HPP_
@@ -21,8 +21,11 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <chrono>
 #include "ethercat_interface/ec_slave.hpp"
+#include "ethercat_interface/ec_pdo_route.hpp"
+#include "ethercat_interface/ec_sdo_scheduler.hpp"
 
 
 namespace ethercat_interface
@@ -38,13 +41,30 @@ public:
     * alias and position can be found by running the following command
     * /opt/etherlab/bin$ sudo ./ethercat slaves
     * look for the "A B:C STATUS DEVICE" (e.g. B=alias, C=position)
+    * returns false if the slave could not be configured
     */
-  void addSlave(uint16_t alias, uint16_t position, EcSlave * slave);
+  bool addSlave(uint16_t alias, uint16_t position, EcSlave * slave);
 
   /** \brief configure slave using SDO
+    * the download is scheduled with the CONFIG priority, -ETIMEDOUT if it could not start
     */
   int configSlaveSdo(uint16_t slave_position, SdoConfigEntry sdo_config, uint32_t * abort_code);
 
+  /** schedule of the SDO transfers of the master, keyed by SdoScheduler::slaveKey() of the
+   *  master index and slave position. the other SDO transfers on the master run through it,
+   *  so that they are ordered by priority. non-RT */
+  SdoScheduler & sdoScheduler() {return *sdo_scheduler_;}
+
+  /** share a schedule with the other users of the mailboxes in the process, e.g. the other
+   *  masters or the SDO services, so that all their transfers are ordered together. call
+   *  before configuring the slaves, the transfers on the master must end before it goes.
+   *  non-RT */
+  void setSdoScheduler(std::shared_ptr<SdoScheduler> scheduler) {sdo_scheduler_ = scheduler;}
+
+  /** copy a PDO entry received from a slave into a PDO entry sent to another slave at each
+   *  cycle, see PdoRoute. call before activate(), which fails if an entry is not in a domain */
+  void addRoute(const PdoRoute & route) {routes_.push_back(route);}
+
   /** call after adding all slaves, and before update */
   bool activate();
 
@@ -80,6 +100,50 @@ public:
    *  set priority as 49 (kernel and interrupts are 50) */
   static void setThreadRealTime();
 
+  /** how the cycle loops wait for the next cycle start */
+  enum class WakeupStrategy
+  {
+    /** clock_nanosleep until the cycle start */
+    SLEEP,
+    /** clock_nanosleep until spin_guard before the cycle start, then spin on the clock */
+    SLEEP_SPIN
+  };
+
+  /** select the wakeup strategy of run() and sleepUntil().
+   *  if adaptive, the spin guard follows the observed sleep wakeup latency */
+  void setWakeupStrategy(
+    WakeupStrategy strategy, uint32_t spin_guard_ns = 50000,
+    bool adaptive_guard = true);
+
+  /** wait until the CLOCK_MONOTONIC time t using the wakeup strategy. RT */
+  void sleepUntil(const struct timespec & t);
+
+  /** SYNC0 shift of the DC slaves added afterwards. negative to derive it from
+   *  the phase of the current time */
+  void setSync0Shift(int32_t shift_ns) {sync0_shift_ = shift_ns;}
+
+  /** delay between the application time of a cycle and its frame passing the
+   *  DC reference clock, measured over the calibration cycles */
+  struct Sync0Calibration
+  {
+    uint32_t samples = 0;
+    int32_t min_delay_ns = 0;
+    int32_t median_delay_ns = 0;
+    int32_t p99_delay_ns = 0;
+    int32_t max_delay_ns = 0;
+    /** SYNC0 shift firing right after the outputs reached the slaves: p99 delay + margin,
+     *  -1 if this does not fit in the cycle */
+    int32_t shift_ns = -1;
+  };
+
+  /** measure the frame delay over the next cycles. call before the cycles, non-RT */
+  void startSync0Calibration(uint32_t cycles);
+
+  bool sync0CalibrationDone() const;
+
+  /** result of the last calibration with a safety margin on the shift. non-RT */
+  Sync0Calibration getSync0Calibration(uint32_t margin_ns) const;
+
   void setCtrlFrequency(double frequency)
   {
     interval_ = 1000000000.0 / frequency;
@@ -87,9 +151,71 @@ public:
 
   uint32_t getInterval() {return interval_;}
 
+  /** DC application time of the last frame sent, in ns since 2000-01-01 */
+  uint64_t getApplicationTime() const {return app_time_;}
+
   void readData(uint32_t domain = 0);
   void writeData(uint32_t domain = 0);
 
+  /** state of an Ethernet device of the master */
+  struct LinkStatistics
+  {
+    bool link_up = false;
+    unsigned int slaves_responding = 0;
+    /** number of up -> down transitions */
+    uint64_t link_down_count = 0;
+  };
+
+  /** process data exchange of a domain */
+  struct DomainStatistics
+  {
+    unsigned int working_counter = 0;
+    /** cycles where only part of the slaves exchanged their data */
+    uint64_t wc_incomplete_cycles = 0;
+    /** cycles where the frame was lost on all links */
+    uint64_t wc_zero_cycles = 0;
+    /** cycles where the data was exchanged through the redundant link */
+    uint64_t redundancy_active_cycles = 0;
+  };
+
+  /** start time precision of the cycles waited for with sleepUntil() */
+  struct WakeupStatistics
+  {
+    uint64_t wakeups = 0;
+    /** lateness of the cycle start with respect to the deadline in ns */
+    int64_t last_ns = 0;
+    int64_t min_ns = 0;
+    int64_t max_ns = 0;
+    double mean_ns = 0;
+    /** start time jitter, standard deviation of the lateness in ns */
+    double jitter_ns = 0;
+    /** current spin guard in ns, 0 if not spinning */
+    uint32_t spin_guard_ns = 0;
+  };
+
+  /** bus statistics, links are checked at the state check frequency,
+   *  domains at every cycle */
+  struct Statistics
+  {
+    uint64_t cycles = 0;
+    /** true if a backup device is attached to the master */
+    bool backup_device = false;
+    /** main and backup links */
+    LinkStatistics links[2];
+    /** true while the ring is open and part of the slaves are reached through the backup link */
+    bool ring_broken = false;
+    uint64_t ring_broken_count = 0;
+    std::map<uint32_t, DomainStatistics> domains;
+    WakeupStatistics wakeup;
+  };
+
+  /** snapshot of the bus statistics. call from the thread running the cycle */
+  Statistics getStatistics() const;
+
+  /** snapshot of the wakeup statistics only, without allocation.
+   *  call from the thread running the cycle. RT */
+  WakeupStatistics getWakeupStatistics() const;
+
 private:
   /** true if running */
   volatile bool running_ = false;
@@ -107,6 +233,21 @@ private:
     DomainInfo * domain_info,
     EcSlave * slave);
 
+  /** pass the domain data to its slaves, new_cycle if its frame was just received */
+  void processDomain(uint32_t domain, DomainInfo * domain_info, bool new_cycle);
+
+  /** locate the routed entries in the domain memory, false if one is not registered */
+  bool resolveRoutes();
+
+  /** address in the domain memory of a byte aligned entry, NULL if not registered */
+  uint8_t * findEntry(uint16_t position, uint16_t index, uint8_t sub_index, uint32_t & domain);
+
+  /** apply the routes to the entries sent in the domain. RT */
+  void applyRoutes(uint32_t domain);
+
+  /** check the DC sync signals of a slave against the master cycle */
+  bool checkDcSyncConfig(const DcSyncConfig & config, uint32_t sync0_cycle);
+
   /** check for change in the domain state */
   void checkDomainState(uint32_t domain);
 
@@ -116,6 +257,15 @@ private:
   /** check for change in the slave states */
   void checkSlaveStates();
 
+  /** check if the ring of a redundant setup is broken */
+  void checkRingState();
+
+  /** sample the reference clock delay if calibrating */
+  void sampleReferenceClock();
+
+  /** set the application time of the cycle */
+  void setApplicationTime();
+
   /** print warning message to terminal */
   static void printWarning(const std::string & message);
 
@@ -132,6 +282,7 @@ private:
     ec_domain_t * domain = NULL;
     ec_domain_state_t domain_state = {};
     uint8_t * domain_pd = NULL;
+    DomainStatistics statistics;
 
     /** domain pdo registration array.
      *  do not modify after active(), or may invalidate */
@@ -162,6 +313,18 @@ private:
 
   std::vector<SlaveInfo> slave_info_;
 
+  /** routes and their entries in the domain memory */
+  struct RouteInfo
+  {
+    PdoRoute route;
+    uint32_t domain = 0;
+    const uint8_t * source = NULL;
+    uint8_t * destination = NULL;
+  };
+
+  std::vector<PdoRoute> routes_;
+  std::vector<RouteInfo> route_info_;
+
   /** counter of control loops */
   uint64_t update_counter_ = 0;
 
@@ -170,6 +333,24 @@ private:
   uint32_t check_state_frequency_ = 10;
 
   uint32_t interval_;
+
+  /** link, redundancy and wakeup part of the statistics */
+  Statistics statistics_;
+
+  WakeupStrategy wakeup_strategy_ = WakeupStrategy::SLEEP;
+  bool adaptive_guard_ = true;
+  double spin_guard_ns_ = 0;
+  double wakeup_latency_peak_ns_ = 0;
+  /** sum of squared deviations of the lateness, for the jitter */
+  double wakeup_m2_ = 0;
+
+  std::shared_ptr<SdoScheduler> sdo_scheduler_ = std::make_shared<SdoScheduler>();
+  int master_index_ = 0;
+
+  int32_t sync0_shift_ = -1;
+  uint64_t app_time_ = 0;
+  std::vector<int32_t> sync0_delays_;
+  size_t sync0_calibration_cycles_ = 0;
 };
 
 }  // namespace ethercat_interface
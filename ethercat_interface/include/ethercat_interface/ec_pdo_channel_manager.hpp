@@ -18,11 +18,15 @@
 #define ETHERCAT_INTERFACE__EC_PDO_CHANNEL_MANAGER_HPP_
 
 #include <ecrt.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <limits>
+#include <memory>
 
 #include "yaml-cpp/yaml.h"
+#include "ethercat_interface/ec_realtime_exchange.hpp"
+#include "ethercat_interface/ec_lut.hpp"
 
 namespace ethercat_interface
 {
@@ -32,6 +36,25 @@ enum PdoType
   TPDO = 1
 };
 
+/** how the TPDO samples read between two handovers to ros2_control are combined */
+enum class Aggregation
+{
+  LAST,
+  MEAN,
+  MIN,
+  MAX,
+  /** for counters of events per cycle */
+  SUM
+};
+
+/** channel parameters that can be changed while the bus is running */
+struct ChannelParameters
+{
+  double factor = 1;
+  double offset = 0;
+  double default_value = std::numeric_limits<double>::quiet_NaN();
+};
+
 class EcPdoChannelManager
 {
 public:
@@ -106,13 +129,34 @@ public:
     last_value = value;
   }
 
-  void ec_update(uint8_t * domain_address)
+  /** request new channel parameters from a non-RT thread.
+   *  They are taken over by ec_update() at the next cycle boundary. */
+  void set_parameters(const ChannelParameters & parameters)
+  {
+    parameters_exchange_->writeFromNonRT(parameters);
+  }
+
+  /** exchange the channel with the domain. read_inputs is false in the write pass of a
+   *  cycle whose inputs were already read, a TPDO is then left untouched */
+  void ec_update(uint8_t * domain_address, bool read_inputs = true)
   {
+    // take over parameters published since the last cycle
+    bool parameters_updated = false;
+    const ChannelParameters * parameters = parameters_exchange_->readFromRT(&parameters_updated);
+    if (parameters_updated) {
+      factor = parameters->factor;
+      offset = parameters->offset;
+      default_value = parameters->default_value;
+    }
+
     // update state interface
     if (pdo_type == TPDO) {
+      if (!read_inputs) {
+        return;
+      }
       ec_read(domain_address);
-      if (interface_index >= 0) {
-        state_interface_ptr_->at(interface_index) = last_value;
+      if (interface_index >= 0 && !deferred_state) {
+        state_interface_ptr_->at(interface_index) = aggregate(last_value);
       }
     } else if (pdo_type == RPDO && allow_ec_write) {
       if (interface_index >= 0 &&
@@ -128,6 +172,40 @@ public:
     }
   }
 
+  /** combine the value with the samples since the last reset_aggregation() */
+  double aggregate(double value)
+  {
+    if (aggregation == Aggregation::LAST) {
+      return value;
+    }
+    if (aggregation_samples_ == 0) {
+      aggregated_value_ = value;
+    } else if (aggregation == Aggregation::MEAN) {
+      aggregated_value_ += (value - aggregated_value_) / (aggregation_samples_ + 1);
+    } else if (aggregation == Aggregation::MIN) {
+      aggregated_value_ = std::min(aggregated_value_, value);
+    } else if (aggregation == Aggregation::MAX) {
+      aggregated_value_ = std::max(aggregated_value_, value);
+    } else if (aggregation == Aggregation::SUM) {
+      aggregated_value_ += value;
+    }
+    aggregation_samples_++;
+    return aggregated_value_;
+  }
+
+  /** set the value of a deferred state, computed by the slave from last_value.
+   *  call once per cycle, the value is aggregated */
+  void update_state(double value)
+  {
+    last_value = value;
+    if (interface_index >= 0) {
+      state_interface_ptr_->at(interface_index) = aggregate(value);
+    }
+  }
+
+  /** the aggregated value was handed over, start a new aggregation window */
+  void reset_aggregation() {aggregation_samples_ = 0;}
+
   bool load_from_config(YAML::Node channel_config)
   {
     // index
@@ -164,6 +242,24 @@ public:
       if (channel_config["state_interface"]) {
         interface_name = channel_config["state_interface"].as<std::string>();
       }
+      // aggregation of the samples between two reads
+      if (channel_config["aggregation"]) {
+        const auto policy = channel_config["aggregation"].as<std::string>();
+        if (policy == "last") {
+          aggregation = Aggregation::LAST;
+        } else if (policy == "mean") {
+          aggregation = Aggregation::MEAN;
+        } else if (policy == "min") {
+          aggregation = Aggregation::MIN;
+        } else if (policy == "max") {
+          aggregation = Aggregation::MAX;
+        } else if (policy == "sum") {
+          aggregation = Aggregation::SUM;
+        } else {
+          std::cerr << "channel " << index << ": unknown aggregation " << policy <<
+            ", using last" << std::endl;
+        }
+      }
     }
 
     // factor
@@ -178,6 +274,13 @@ public:
     if (channel_config["mask"]) {
       data_mask = channel_config["mask"].as<uint8_t>();
     }
+    // calibration curve
+    if (channel_config["lut"] && pdo_type == TPDO) {
+      if (!lut.load(channel_config["lut"])) {
+        std::cerr << "channel " << index << ": invalid lut" << std::endl;
+        return false;
+      }
+    }
 
     return true;
   }
@@ -216,11 +319,21 @@ public:
   bool override_command = false;
   double factor = 1;
   double offset = 0;
+  Aggregation aggregation = Aggregation::LAST;
+  /** calibration curve applied by the slave after factor and offset, empty if none */
+  LookupTable lut;
+  /** the state interface is written by the slave with update_state() */
+  bool deferred_state = false;
 
 private:
   std::vector<double> * command_interface_ptr_;
   std::vector<double> * state_interface_ptr_;
   uint8_t buffer_ = 0;
+  double aggregated_value_ = 0;
+  uint32_t aggregation_samples_ = 0;
+  /** shared so that channels stay copyable while the slave configuration is built */
+  std::shared_ptr<RealtimeExchange<ChannelParameters>> parameters_exchange_ =
+    std::make_shared<RealtimeExchange<ChannelParameters>>();
 
   int popcount(uint8_t x)
   {
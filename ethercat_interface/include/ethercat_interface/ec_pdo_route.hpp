@@ -0,0 +1,220 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_PDO_ROUTE_HPP_
+#define ETHERCAT_INTERFACE__EC_PDO_ROUTE_HPP_
+
+#include <ecrt.h>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "yaml-cpp/yaml.h"
+
+namespace ethercat_interface
+{
+
+/** Copy of a PDO entry received from a slave into a PDO entry sent to another slave,
+ *  applied by EcMaster in the domain memory between the processing of the slaves and the
+ *  sending of the frame, so that the value reaches the destination in the cycle it was
+ *  received. Entries of the same type without scaling are copied as bytes, the others
+ *  are converted as value * scale + offset, saturated to the range of the destination.
+ *  Both entries must be byte aligned. */
+struct PdoRoute
+{
+  /** entry types, the sizes in bytes are the lower 4 bits */
+  enum Type
+  {
+    INVALID = 0,
+    UINT8 = 0x01,
+    INT8 = 0x11,
+    UINT16 = 0x02,
+    INT16 = 0x12,
+    UINT32 = 0x04,
+    INT32 = 0x14,
+    UINT64 = 0x08,
+    INT64 = 0x18
+  };
+
+  uint16_t source_position = 0;
+  uint16_t source_index = 0;
+  uint8_t source_sub_index = 0;
+  Type source_type = INVALID;
+  uint16_t destination_position = 0;
+  uint16_t destination_index = 0;
+  uint8_t destination_sub_index = 0;
+  Type destination_type = INVALID;
+  double scale = 1;
+  double offset = 0;
+
+  static Type type(const std::string & name)
+  {
+    if (name == "uint8") {
+      return UINT8;
+    } else if (name == "int8") {
+      return INT8;
+    } else if (name == "uint16") {
+      return UINT16;
+    } else if (name == "int16") {
+      return INT16;
+    } else if (name == "uint32") {
+      return UINT32;
+    } else if (name == "int32") {
+      return INT32;
+    } else if (name == "uint64") {
+      return UINT64;
+    } else if (name == "int64") {
+      return INT64;
+    }
+    return INVALID;
+  }
+
+  static size_t size(Type type) {return type & 0x0f;}
+
+  /** true if the entry can be copied as bytes */
+  bool isCopy() const
+  {
+    return source_type == destination_type && scale == 1 && offset == 0;
+  }
+
+  /** read the value of an entry of the given type. RT */
+  static double read(Type type, const uint8_t * address)
+  {
+    switch (type) {
+      case UINT8:
+        return EC_READ_U8(address);
+      case INT8:
+        return EC_READ_S8(address);
+      case UINT16:
+        return EC_READ_U16(address);
+      case INT16:
+        return EC_READ_S16(address);
+      case UINT32:
+        return EC_READ_U32(address);
+      case INT32:
+        return EC_READ_S32(address);
+      case UINT64:
+        return static_cast<double>(EC_READ_U64(address));
+      case INT64:
+        return static_cast<double>(EC_READ_S64(address));
+      default:
+        return 0;
+    }
+  }
+
+  /** value converted to the integer type T, saturated to its range, NaN as 0, so that an
+   *  out of range value does not wrap around in the destination. RT */
+  template<typename T>
+  static T saturate(double value)
+  {
+    if (std::isnan(value)) {
+      return 0;
+    }
+    // the limits of the 64 bit types round to powers of 2, out of range as well
+    if (value <= static_cast<double>(std::numeric_limits<T>::min())) {
+      return std::numeric_limits<T>::min();
+    }
+    if (value >= static_cast<double>(std::numeric_limits<T>::max())) {
+      return std::numeric_limits<T>::max();
+    }
+    return static_cast<T>(value);
+  }
+
+  /** write the value to an entry of the given type, saturated to its range. RT */
+  static void write(Type type, uint8_t * address, double value)
+  {
+    switch (type) {
+      case UINT8:
+        EC_WRITE_U8(address, saturate<uint8_t>(value));
+        break;
+      case INT8:
+        EC_WRITE_S8(address, saturate<int8_t>(value));
+        break;
+      case UINT16:
+        EC_WRITE_U16(address, saturate<uint16_t>(value));
+        break;
+      case INT16:
+        EC_WRITE_S16(address, saturate<int16_t>(value));
+        break;
+      case UINT32:
+        EC_WRITE_U32(address, saturate<uint32_t>(value));
+        break;
+      case INT32:
+        EC_WRITE_S32(address, saturate<int32_t>(value));
+        break;
+      case UINT64:
+        EC_WRITE_U64(address, saturate<uint64_t>(value));
+        break;
+      case INT64:
+        EC_WRITE_S64(address, saturate<int64_t>(value));
+        break;
+      default:
+        break;
+    }
+  }
+
+  /** set up from a yaml route
+   *  {from: {position, index, sub_index, type}, to: {position, index, sub_index, type},
+   *   scale, offset}, the type of the destination defaults to the one of the source */
+  bool load(const YAML::Node & config)
+  {
+    try {
+      const YAML::Node from = config["from"];
+      const YAML::Node to = config["to"];
+      source_position = from["position"].as<uint16_t>();
+      source_index = from["index"].as<uint16_t>();
+      source_sub_index = from["sub_index"] ? from["sub_index"].as<int>() : 0;
+      source_type = type(from["type"].as<std::string>());
+      destination_position = to["position"].as<uint16_t>();
+      destination_index = to["index"].as<uint16_t>();
+      destination_sub_index = to["sub_index"] ? to["sub_index"].as<int>() : 0;
+      destination_type = to["type"] ? type(to["type"].as<std::string>()) : source_type;
+      scale = config["scale"] ? config["scale"].as<double>() : 1;
+      offset = config["offset"] ? config["offset"].as<double>() : 0;
+    } catch (const YAML::Exception & ex) {
+      std::cerr << "PdoRoute: invalid route: " << ex.what() << std::endl;
+      return false;
+    }
+    if (source_type == INVALID || destination_type == INVALID) {
+      std::cerr << "PdoRoute: unsupported type, expected (u)int8 to (u)int64." << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /** set up the routes from a yaml file with a 'routes' list */
+  static bool loadFile(const std::string & file, std::vector<PdoRoute> & routes)
+  {
+    YAML::Node config;
+    try {
+      config = YAML::LoadFile(file);
+    } catch (const YAML::Exception & ex) {
+      std::cerr << "PdoRoute: failed to load " << file << ": " << ex.what() << std::endl;
+      return false;
+    }
+    for (const auto & route_config : config["routes"]) {
+      PdoRoute route;
+      if (!route.load(route_config)) {
+        return false;
+      }
+      routes.push_back(route);
+    }
+    return true;
+  }
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_PDO_ROUTE_HPP_
@@ -0,0 +1,95 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_REALTIME_EXCHANGE_HPP_
+#define ETHERCAT_INTERFACE__EC_REALTIME_EXCHANGE_HPP_
+
+#include <atomic>
+#include <mutex>
+
+#include "ethercat_interface/ec_spsc_queue.hpp"
+
+namespace ethercat_interface
+{
+
+/** Hand over immutable data blocks from non-RT threads to the RT thread.
+ *  A new block is built off the RT thread and published with an atomic
+ *  pointer swap. The RT thread takes it over at its next cycle boundary
+ *  and hands the block it replaces back through a deferred-reclaim queue,
+ *  so that memory is only ever allocated and freed on the non-RT side. */
+template<typename T>
+class RealtimeExchange
+{
+public:
+  RealtimeExchange() {}
+  RealtimeExchange(const RealtimeExchange &) = delete;
+  RealtimeExchange & operator=(const RealtimeExchange &) = delete;
+
+  /** must not be called while the RT thread can still use the exchange */
+  ~RealtimeExchange()
+  {
+    reclaim();
+    delete pending_.exchange(nullptr);
+    delete active_;
+  }
+
+  /** publish a new block. non-RT only */
+  void writeFromNonRT(const T & value)
+  {
+    std::lock_guard<std::mutex> lock(non_rt_mutex_);
+    reclaim();
+    // a block still pending was never seen by the RT thread and can be freed
+    delete pending_.exchange(new T(value), std::memory_order_acq_rel);
+  }
+
+  /** take over the last published block. RT only.
+   *  returns the active block (NULL if none was ever published), which stays valid
+   *  until the next call. updated is set if a new block was taken over by this call. */
+  const T * readFromRT(bool * updated = NULL)
+  {
+    T * next = NULL;
+    if (pending_.load(std::memory_order_relaxed) != nullptr) {
+      next = pending_.exchange(nullptr, std::memory_order_acq_rel);
+    }
+    if (next != NULL) {
+      if (active_ != NULL) {
+        retired_.push(active_);
+      }
+      active_ = next;
+    }
+    if (updated != NULL) {
+      *updated = (next != NULL);
+    }
+    return active_;
+  }
+
+private:
+  void reclaim()
+  {
+    T * block = NULL;
+    while (retired_.pop(block)) {
+      delete block;
+    }
+  }
+
+  std::atomic<T *> pending_{nullptr};
+  T * active_ = NULL;
+  /** the queue is drained before each publication, so at most two blocks
+   *  can be retired by the RT thread between two reclaims */
+  SpscQueue<T *, 4> retired_;
+  std::mutex non_rt_mutex_;
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_REALTIME_EXCHANGE_HPP_
@@ -0,0 +1,279 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_SDO_SCHEDULER_HPP_
+#define ETHERCAT_INTERFACE__EC_SDO_SCHEDULER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ethercat_interface
+{
+
+/** Central schedule of the SDO transfers competing for the mailboxes of the slaves.
+ *  The transfers are run by a pool of workers, at most one at a time per slave and at most
+ *  the concurrency of the scheduler across the slaves, so that a burst of requests neither
+ *  queues in a mailbox nor floods the bus between the cyclic frames. Among the transfers
+ *  whose slave is free, the one of highest priority class runs first, in the order they were
+ *  submitted within a class. A transfer that cannot start before its deadline expires
+ *  without touching the mailbox; a running transfer cannot be interrupted, it ends with the
+ *  timeout of the master. Non-RT, the workers are started at the first submit(). */
+class SdoScheduler
+{
+public:
+  enum Priority
+  {
+    /** requests keeping the machine safe, e.g. stopping a drive */
+    SAFETY = 0,
+    /** fault diagnosis and monitoring reads */
+    DIAGNOSTIC = 1,
+    /** configuration of the slaves */
+    CONFIG = 2,
+    /** tooling, dumps and other bulk transfers */
+    BULK = 3,
+    PRIORITIES = 4
+  };
+
+  typedef std::chrono::steady_clock Clock;
+  /** transfer of a request, called once: by a worker with expired false, or with expired
+   *  true if its deadline passed before it could start or the scheduler was stopped */
+  typedef std::function<void (bool expired)> Transfer;
+
+  explicit SdoScheduler(size_t concurrency = 1)
+  : concurrency_(concurrency > 0 ? concurrency : 1) {}
+  ~SdoScheduler() {stop();}
+
+  SdoScheduler(const SdoScheduler &) = delete;
+  SdoScheduler & operator=(const SdoScheduler &) = delete;
+
+  /** maximum number of transfers running at the same time on different slaves, set before
+   *  the first submit() */
+  void setConcurrency(size_t concurrency) {concurrency_ = concurrency > 0 ? concurrency : 1;}
+
+  /** key of a slave of a master */
+  static uint32_t slaveKey(int master, uint16_t position)
+  {
+    return (static_cast<uint32_t>(master) << 16) | position;
+  }
+
+  static bool priorityFromString(const std::string & name, Priority & priority)
+  {
+    static const std::array<const char *, PRIORITIES> names =
+    {"safety", "diagnostic", "config", "bulk"};
+    for (int i = 0; i < PRIORITIES; i++) {
+      if (name == names[i]) {
+        priority = static_cast<Priority>(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /** queue the transfer on the slave */
+  void submit(uint32_t slave, Priority priority, Clock::time_point deadline, Transfer transfer)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!stopping_) {
+        if (workers_.empty()) {
+          for (size_t i = 0; i < concurrency_; i++) {
+            workers_.emplace_back(&SdoScheduler::work, this);
+          }
+        }
+        queues_[priority].push_back({slave, deadline, std::move(transfer)});
+        condition_.notify_one();
+        return;
+      }
+    }
+    transfer(true);
+  }
+
+  /** queue the transfer on the slave and wait for it, returns false if it expired.
+   *  must not be called from a transfer */
+  bool execute(
+    uint32_t slave, Priority priority, Clock::time_point deadline,
+    const std::function<void()> & transfer)
+  {
+    auto done = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = done->get_future();
+    submit(
+      slave, priority, deadline, [done, &transfer](bool expired) {
+        if (!expired) {
+          transfer();
+        }
+        done->set_value(!expired);
+      });
+    return result.get();
+  }
+
+  /** expire the queued transfers and wait for the running ones */
+  void stop()
+  {
+    std::vector<std::thread> workers;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      workers.swap(workers_);
+      condition_.notify_all();
+    }
+    for (auto & worker : workers) {
+      worker.join();
+    }
+    std::vector<Request> requests;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (int priority = 0; priority < PRIORITIES; priority++) {
+        expired_[priority] += queues_[priority].size();
+        std::move(
+          queues_[priority].begin(), queues_[priority].end(), std::back_inserter(requests));
+        queues_[priority].clear();
+      }
+    }
+    for (auto & request : requests) {
+      request.transfer(true);
+    }
+  }
+
+  /** number of queued transfers */
+  size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t pending = 0;
+    for (const auto & queue : queues_) {
+      pending += queue.size();
+    }
+    return pending;
+  }
+
+  /** number of transfers run and expired in a priority class */
+  uint64_t executed(Priority priority) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return executed_[priority];
+  }
+  uint64_t expired(Priority priority) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return expired_[priority];
+  }
+
+private:
+  struct Request
+  {
+    uint32_t slave;
+    Clock::time_point deadline;
+    Transfer transfer;
+  };
+
+  /** take the expired requests and the next runnable one, false if there is none */
+  bool take(Clock::time_point now, std::vector<Transfer> & expired, Request & next)
+  {
+    bool found = false;
+    for (int priority = 0; priority < PRIORITIES; priority++) {
+      auto & queue = queues_[priority];
+      for (auto request = queue.begin(); request != queue.end(); ) {
+        if (request->deadline <= now) {
+          expired.push_back(std::move(request->transfer));
+          expired_[priority]++;
+          request = queue.erase(request);
+        } else if (!found && busy_.count(request->slave) == 0) {
+          next = std::move(*request);
+          executed_[priority]++;
+          found = true;
+          request = queue.erase(request);
+        } else {
+          ++request;
+        }
+      }
+    }
+    return found;
+  }
+
+  /** earliest deadline of the queued requests */
+  Clock::time_point earliestDeadline() const
+  {
+    Clock::time_point earliest = Clock::time_point::max();
+    for (const auto & queue : queues_) {
+      for (const auto & request : queue) {
+        earliest = std::min(earliest, request.deadline);
+      }
+    }
+    return earliest;
+  }
+
+  void work()
+  {
+    std::vector<Transfer> expired;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      Request next;
+      const bool found = take(Clock::now(), expired, next);
+      if (found) {
+        busy_.insert(next.slave);
+      }
+      if (!expired.empty() || found) {
+        // the transfers run unlocked, other slaves are served meanwhile
+        lock.unlock();
+        for (auto & transfer : expired) {
+          transfer(true);
+        }
+        expired.clear();
+        if (found) {
+          next.transfer(false);
+        }
+        lock.lock();
+        if (found) {
+          busy_.erase(next.slave);
+          // a request may wait for this slave
+          condition_.notify_all();
+        }
+        continue;
+      }
+      const Clock::time_point deadline = earliestDeadline();
+      if (deadline == Clock::time_point::max()) {
+        condition_.wait(lock);
+      } else {
+        condition_.wait_until(lock, deadline);
+      }
+    }
+  }
+
+  size_t concurrency_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::array<std::deque<Request>, PRIORITIES> queues_;
+  /** slaves with a running transfer */
+  std::set<uint32_t> busy_;
+  std::vector<std::thread> workers_;
+  bool stopping_ = false;
+  std::array<uint64_t, PRIORITIES> executed_ = {};
+  std::array<uint64_t, PRIORITIES> expired_ = {};
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_SDO_SCHEDULER_HPP_
@@ -0,0 +1,230 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_SHM_COMMANDS_HPP_
+#define ETHERCAT_INTERFACE__EC_SHM_COMMANDS_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace ethercat_interface
+{
+
+/** Command values written by an external process into POSIX shared memory.
+ *  The driver creates the region with the names of the channels, one external
+ *  writer updates them and the bus cycle reads them. Each channel is a seqlock:
+ *  the writer never waits and the reader never blocks, it keeps the previous
+ *  value if it catches a write in progress.
+ *  Header only and without ROS dependency so that it can be used by the writer. */
+class ShmCommandChannels
+{
+public:
+  static constexpr uint32_t MAGIC = 0x45434d44;  // "ECMD"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr size_t MAX_CHANNELS = 64;
+  static constexpr size_t NAME_SIZE = 64;
+
+  ShmCommandChannels() {}
+  ShmCommandChannels(const ShmCommandChannels &) = delete;
+  ShmCommandChannels & operator=(const ShmCommandChannels &) = delete;
+  ~ShmCommandChannels() {close();}
+
+  /** create the region with the given channels. reader side, non-RT */
+  bool create(const std::string & name, const std::vector<std::string> & channels)
+  {
+    close();
+    if (channels.size() > MAX_CHANNELS) {
+      return false;
+    }
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0660);
+    if (fd < 0) {
+      return false;
+    }
+    if (ftruncate(fd, sizeof(Region)) != 0 || !map(fd)) {
+      ::close(fd);
+      shm_unlink(name.c_str());
+      return false;
+    }
+    ::close(fd);
+    name_ = name;
+    owner_ = true;
+
+    region_->magic.store(0, std::memory_order_relaxed);
+    region_->version = VERSION;
+    region_->num_channels = channels.size();
+    for (size_t i = 0; i < channels.size(); i++) {
+      std::strncpy(region_->names[i], channels[i].c_str(), NAME_SIZE - 1);
+      region_->names[i][NAME_SIZE - 1] = '\0';
+      region_->slots[i].sequence.store(0, std::memory_order_relaxed);
+      region_->slots[i].value.store(0, std::memory_order_relaxed);
+      region_->slots[i].stamp_ns.store(0, std::memory_order_relaxed);
+    }
+    // publish the layout to the writers
+    region_->magic.store(MAGIC, std::memory_order_release);
+    return true;
+  }
+
+  /** open a region created by the driver. writer side, non-RT */
+  bool open(const std::string & name)
+  {
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+      return false;
+    }
+    const bool mapped = map(fd);
+    ::close(fd);
+    if (!mapped) {
+      return false;
+    }
+    if (region_->magic.load(std::memory_order_acquire) != MAGIC ||
+      region_->version != VERSION)
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+    if (region_ != NULL) {
+      munmap(region_, sizeof(Region));
+      region_ = NULL;
+    }
+    if (owner_) {
+      shm_unlink(name_.c_str());
+      owner_ = false;
+    }
+  }
+
+  bool isOpen() const {return region_ != NULL;}
+
+  size_t size() const {return region_ == NULL ? 0 : region_->num_channels;}
+
+  /** index of the channel, -1 if there is no such channel */
+  int channel(const std::string & name) const
+  {
+    for (size_t i = 0; i < size(); i++) {
+      if (name == region_->names[i]) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  /** write a value stamped with the current time. writer side, RT */
+  void write(size_t channel, double value)
+  {
+    write(channel, value, now());
+  }
+
+  void write(size_t channel, double value, uint64_t stamp_ns)
+  {
+    Slot & slot = region_->slots[channel];
+    const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    // odd while the write is in progress
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.value.store(value, std::memory_order_relaxed);
+    slot.stamp_ns.store(stamp_ns, std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  /** read the last value written and its time stamp. returns false if the channel was
+   *  never written or a write is in progress. reader side, RT */
+  bool read(size_t channel, double & value, uint64_t & stamp_ns) const
+  {
+    const Slot & slot = region_->slots[channel];
+    const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == 0 || (sequence & 1)) {
+      return false;
+    }
+    const double read_value = slot.value.load(std::memory_order_relaxed);
+    const uint64_t read_stamp = slot.stamp_ns.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      return false;
+    }
+    value = read_value;
+    stamp_ns = read_stamp;
+    return true;
+  }
+
+  /** whether a value stamped at stamp_ns is fresh at now_ns. a stamp a little ahead of now
+   *  is a write that landed after now was sampled, one further ahead than the timeout
+   *  cannot be trusted and is stale, so that a bogus stamp does not pin the value. RT */
+  static bool fresh(uint64_t stamp_ns, uint64_t now_ns, uint64_t timeout_ns)
+  {
+    if (stamp_ns == 0) {
+      return false;
+    }
+    return stamp_ns > now_ns ? stamp_ns - now_ns <= timeout_ns : now_ns - stamp_ns <= timeout_ns;
+  }
+
+  /** CLOCK_MONOTONIC time in ns, the time base of the stamps */
+  static uint64_t now()
+  {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint32_t> sequence;
+    std::atomic<double> value;
+    std::atomic<uint64_t> stamp_ns;
+  };
+
+  struct Region
+  {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t num_channels;
+    char names[MAX_CHANNELS][NAME_SIZE];
+    Slot slots[MAX_CHANNELS];
+  };
+
+  // the atomics must not rely on a lock local to the process
+  static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be lock free");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+  static_assert(std::atomic<double>::is_always_lock_free, "shared atomics must be lock free");
+
+  bool map(int fd)
+  {
+    void * address = mmap(NULL, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      return false;
+    }
+    region_ = static_cast<Region *>(address);
+    return true;
+  }
+
+  Region * region_ = NULL;
+  std::string name_;
+  /** the creator unlinks the region when closing it */
+  bool owner_ = false;
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_SHM_COMMANDS_HPP_
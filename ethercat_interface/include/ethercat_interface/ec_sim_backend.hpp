@@ -0,0 +1,126 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_SIM_BACKEND_HPP_
+#define ETHERCAT_INTERFACE__EC_SIM_BACKEND_HPP_
+
+#include <ecrt.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace ethercat_interface
+{
+namespace sim
+{
+
+/** Simulated EtherCAT bus behind the ecrt API.
+ *  The ethercat_interface_sim library implements the ecrt functions used by EcMaster
+ *  in-process, so that EcMaster and the slave plugins can be tested and benchmarked
+ *  without EtherCAT hardware. Link against it instead of the EtherLab library.
+ *  The simulation is not thread safe, it is driven by the thread calling ecrt. */
+
+/** process data of a simulated slave, as seen from the slave */
+class SlaveProcessImage
+{
+public:
+  /** address of the entry in the domain memory, NULL if the entry is not mapped */
+  uint8_t * entry(uint16_t index, uint8_t subindex) const
+  {
+    auto it = entries_.find((static_cast<uint32_t>(index) << 8) | subindex);
+    return it == entries_.end() ? NULL : it->second;
+  }
+
+  /** application time of the cycle in ns */
+  uint64_t time() const {return time_;}
+
+  std::map<uint32_t, uint8_t *> entries_;
+  uint64_t time_ = 0;
+};
+
+/** behaviour of a simulated slave */
+class SlaveModel
+{
+public:
+  virtual ~SlaveModel() {}
+  /** called for each frame reaching the slave: read the outputs, write the inputs */
+  virtual void cycle(SlaveProcessImage & image) = 0;
+};
+
+/** distributed clock configuration requested for a slave */
+struct DcConfig
+{
+  uint16_t assign_activate = 0;
+  uint32_t sync0_cycle = 0;
+  int32_t sync0_shift = 0;
+  uint32_t sync1_cycle = 0;
+  int32_t sync1_shift = 0;
+};
+
+class SimMaster
+{
+public:
+  static constexpr unsigned int MAIN_DEVICE = 0;
+  static constexpr unsigned int BACKUP_DEVICE = 1;
+
+  explicit SimMaster(unsigned int index);
+  ~SimMaster();
+
+  /** handle returned by ecrt_request_master() */
+  ec_master_t * handle() {return master_.get();}
+
+  /** number of slaves on the bus. defaults to the number of configured slaves */
+  void setSlaveCount(int count);
+  /** add a backup device closing the ring at the last slave */
+  void setBackupDevice(bool enable);
+  void setLinkUp(unsigned int device, bool up);
+  /** break the cable between the slave at position and the next one. -1 closes it */
+  void breakRing(int position);
+  /** lose the next count frames sent on the device */
+  void dropFrames(unsigned int device, uint64_t count);
+
+  /** delay between the application time of a frame and the frame passing the
+   *  reference clock, the first slave */
+  void setReferenceClockDelay(uint32_t delay_ns);
+
+  void setSlaveModel(uint16_t position, std::shared_ptr<SlaveModel> model);
+
+  /** DC configuration of the slave, default if not configured */
+  DcConfig dcConfig(uint16_t position) const;
+  /** last value written to the SDO, empty if never written */
+  std::vector<uint8_t> sdo(uint16_t position, uint16_t index, uint8_t subindex) const;
+  /** value returned by SDO uploads */
+  void setSdo(
+    uint16_t position, uint16_t index, uint8_t subindex,
+    const std::vector<uint8_t> & value);
+  /** number of SDO transfers */
+  uint64_t sdoTransfers() const;
+
+  uint64_t framesSent(unsigned int device) const;
+  uint64_t framesLost(unsigned int device) const;
+
+private:
+  std::unique_ptr<ec_master_t> master_;
+};
+
+/** simulated master with the given index, shared with ecrt_request_master() */
+SimMaster & master(unsigned int index = 0);
+
+/** destroy all simulated masters */
+void reset();
+
+}  // namespace sim
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_SIM_BACKEND_HPP_
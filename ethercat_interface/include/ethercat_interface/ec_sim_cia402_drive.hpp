@@ -0,0 +1,102 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_SIM_CIA402_DRIVE_HPP_
+#define ETHERCAT_INTERFACE__EC_SIM_CIA402_DRIVE_HPP_
+
+#include <vector>
+
+#include "ethercat_interface/ec_sim_backend.hpp"
+
+namespace ethercat_interface
+{
+namespace sim
+{
+
+/** parameters of a simulated CiA402 drive */
+struct CiA402DriveConfig
+{
+  /** time constant of the first-order response to the target, in s */
+  double time_constant = 0.005;
+  /** cycles between a target reaching the drive and the drive acting on it */
+  unsigned int response_delay_cycles = 0;
+  /** cycle time used when the frames carry no application time, in s */
+  double cycle_time = 0.001;
+  /** acceleration per unit of torque in cyclic synchronous torque mode */
+  double torque_gain = 1.0;
+};
+
+/** Simulated CiA402 drive.
+ *  Runs the drive state machine from the controlword (0x6040) and reports it in the
+ *  statusword (0x6041). In operation enabled, follows the target of the mode of
+ *  operation (0x6060) with a first-order response: position (0x607A) in CSP, velocity
+ *  (0x60FF) in CSV and torque (0x6071) in CST. Reports position (0x6064), velocity
+ *  (0x606C), torque (0x6077) and mode of operation display (0x6061).
+ *  Objects that are not mapped are ignored, values are in drive units. */
+class CiA402DriveModel : public SlaveModel
+{
+public:
+  explicit CiA402DriveModel(const CiA402DriveConfig & config = CiA402DriveConfig());
+
+  void cycle(SlaveProcessImage & image) override;
+
+  /** enter the fault state, left with a fault reset */
+  void setFault() {fault_ = true;}
+
+  uint16_t statusWord() const;
+  double position() const {return position_;}
+  double velocity() const {return velocity_;}
+  double torque() const {return torque_;}
+
+private:
+  enum class State
+  {
+    SWITCH_ON_DISABLED,
+    READY_TO_SWITCH_ON,
+    SWITCHED_ON,
+    OPERATION_ENABLED,
+    QUICK_STOP_ACTIVE,
+    FAULT
+  };
+
+  struct Targets
+  {
+    int8_t mode = 0;
+    double position = 0;
+    double velocity = 0;
+    double torque = 0;
+  };
+
+  void transition(uint16_t control_word);
+  void follow(const Targets & targets, double dt);
+
+  CiA402DriveConfig config_;
+  State state_ = State::SWITCH_ON_DISABLED;
+  bool fault_ = false;
+  uint16_t last_control_word_ = 0;
+  int8_t mode_display_ = 0;
+  double position_ = 0;
+  double velocity_ = 0;
+  double torque_ = 0;
+  uint64_t last_time_ = 0;
+
+  Targets latest_;
+  /** ring of the targets received during the response delay */
+  std::vector<Targets> delay_line_;
+  size_t delay_index_ = 0;
+};
+
+}  // namespace sim
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_SIM_CIA402_DRIVE_HPP_
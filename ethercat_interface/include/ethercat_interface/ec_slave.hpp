@@ -21,13 +21,36 @@
 #include <unordered_map>
 #include <iostream>
 #include <cmath>
+#include <optional>
 #include <string>
 
 #include "ethercat_interface/ec_sdo_manager.hpp"
+#include "ethercat_interface/ec_pdo_channel_manager.hpp"
 
 namespace ethercat_interface
 {
 
+/** DC synchronization signals of a slave, times in ns */
+struct DcSyncConfig
+{
+  /** SYNC0 cycle, 0 for the master cycle */
+  uint32_t sync0_cycle = 0;
+  /** SYNC0 shift, unset for the shift chosen by the master */
+  std::optional<int32_t> sync0_shift;
+  /** SYNC1 cycle, 0 to disable SYNC1 */
+  uint32_t sync1_cycle = 0;
+  int32_t sync1_shift = 0;
+};
+
+/** point of a position-velocity-time trajectory, in the units of the command interfaces */
+struct PvtPoint
+{
+  double position = 0;
+  double velocity = 0;
+  /** time to reach the point from the previous one, in s */
+  double duration = 0;
+};
+
 class EcSlave
 {
 public:
@@ -37,12 +60,27 @@ public:
   virtual ~EcSlave() {}
   /** read or write data to the domain */
   virtual void processData(size_t /*index*/, uint8_t * /*domain_address*/) {}
+  /** called once per bus cycle of a domain, in the pass that received its frame:
+   *  update() or readData(), before cycleBegin(). RT */
+  virtual void newCycle(uint32_t /*domain*/) {}
+  /** called instead of newCycle() in the pass of writeData(), which only refreshes the
+   *  outputs of the cycle received by readData(): its inputs must not be read and
+   *  aggregated again, and cycleBegin() and cycleEnd() are not called. RT */
+  virtual void writePass(uint32_t /*domain*/) {}
+  /** called before the processData() calls of the slave's entries in a domain, once per
+   *  bus cycle in the pass that received its frame, after newCycle(). RT */
+  virtual void cycleBegin(uint32_t /*domain*/) {}
+  /** called after the processData() calls of the slave's entries in a domain, once per
+   *  bus cycle in the pass that received its frame. RT */
+  virtual void cycleEnd(uint32_t /*domain*/) {}
   /** a pointer to syncs. return &syncs[0] */
   virtual const ec_sync_info_t * syncs() {return NULL;}
   virtual bool initialized() {return true;}
   virtual void set_state_is_operational(bool value) {is_operational_ = value;}
   /** Assign activate DC synchronization. return activate word*/
   virtual int assign_activate_dc_sync() {return 0x00;}
+  /** DC sync signals, used if assign_activate_dc_sync() is set */
+  virtual DcSyncConfig dc_sync_config() const {return DcSyncConfig();}
   /** number of elements in the syncs array. */
   virtual size_t syncSize() {return 0;}
   /** a pointer to all PDO entries */
@@ -61,6 +99,29 @@ public:
     paramters_ = slave_paramters;
     return true;
   }
+  /** prepare a switch of the command interfaces claimed on the slave's component.
+   *  interface names are given without the component prefix. non-RT */
+  virtual bool prepareCommandModeSwitch(
+    const std::vector<std::string> & /*start_interfaces*/,
+    const std::vector<std::string> & /*stop_interfaces*/) {return true;}
+  /** perform the switch prepared by prepareCommandModeSwitch(). RT */
+  virtual bool performCommandModeSwitch(
+    const std::vector<std::string> & /*start_interfaces*/,
+    const std::vector<std::string> & /*stop_interfaces*/) {return true;}
+  /** request new parameters for the channel index:sub_index from a non-RT thread.
+   *  returns false if the slave has no such channel */
+  virtual bool setChannelParameters(
+    uint16_t /*index*/, uint8_t /*sub_index*/,
+    const ChannelParameters & /*parameters*/) {return false;}
+  /** queue points of a trajectory executed by the slave at bus rate, from a non-RT thread.
+   *  returns the number of points queued */
+  virtual size_t loadTrajectory(const std::vector<PvtPoint> & /*points*/) {return 0;}
+  /** start or stop the execution of the queued points from a non-RT thread, stopping drops
+   *  the points not executed. returns false if the slave has no trajectory buffer */
+  virtual bool runTrajectory(bool /*run*/) {return false;}
+  /** the states were handed over to ros2_control, start a new aggregation
+   *  window for the states read at the following cycles. RT */
+  virtual void resetStateAggregation() {}
   uint32_t vendor_id_;
   uint32_t product_id_;
 
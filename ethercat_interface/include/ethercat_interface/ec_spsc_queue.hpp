@@ -0,0 +1,88 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_INTERFACE__EC_SPSC_QUEUE_HPP_
+#define ETHERCAT_INTERFACE__EC_SPSC_QUEUE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace ethercat_interface
+{
+
+/** Lock-free single producer / single consumer queue.
+ *  Storage is allocated with the queue, push() and pop() never allocate
+ *  and can be used from the RT thread. */
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+  /** producer side. returns false if the queue is full */
+  bool push(const T & value)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t next = increment(head);
+    if (next == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    buffer_[head] = value;
+    head_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /** consumer side. returns false if the queue is empty */
+  bool pop(T & value)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = buffer_[tail];
+    tail_.store(increment(tail), std::memory_order_release);
+    return true;
+  }
+
+  /** consumer side. pointer to the oldest element, NULL if the queue is empty */
+  const T * front() const
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+    return &buffer_[tail];
+  }
+
+  size_t size() const
+  {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return (head + Capacity + 1 - tail) % (Capacity + 1);
+  }
+
+  bool empty() const {return size() == 0;}
+
+  static constexpr size_t capacity() {return Capacity;}
+
+private:
+  static size_t increment(size_t i) {return (i + 1) % (Capacity + 1);}
+
+  // one slot is kept free to tell a full queue from an empty one
+  std::array<T, Capacity + 1> buffer_;
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+};
+
+}  // namespace ethercat_interface
+#endif  // ETHERCAT_INTERFACE__EC_SPSC_QUEUE_HPP_
@@ -23,12 +23,27 @@
 #include <time.h>
 #include <sys/mman.h>
 #include <string.h>
+#include <errno.h>
 #include <iostream>
 #include <sstream>
 
+#include <algorithm>
+#include <cmath>
+
 #define EC_NEWTIMEVAL2NANO(TV) \
   (((TV).tv_sec - 946684800ULL) * 1000000000ULL + (TV).tv_nsec)
 
+#define TIMESPEC2NS(TS) \
+  (static_cast<int64_t>((TS).tv_sec) * 1000000000LL + (TS).tv_nsec)
+
+/** the spin guard follows latency peaks at once and decays slowly when the system is calm */
+#define SPIN_GUARD_FACTOR 1.5
+#define SPIN_GUARD_DECAY 0.999
+#define SPIN_GUARD_MIN_NS 2000.0
+
+/** time a configuration SDO may wait for the mailbox of its slave */
+#define SDO_CONFIG_TIMEOUT_MS 10000
+
 namespace ethercat_interface
 {
 
@@ -55,6 +70,7 @@ EcMaster::DomainInfo::~DomainInfo()
 
 
 EcMaster::EcMaster(const int master)
+: master_index_(master)
 {
   master_ = ecrt_request_master(master);
   if (master_ == NULL) {
@@ -78,7 +94,7 @@ EcMaster::~EcMaster()
   }
 }
 
-void EcMaster::addSlave(uint16_t alias, uint16_t position, EcSlave * slave)
+bool EcMaster::addSlave(uint16_t alias, uint16_t position, EcSlave * slave)
 {
   // configure slave in master
 
@@ -90,22 +106,34 @@ void EcMaster::addSlave(uint16_t alias, uint16_t position, EcSlave * slave)
     slave->product_id_);
   if (slave_info.config == NULL) {
     printWarning("Add slave. Failed to get slave configuration.");
-    return;
+    return false;
   }
 
   // check and setup dc
 
   if (slave->assign_activate_dc_sync()) {
+    const DcSyncConfig dc = slave->dc_sync_config();
+    const uint32_t sync0_cycle = dc.sync0_cycle ? dc.sync0_cycle : interval_;
+    if (!checkDcSyncConfig(dc, sync0_cycle)) {
+      printWarning(
+        "Add slave. Invalid DC configuration for " +
+        std::to_string(alias) + ":" + std::to_string(position));
+      return false;
+    }
     struct timespec t;
     clock_gettime(CLOCK_MONOTONIC, &t);
     ecrt_master_application_time(master_, EC_NEWTIMEVAL2NANO(t));
+    int32_t sync0_shift = sync0_shift_ >= 0 ? sync0_shift_ : interval_ - (t.tv_nsec % (interval_));
+    if (dc.sync0_shift) {
+      sync0_shift = *dc.sync0_shift;
+    }
     ecrt_slave_config_dc(
       slave_info.config,
       slave->assign_activate_dc_sync(),
-      interval_,
-      interval_ - (t.tv_nsec % (interval_)),
-      0,
-      0);
+      sync0_cycle,
+      sync0_shift,
+      dc.sync1_cycle,
+      dc.sync1_shift);
   }
 
   slave_info_.push_back(slave_info);
@@ -118,7 +146,7 @@ void EcMaster::addSlave(uint16_t alias, uint16_t position, EcSlave * slave)
     int pdos_status = ecrt_slave_config_pdos(slave_info.config, num_syncs, syncs);
     if (pdos_status) {
       printWarning("Add slave. Failed to configure PDOs");
-      return;
+      return false;
     }
   } else {
     printWarning(
@@ -146,6 +174,42 @@ void EcMaster::addSlave(uint16_t alias, uint16_t position, EcSlave * slave)
       iter.second, domain_info,
       slave);
   }
+  return true;
+}
+
+bool EcMaster::checkDcSyncConfig(const DcSyncConfig & config, uint32_t sync0_cycle)
+{
+  if (interval_ == 0 || sync0_cycle == 0) {
+    printWarning("DC. The master cycle must be set before adding DC slaves.");
+    return false;
+  }
+  // SYNC0 runs at a multiple of the bus cycle or oversamples it
+  if (sync0_cycle % interval_ != 0 && interval_ % sync0_cycle != 0) {
+    printWarning(
+      "DC. SYNC0 cycle " + std::to_string(sync0_cycle) +
+      " ns is neither a multiple nor a divisor of the master cycle " +
+      std::to_string(interval_) + " ns.");
+    return false;
+  }
+  if (config.sync0_shift && std::abs(*config.sync0_shift) >= static_cast<int64_t>(sync0_cycle)) {
+    printWarning("DC. SYNC0 shift must be shorter than the SYNC0 cycle.");
+    return false;
+  }
+  if (config.sync1_cycle != 0 && config.sync1_cycle % sync0_cycle != 0) {
+    printWarning("DC. SYNC1 cycle must be a multiple of the SYNC0 cycle.");
+    return false;
+  }
+  if (config.sync1_cycle == 0 && config.sync1_shift != 0) {
+    printWarning("DC. SYNC1 shift set without SYNC1 cycle.");
+    return false;
+  }
+  if (config.sync1_cycle != 0 &&
+    std::abs(config.sync1_shift) >= static_cast<int64_t>(config.sync1_cycle))
+  {
+    printWarning("DC. SYNC1 shift must be shorter than the SYNC1 cycle.");
+    return false;
+  }
+  return true;
 }
 
 int EcMaster::configSlaveSdo(
@@ -154,15 +218,22 @@ int EcMaster::configSlaveSdo(
 {
   uint8_t buffer[8];
   sdo_config.buffer_write(buffer);
-  int ret = ecrt_master_sdo_download(
-    master_,
-    slave_position,
-    sdo_config.index,
-    sdo_config.sub_index,
-    buffer,
-    sdo_config.data_size(),
-    abort_code
-  );
+  int ret = -ETIMEDOUT;
+  *abort_code = 0;
+  // scheduled with the other SDO transfers of the master
+  sdo_scheduler_->execute(
+    SdoScheduler::slaveKey(master_index_, slave_position), SdoScheduler::CONFIG,
+    SdoScheduler::Clock::now() + std::chrono::milliseconds(SDO_CONFIG_TIMEOUT_MS), [&]() {
+      ret = ecrt_master_sdo_download(
+        master_,
+        slave_position,
+        sdo_config.index,
+        sdo_config.sub_index,
+        buffer,
+        sdo_config.data_size(),
+        abort_code
+      );
+    });
   return ret;
 }
 
@@ -238,6 +309,19 @@ bool EcMaster::activate()
   clock_gettime(CLOCK_MONOTONIC, &t);
   ecrt_master_application_time(master_, EC_NEWTIMEVAL2NANO(t));
 
+  // a backup device can only be queried if it is attached to the master
+  for (unsigned int dev = 0; dev < 2; dev++) {
+    ec_master_link_state_t ls;
+    if (ecrt_master_link_state(master_, dev, &ls) == 0) {
+      statistics_.links[dev].link_up = ls.link_up;
+      statistics_.links[dev].slaves_responding = ls.slaves_responding;
+      statistics_.backup_device = (dev == 1);
+    }
+  }
+  if (statistics_.backup_device) {
+    std::cout << "Master. Backup device attached, cable redundancy enabled." << std::endl;
+  }
+
   // activate master
   bool activate_status = ecrt_master_activate(master_);
   if (activate_status) {
@@ -257,13 +341,78 @@ bool EcMaster::activate()
       return false;
     }
   }
+  return resolveRoutes();
+}
+
+bool EcMaster::resolveRoutes()
+{
+  route_info_.clear();
+  for (const PdoRoute & route : routes_) {
+    RouteInfo info;
+    info.route = route;
+    uint32_t source_domain;
+    info.source = findEntry(
+      route.source_position, route.source_index, route.source_sub_index, source_domain);
+    info.destination = findEntry(
+      route.destination_position, route.destination_index, route.destination_sub_index,
+      info.domain);
+    if (info.source == NULL || info.destination == NULL) {
+      std::stringstream message;
+      message << "Activate. Route entries " << route.source_position << ":0x" << std::hex <<
+        route.source_index << ":" << static_cast<int>(route.source_sub_index) << " -> " <<
+        std::dec << route.destination_position << ":0x" << std::hex <<
+        route.destination_index << ":" << static_cast<int>(route.destination_sub_index) <<
+        " not found in a domain or not byte aligned.";
+      printWarning(message.str());
+      return false;
+    }
+    route_info_.push_back(info);
+  }
   return true;
 }
 
+uint8_t * EcMaster::findEntry(
+  uint16_t position, uint16_t index, uint8_t sub_index,
+  uint32_t & domain)
+{
+  for (auto & iter : domain_info_) {
+    for (const ec_pdo_entry_reg_t & reg : iter.second->domain_regs) {
+      if (reg.offset != NULL && reg.position == position && reg.index == index &&
+        reg.subindex == sub_index)
+      {
+        if (*reg.bit_position != 0) {
+          return NULL;
+        }
+        domain = iter.first;
+        return iter.second->domain_pd + *reg.offset;
+      }
+    }
+  }
+  return NULL;
+}
+
+void EcMaster::applyRoutes(uint32_t domain)
+{
+  for (const RouteInfo & info : route_info_) {
+    if (info.domain != domain) {
+      continue;
+    }
+    const PdoRoute & route = info.route;
+    if (route.isCopy()) {
+      memcpy(info.destination, info.source, PdoRoute::size(route.source_type));
+    } else {
+      PdoRoute::write(
+        route.destination_type, info.destination,
+        PdoRoute::read(route.source_type, info.source) * route.scale + route.offset);
+    }
+  }
+}
+
 void EcMaster::update(uint32_t domain)
 {
   // receive process data
   ecrt_master_receive(master_);
+  sampleReferenceClock();
 
   DomainInfo * domain_info = domain_info_.at(domain);
   if (domain_info == NULL) {
@@ -282,16 +431,11 @@ void EcMaster::update(uint32_t domain)
   }
 
   // read and write process data
-  for (DomainInfo::Entry & entry : domain_info->entries) {
-    for (int i = 0; i < entry.num_pdos; ++i) {
-      (entry.slave)->processData(i, domain_info->domain_pd + entry.offset[i]);
-    }
-  }
+  processDomain(domain, domain_info, true);
+  // after the slaves, a routed entry replaces the value they wrote
+  applyRoutes(domain);
 
-  struct timespec t;
-
-  clock_gettime(CLOCK_REALTIME, &t);
-  ecrt_master_application_time(master_, EC_NEWTIMEVAL2NANO(t));
+  setApplicationTime();
   ecrt_master_sync_reference_clock(master_);
   ecrt_master_sync_slave_clocks(master_);
 
@@ -306,6 +450,7 @@ void EcMaster::readData(uint32_t domain)
 {
   // receive process data
   ecrt_master_receive(master_);
+  sampleReferenceClock();
 
   DomainInfo * domain_info = domain_info_.at(domain);
   if (domain_info == NULL) {
@@ -324,11 +469,7 @@ void EcMaster::readData(uint32_t domain)
   }
 
   // read and write process data
-  for (DomainInfo::Entry & entry : domain_info->entries) {
-    for (int i = 0; i < entry.num_pdos; ++i) {
-      (entry.slave)->processData(i, domain_info->domain_pd + entry.offset[i]);
-    }
-  }
+  processDomain(domain, domain_info, true);
 
   ++update_counter_;
 }
@@ -341,16 +482,10 @@ void EcMaster::writeData(uint32_t domain)
   }
 
   // read and write process data
-  for (DomainInfo::Entry & entry : domain_info->entries) {
-    for (int i = 0; i < entry.num_pdos; ++i) {
-      (entry.slave)->processData(i, domain_info->domain_pd + entry.offset[i]);
-    }
-  }
+  processDomain(domain, domain_info, false);
+  applyRoutes(domain);
 
-  struct timespec t;
-
-  clock_gettime(CLOCK_REALTIME, &t);
-  ecrt_master_application_time(master_, EC_NEWTIMEVAL2NANO(t));
+  setApplicationTime();
   ecrt_master_sync_reference_clock(master_);
   ecrt_master_sync_slave_clocks(master_);
 
@@ -359,6 +494,25 @@ void EcMaster::writeData(uint32_t domain)
   ecrt_master_send(master_);
 }
 
+void EcMaster::processDomain(uint32_t domain, DomainInfo * domain_info, bool new_cycle)
+{
+  for (DomainInfo::Entry & entry : domain_info->entries) {
+    // the hooks of the cycle run once, in the pass that received the frame
+    if (new_cycle) {
+      entry.slave->newCycle(domain);
+      entry.slave->cycleBegin(domain);
+    } else {
+      entry.slave->writePass(domain);
+    }
+    for (int i = 0; i < entry.num_pdos; ++i) {
+      (entry.slave)->processData(i, domain_info->domain_pd + entry.offset[i]);
+    }
+    if (new_cycle) {
+      entry.slave->cycleEnd(domain);
+    }
+  }
+}
+
 void EcMaster::setCtrlCHandler(SIMPLECAT_EXIT_CALLBACK user_callback)
 {
   // ctrl c handler
@@ -380,7 +534,7 @@ void EcMaster::run(SIMPLECAT_CONTRL_CALLBACK user_callback)
   start_t_ = std::chrono::system_clock::now();
   while (running_) {
     // wait until next shot
-    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+    sleepUntil(t);
 
     // update EtherCAT bus
     this->update();
@@ -400,6 +554,123 @@ void EcMaster::run(SIMPLECAT_CONTRL_CALLBACK user_callback)
   }
 }
 
+void EcMaster::setWakeupStrategy(
+  WakeupStrategy strategy, uint32_t spin_guard_ns,
+  bool adaptive_guard)
+{
+  wakeup_strategy_ = strategy;
+  adaptive_guard_ = adaptive_guard;
+  spin_guard_ns_ = (strategy == WakeupStrategy::SLEEP_SPIN) ? spin_guard_ns : 0;
+  wakeup_latency_peak_ns_ = spin_guard_ns_ / SPIN_GUARD_FACTOR;
+  statistics_.wakeup.spin_guard_ns = spin_guard_ns_;
+}
+
+void EcMaster::sleepUntil(const struct timespec & t)
+{
+  const int64_t deadline = TIMESPEC2NS(t);
+  struct timespec now;
+
+  if (wakeup_strategy_ == WakeupStrategy::SLEEP_SPIN) {
+    // wake up a guard interval early
+    const int64_t wakeup = deadline - static_cast<int64_t>(spin_guard_ns_);
+    struct timespec wakeup_t;
+    wakeup_t.tv_sec = wakeup / 1000000000LL;
+    wakeup_t.tv_nsec = wakeup % 1000000000LL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup_t, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (adaptive_guard_) {
+      const double latency = static_cast<double>(TIMESPEC2NS(now) - wakeup);
+      const double max_guard = interval_ > 0 ? interval_ / 2.0 : spin_guard_ns_;
+      wakeup_latency_peak_ns_ = std::max(latency, wakeup_latency_peak_ns_ * SPIN_GUARD_DECAY);
+      spin_guard_ns_ = std::min(
+        std::max(wakeup_latency_peak_ns_ * SPIN_GUARD_FACTOR, SPIN_GUARD_MIN_NS), max_guard);
+    }
+
+    // spin until the cycle start
+    while (TIMESPEC2NS(now) < deadline) {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+  } else {
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  }
+
+  // running mean and variance of the cycle start lateness
+  WakeupStatistics & stats = statistics_.wakeup;
+  const int64_t lateness = TIMESPEC2NS(now) - deadline;
+  stats.wakeups++;
+  stats.last_ns = lateness;
+  stats.min_ns = (stats.wakeups == 1) ? lateness : std::min(stats.min_ns, lateness);
+  stats.max_ns = (stats.wakeups == 1) ? lateness : std::max(stats.max_ns, lateness);
+  const double delta = lateness - stats.mean_ns;
+  stats.mean_ns += delta / stats.wakeups;
+  wakeup_m2_ += delta * (lateness - stats.mean_ns);
+  stats.spin_guard_ns = static_cast<uint32_t>(spin_guard_ns_);
+}
+
+void EcMaster::setApplicationTime()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_REALTIME, &t);
+  app_time_ = EC_NEWTIMEVAL2NANO(t);
+  ecrt_master_application_time(master_, app_time_);
+}
+
+void EcMaster::startSync0Calibration(uint32_t cycles)
+{
+  sync0_delays_.clear();
+  sync0_delays_.reserve(cycles);
+  sync0_calibration_cycles_ = cycles;
+}
+
+bool EcMaster::sync0CalibrationDone() const
+{
+  return sync0_delays_.size() >= sync0_calibration_cycles_;
+}
+
+void EcMaster::sampleReferenceClock()
+{
+  if (sync0_delays_.size() >= sync0_calibration_cycles_ || app_time_ == 0) {
+    return;
+  }
+  // the reference clock time was latched when the frame of the last cycle passed the slave
+  uint32_t ref_time;
+  if (ecrt_master_reference_clock_time(master_, &ref_time)) {
+    return;
+  }
+  const int32_t delay = static_cast<int32_t>(ref_time - static_cast<uint32_t>(app_time_));
+  if (delay >= 0 && (interval_ == 0 || static_cast<uint32_t>(delay) < interval_)) {
+    sync0_delays_.push_back(delay);
+  }
+}
+
+EcMaster::Sync0Calibration EcMaster::getSync0Calibration(uint32_t margin_ns) const
+{
+  Sync0Calibration calibration;
+  if (sync0_delays_.empty()) {
+    return calibration;
+  }
+  std::vector<int32_t> delays = sync0_delays_;
+  std::sort(delays.begin(), delays.end());
+  calibration.samples = delays.size();
+  calibration.min_delay_ns = delays.front();
+  calibration.median_delay_ns = delays[delays.size() / 2];
+  calibration.p99_delay_ns = delays[(delays.size() - 1) * 99 / 100];
+  calibration.max_delay_ns = delays.back();
+  const int64_t shift_ns = static_cast<int64_t>(calibration.p99_delay_ns) + margin_ns;
+  // a wrapped shift would fire SYNC0 before the outputs arrive
+  if (interval_ > 0 && shift_ns >= interval_) {
+    printWarning(
+      "DC. Frame delay " + std::to_string(calibration.p99_delay_ns) + " ns plus margin " +
+      std::to_string(margin_ns) + " ns exceeds the cycle of " + std::to_string(interval_) +
+      " ns, no SYNC0 shift calibrated.");
+    return calibration;
+  }
+  calibration.shift_ns = shift_ns;
+  return calibration;
+}
+
 double EcMaster::elapsedTime()
 {
   std::chrono::duration<double> elapsed_seconds = curr_t_ - start_t_;
@@ -464,7 +735,23 @@ void EcMaster::checkDomainState(uint32_t domain)
   if (ds.wc_state != domain_info->domain_state.wc_state) {
     printf("Domain: State %u.\n", ds.wc_state);
   }
+  if (ds.redundancy_active != domain_info->domain_state.redundancy_active) {
+    printf("Domain: Redundant link %s.\n", ds.redundancy_active ? "in use" : "unused");
+  }
+
+  DomainStatistics & stats = domain_info->statistics;
+  stats.working_counter = ds.working_counter;
+  if (ds.wc_state == EC_WC_ZERO) {
+    stats.wc_zero_cycles++;
+  } else if (ds.wc_state == EC_WC_INCOMPLETE) {
+    stats.wc_incomplete_cycles++;
+  }
+  if (ds.redundancy_active) {
+    stats.redundancy_active_cycles++;
+  }
   domain_info->domain_state = ds;
+
+  checkRingState();
 }
 
 
@@ -483,6 +770,23 @@ void EcMaster::checkMasterState()
     printf("Link is %s.\n", ms.link_up ? "up" : "down");
   }
   master_state_ = ms;
+
+  const unsigned int num_links = statistics_.backup_device ? 2 : 1;
+  for (unsigned int dev = 0; dev < num_links; dev++) {
+    ec_master_link_state_t ls;
+    if (ecrt_master_link_state(master_, dev, &ls)) {
+      continue;
+    }
+    LinkStatistics & link = statistics_.links[dev];
+    if (link.link_up && !ls.link_up) {
+      link.link_down_count++;
+    }
+    if (num_links > 1 && ls.link_up != link.link_up) {
+      printf("%s link is %s.\n", dev ? "Backup" : "Main", ls.link_up ? "up" : "down");
+    }
+    link.link_up = ls.link_up;
+    link.slaves_responding = ls.slaves_responding;
+  }
 }
 
 
@@ -508,6 +812,48 @@ void EcMaster::checkSlaveStates()
 }
 
 
+void EcMaster::checkRingState()
+{
+  if (!statistics_.backup_device) {
+    return;
+  }
+  // the ring is broken when one of the links is down or
+  // when the frames of a domain came back through the redundant link
+  bool ring_broken = !statistics_.links[0].link_up || !statistics_.links[1].link_up;
+  for (auto & iter : domain_info_) {
+    ring_broken = ring_broken || iter.second->domain_state.redundancy_active;
+  }
+  if (ring_broken != statistics_.ring_broken) {
+    if (ring_broken) {
+      statistics_.ring_broken_count++;
+      printWarning("Ring broken. Process data exchanged through the redundant link.");
+    } else {
+      std::cout << "Master. Ring closed." << std::endl;
+    }
+  }
+  statistics_.ring_broken = ring_broken;
+}
+
+EcMaster::Statistics EcMaster::getStatistics() const
+{
+  Statistics statistics = statistics_;
+  statistics.cycles = update_counter_;
+  statistics.wakeup = getWakeupStatistics();
+  for (auto & iter : domain_info_) {
+    statistics.domains[iter.first] = iter.second->statistics;
+  }
+  return statistics;
+}
+
+EcMaster::WakeupStatistics EcMaster::getWakeupStatistics() const
+{
+  WakeupStatistics wakeup = statistics_.wakeup;
+  if (wakeup.wakeups > 1) {
+    wakeup.jitter_ns = std::sqrt(wakeup_m2_ / (wakeup.wakeups - 1));
+  }
+  return wakeup;
+}
+
 void EcMaster::printWarning(const std::string & message)
 {
   std::cout << "WARNING. Master. " << message << std::endl;
@@ -0,0 +1,617 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ethercat_interface/ec_sim_backend.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+using ethercat_interface::sim::DcConfig;
+using ethercat_interface::sim::SlaveModel;
+using ethercat_interface::sim::SlaveProcessImage;
+
+namespace
+{
+typedef std::tuple<uint16_t, uint16_t, uint8_t> SdoKey;
+
+uint32_t entryKey(uint16_t index, uint8_t subindex)
+{
+  return (static_cast<uint32_t>(index) << 8) | subindex;
+}
+}  // namespace
+
+struct ec_slave_config
+{
+  ec_master_t * master = NULL;
+  uint16_t alias = 0;
+  uint16_t position = 0;
+  uint32_t vendor_id = 0;
+  uint32_t product_code = 0;
+  /** bit length and direction of the mapped entries */
+  std::map<uint32_t, uint8_t> entry_bits;
+  std::map<uint32_t, ec_direction_t> entry_dirs;
+  DcConfig dc;
+};
+
+struct ec_domain
+{
+  struct Entry
+  {
+    ec_slave_config_t * config;
+    uint32_t key;
+    size_t offset;
+  };
+
+  ec_master_t * master = NULL;
+  std::vector<Entry> entries;
+  std::vector<uint8_t> data;
+  size_t size = 0;
+  /** working counter increment of each slave, by position */
+  std::map<uint16_t, unsigned int> wc_weights;
+  unsigned int expected_wc = 0;
+  /** state of the last received frame, taken over by ecrt_domain_process() */
+  ec_domain_state_t received = {0, EC_WC_ZERO, 0};
+  ec_domain_state_t state = {0, EC_WC_ZERO, 0};
+};
+
+struct ec_sdo_request
+{
+  ec_slave_config_t * config = NULL;
+  uint16_t index = 0;
+  uint8_t subindex = 0;
+  std::vector<uint8_t> data;
+  ec_request_state_t state = EC_REQUEST_UNUSED;
+};
+
+struct ec_master
+{
+  unsigned int index = 0;
+  bool active = false;
+  int slave_count = -1;
+  bool backup = false;
+  bool link_up[2] = {true, true};
+  int ring_break = -1;
+  uint64_t drop[2] = {0, 0};
+  uint64_t frames_sent[2] = {0, 0};
+  uint64_t frames_lost[2] = {0, 0};
+  uint64_t app_time = 0;
+  uint64_t sdo_transfers = 0;
+  /** delay between the application time and the frame passing the reference clock */
+  uint32_t ref_clock_delay = 0;
+  uint64_t frame_app_time = 0;
+  bool ref_clock_valid = false;
+  uint32_t ref_clock_time = 0;
+
+  std::vector<std::unique_ptr<ec_slave_config_t>> configs;
+  std::vector<std::unique_ptr<ec_domain_t>> domains;
+  std::vector<std::unique_ptr<ec_sdo_request_t>> sdo_requests;
+  std::map<uint16_t, std::shared_ptr<SlaveModel>> models;
+  std::map<uint16_t, SlaveProcessImage> images;
+  std::map<SdoKey, std::vector<uint8_t>> sdos;
+
+  /** slaves reached by the frame in flight, through the main and the backup device */
+  bool frame_in_flight = false;
+  std::vector<bool> reached_main;
+  std::vector<bool> reached_backup;
+  /** slaves reached by the last received frame */
+  std::vector<bool> responding;
+  unsigned int responding_main = 0;
+  unsigned int responding_backup = 0;
+
+  int slaveCount() const
+  {
+    if (slave_count >= 0) {
+      return slave_count;
+    }
+    int count = 0;
+    for (const auto & config : configs) {
+      count = std::max(count, config->position + 1);
+    }
+    return count;
+  }
+
+  bool sendOn(unsigned int device)
+  {
+    if (device == 1 && !backup) {
+      return false;
+    }
+    frames_sent[device]++;
+    if (!link_up[device] || drop[device] > 0) {
+      if (drop[device] > 0) {
+        drop[device]--;
+      }
+      frames_lost[device]++;
+      return false;
+    }
+    return true;
+  }
+
+  void send()
+  {
+    const int count = slaveCount();
+    const bool main_ok = sendOn(0);
+    const bool backup_ok = sendOn(1);
+    reached_main.assign(count, false);
+    reached_backup.assign(count, false);
+    for (int p = 0; p < count; p++) {
+      const bool before_break = ring_break < 0 || p <= ring_break;
+      reached_main[p] = main_ok && before_break;
+      // the backup device is connected to the last slave of the ring
+      reached_backup[p] = backup_ok && (ring_break < 0 || p > ring_break);
+    }
+    frame_app_time = app_time;
+    frame_in_flight = true;
+  }
+
+  void receive()
+  {
+    const int count = slaveCount();
+    responding.assign(count, false);
+    responding_main = 0;
+    responding_backup = 0;
+    bool redundancy_active = false;
+    if (frame_in_flight) {
+      for (int p = 0; p < count; p++) {
+        responding[p] = reached_main[p] || reached_backup[p];
+        responding_main += reached_main[p];
+        if (reached_backup[p] && !reached_main[p]) {
+          responding_backup++;
+          redundancy_active = true;
+        }
+      }
+    }
+    frame_in_flight = false;
+
+    // the first slave is the reference clock
+    ref_clock_valid = count > 0 && responding[0];
+    if (ref_clock_valid) {
+      ref_clock_time = static_cast<uint32_t>(frame_app_time + ref_clock_delay);
+    }
+
+    for (auto & image : images) {
+      if (image.first < count && responding[image.first] && models.count(image.first)) {
+        image.second.time_ = app_time;
+        models.at(image.first)->cycle(image.second);
+      }
+    }
+
+    for (auto & domain : domains) {
+      unsigned int wc = 0;
+      for (const auto & weight : domain->wc_weights) {
+        if (weight.first < count && responding[weight.first]) {
+          wc += weight.second;
+        }
+      }
+      domain->received.working_counter = wc;
+      domain->received.wc_state = (wc == 0) ? EC_WC_ZERO :
+        (wc == domain->expected_wc ? EC_WC_COMPLETE : EC_WC_INCOMPLETE);
+      domain->received.redundancy_active = redundancy_active && wc > 0;
+    }
+  }
+
+  ec_slave_config_t * findConfig(uint16_t alias, uint16_t position)
+  {
+    for (auto & config : configs) {
+      if (config->alias == alias && config->position == position) {
+        return config.get();
+      }
+    }
+    return NULL;
+  }
+
+  bool isResponding(uint16_t position) const
+  {
+    return position < responding.size() && responding[position];
+  }
+};
+
+namespace ethercat_interface
+{
+namespace sim
+{
+
+namespace
+{
+std::map<unsigned int, std::unique_ptr<SimMaster>> & masters()
+{
+  static std::map<unsigned int, std::unique_ptr<SimMaster>> sim_masters;
+  return sim_masters;
+}
+}  // namespace
+
+SimMaster::SimMaster(unsigned int index)
+: master_(new ec_master_t())
+{
+  master_->index = index;
+}
+
+SimMaster::~SimMaster() {}
+
+void SimMaster::setSlaveCount(int count) {master_->slave_count = count;}
+
+void SimMaster::setBackupDevice(bool enable) {master_->backup = enable;}
+
+void SimMaster::setLinkUp(unsigned int device, bool up)
+{
+  if (device <= BACKUP_DEVICE) {
+    master_->link_up[device] = up;
+  }
+}
+
+void SimMaster::breakRing(int position) {master_->ring_break = position;}
+
+void SimMaster::dropFrames(unsigned int device, uint64_t count)
+{
+  if (device <= BACKUP_DEVICE) {
+    master_->drop[device] = count;
+  }
+}
+
+void SimMaster::setReferenceClockDelay(uint32_t delay_ns) {master_->ref_clock_delay = delay_ns;}
+
+void SimMaster::setSlaveModel(uint16_t position, std::shared_ptr<SlaveModel> model)
+{
+  master_->models[position] = model;
+}
+
+DcConfig SimMaster::dcConfig(uint16_t position) const
+{
+  for (const auto & config : master_->configs) {
+    if (config->position == position) {
+      return config->dc;
+    }
+  }
+  return DcConfig();
+}
+
+std::vector<uint8_t> SimMaster::sdo(uint16_t position, uint16_t index, uint8_t subindex) const
+{
+  auto it = master_->sdos.find(SdoKey(position, index, subindex));
+  return it == master_->sdos.end() ? std::vector<uint8_t>() : it->second;
+}
+
+void SimMaster::setSdo(
+  uint16_t position, uint16_t index, uint8_t subindex,
+  const std::vector<uint8_t> & value)
+{
+  master_->sdos[SdoKey(position, index, subindex)] = value;
+}
+
+uint64_t SimMaster::sdoTransfers() const {return master_->sdo_transfers;}
+
+uint64_t SimMaster::framesSent(unsigned int device) const
+{
+  return device <= BACKUP_DEVICE ? master_->frames_sent[device] : 0;
+}
+
+uint64_t SimMaster::framesLost(unsigned int device) const
+{
+  return device <= BACKUP_DEVICE ? master_->frames_lost[device] : 0;
+}
+
+SimMaster & master(unsigned int index)
+{
+  auto & sim_masters = masters();
+  if (!sim_masters.count(index)) {
+    sim_masters[index] = std::make_unique<SimMaster>(index);
+  }
+  return *sim_masters.at(index);
+}
+
+void reset()
+{
+  masters().clear();
+}
+
+}  // namespace sim
+}  // namespace ethercat_interface
+
+// ecrt implementation
+
+ec_master_t * ecrt_request_master(unsigned int master_index)
+{
+  return ethercat_interface::sim::master(master_index).handle();
+}
+
+void ecrt_release_master(ec_master_t * /*master*/) {}
+
+ec_domain_t * ecrt_master_create_domain(ec_master_t * master)
+{
+  if (master->active) {
+    return NULL;
+  }
+  master->domains.push_back(std::make_unique<ec_domain_t>());
+  master->domains.back()->master = master;
+  return master->domains.back().get();
+}
+
+ec_slave_config_t * ecrt_master_slave_config(
+  ec_master_t * master, uint16_t alias, uint16_t position,
+  uint32_t vendor_id, uint32_t product_code)
+{
+  ec_slave_config_t * config = master->findConfig(alias, position);
+  if (config != NULL) {
+    if (config->vendor_id != vendor_id || config->product_code != product_code) {
+      return NULL;
+    }
+    return config;
+  }
+  master->configs.push_back(std::make_unique<ec_slave_config_t>());
+  config = master->configs.back().get();
+  config->master = master;
+  config->alias = alias;
+  config->position = position;
+  config->vendor_id = vendor_id;
+  config->product_code = product_code;
+  return config;
+}
+
+int ecrt_master_sdo_download(
+  ec_master_t * master, uint16_t slave_position, uint16_t index,
+  uint8_t subindex, uint8_t * data, size_t data_size, uint32_t * abort_code)
+{
+  master->sdo_transfers++;
+  if (static_cast<int>(slave_position) >= master->slaveCount()) {
+    return -EIO;
+  }
+  master->sdos[SdoKey(slave_position, index, subindex)].assign(data, data + data_size);
+  *abort_code = 0;
+  return 0;
+}
+
+int ecrt_master_sdo_upload(
+  ec_master_t * master, uint16_t slave_position, uint16_t index,
+  uint8_t subindex, uint8_t * target, size_t target_size, size_t * result_size,
+  uint32_t * abort_code)
+{
+  master->sdo_transfers++;
+  auto it = master->sdos.find(SdoKey(slave_position, index, subindex));
+  if (it == master->sdos.end()) {
+    *abort_code = 0x06020000;  // object does not exist
+    return -EIO;
+  }
+  *result_size = std::min(target_size, it->second.size());
+  memcpy(target, it->second.data(), *result_size);
+  *abort_code = 0;
+  return 0;
+}
+
+int ecrt_master_activate(ec_master_t * master)
+{
+  if (master->active) {
+    return -EBUSY;
+  }
+  for (auto & domain : master->domains) {
+    domain->data.assign(domain->size, 0);
+    domain->expected_wc = 0;
+    domain->wc_weights.clear();
+    for (const auto & entry : domain->entries) {
+      const uint16_t position = entry.config->position;
+      const bool output = entry.config->entry_dirs.at(entry.key) == EC_DIR_OUTPUT;
+      // outputs are written (+2) and inputs read (+1) once per slave and domain
+      unsigned int & weight = domain->wc_weights[position];
+      weight |= output ? 2 : 1;
+      master->images[position].entries_[entry.key] = domain->data.data() + entry.offset;
+    }
+    for (const auto & weight : domain->wc_weights) {
+      domain->expected_wc += weight.second;
+    }
+  }
+  master->active = true;
+  return 0;
+}
+
+void ecrt_master_deactivate(ec_master_t * master)
+{
+  master->active = false;
+}
+
+void ecrt_master_send(ec_master_t * master)
+{
+  if (master->active) {
+    master->send();
+  }
+}
+
+void ecrt_master_receive(ec_master_t * master)
+{
+  if (master->active) {
+    master->receive();
+  }
+}
+
+void ecrt_master_state(const ec_master_t * master, ec_master_state_t * state)
+{
+  unsigned int responding = 0;
+  for (const bool r : master->responding) {
+    responding += r;
+  }
+  state->slaves_responding = responding;
+  state->al_states = (master->active && responding > 0) ? 0x08 : 0x01;
+  state->link_up = master->link_up[0] || (master->backup && master->link_up[1]);
+}
+
+int ecrt_master_link_state(
+  const ec_master_t * master, unsigned int dev_idx,
+  ec_master_link_state_t * state)
+{
+  if (dev_idx > 1 || (dev_idx == 1 && !master->backup)) {
+    return -EINVAL;
+  }
+  state->slaves_responding = (dev_idx == 0) ? master->responding_main : master->responding_backup;
+  state->al_states = (master->active && state->slaves_responding > 0) ? 0x08 : 0x01;
+  state->link_up = master->link_up[dev_idx];
+  return 0;
+}
+
+void ecrt_master_application_time(ec_master_t * master, uint64_t app_time)
+{
+  master->app_time = app_time;
+}
+
+void ecrt_master_sync_reference_clock(ec_master_t * /*master*/) {}
+
+void ecrt_master_sync_slave_clocks(ec_master_t * /*master*/) {}
+
+int ecrt_master_reference_clock_time(ec_master_t * master, uint32_t * time)
+{
+  if (!master->ref_clock_valid) {
+    return -EIO;
+  }
+  *time = master->ref_clock_time;
+  return 0;
+}
+
+void ecrt_master_sync_monitor_queue(ec_master_t * /*master*/) {}
+
+uint32_t ecrt_master_sync_monitor_process(ec_master_t * /*master*/) {return 0;}
+
+int ecrt_slave_config_pdos(
+  ec_slave_config_t * sc, unsigned int n_syncs,
+  const ec_sync_info_t syncs[])
+{
+  for (unsigned int i = 0; i < n_syncs && syncs[i].index != 0xff; i++) {
+    for (unsigned int j = 0; j < syncs[i].n_pdos; j++) {
+      const ec_pdo_info_t & pdo = syncs[i].pdos[j];
+      for (unsigned int k = 0; k < pdo.n_entries; k++) {
+        const uint32_t key = entryKey(pdo.entries[k].index, pdo.entries[k].subindex);
+        sc->entry_bits[key] = pdo.entries[k].bit_length;
+        sc->entry_dirs[key] = syncs[i].dir;
+      }
+    }
+  }
+  return 0;
+}
+
+void ecrt_slave_config_dc(
+  ec_slave_config_t * sc, uint16_t assign_activate,
+  uint32_t sync0_cycle, int32_t sync0_shift,
+  uint32_t sync1_cycle, int32_t sync1_shift)
+{
+  sc->dc.assign_activate = assign_activate;
+  sc->dc.sync0_cycle = sync0_cycle;
+  sc->dc.sync0_shift = sync0_shift;
+  sc->dc.sync1_cycle = sync1_cycle;
+  sc->dc.sync1_shift = sync1_shift;
+}
+
+int ecrt_slave_config_sdo(
+  ec_slave_config_t * sc, uint16_t index, uint8_t subindex,
+  const uint8_t * data, size_t size)
+{
+  sc->master->sdos[SdoKey(sc->position, index, subindex)].assign(data, data + size);
+  return 0;
+}
+
+void ecrt_slave_config_state(const ec_slave_config_t * sc, ec_slave_config_state_t * state)
+{
+  const bool online = sc->master->isResponding(sc->position);
+  state->online = online;
+  state->operational = online && sc->master->active;
+  state->al_state = state->operational ? 0x08 : 0x01;
+}
+
+ec_sdo_request_t * ecrt_slave_config_create_sdo_request(
+  ec_slave_config_t * sc, uint16_t index, uint8_t subindex, size_t size)
+{
+  ec_master_t * master = sc->master;
+  master->sdo_requests.push_back(std::make_unique<ec_sdo_request_t>());
+  ec_sdo_request_t * req = master->sdo_requests.back().get();
+  req->config = sc;
+  req->index = index;
+  req->subindex = subindex;
+  req->data.assign(size, 0);
+  return req;
+}
+
+void ecrt_sdo_request_timeout(ec_sdo_request_t * /*req*/, uint32_t /*timeout*/) {}
+
+uint8_t * ecrt_sdo_request_data(ec_sdo_request_t * req) {return req->data.data();}
+
+size_t ecrt_sdo_request_data_size(const ec_sdo_request_t * req) {return req->data.size();}
+
+ec_request_state_t ecrt_sdo_request_state(ec_sdo_request_t * req) {return req->state;}
+
+void ecrt_sdo_request_write(ec_sdo_request_t * req)
+{
+  ec_master_t * master = req->config->master;
+  master->sdo_transfers++;
+  master->sdos[SdoKey(req->config->position, req->index, req->subindex)] = req->data;
+  req->state = EC_REQUEST_SUCCESS;
+}
+
+void ecrt_sdo_request_read(ec_sdo_request_t * req)
+{
+  ec_master_t * master = req->config->master;
+  master->sdo_transfers++;
+  auto it = master->sdos.find(SdoKey(req->config->position, req->index, req->subindex));
+  if (it == master->sdos.end()) {
+    req->state = EC_REQUEST_ERROR;
+    return;
+  }
+  std::copy_n(it->second.begin(), std::min(it->second.size(), req->data.size()), req->data.begin());
+  req->state = EC_REQUEST_SUCCESS;
+}
+
+int ecrt_domain_reg_pdo_entry_list(
+  ec_domain_t * domain,
+  const ec_pdo_entry_reg_t * pdo_entry_regs)
+{
+  for (const ec_pdo_entry_reg_t * reg = pdo_entry_regs; reg->index; reg++) {
+    ec_slave_config_t * config = domain->master->findConfig(reg->alias, reg->position);
+    if (config == NULL || config->vendor_id != reg->vendor_id ||
+      config->product_code != reg->product_code)
+    {
+      return -ENOENT;
+    }
+    const uint32_t key = entryKey(reg->index, reg->subindex);
+    if (!config->entry_bits.count(key)) {
+      return -ENOENT;
+    }
+    const size_t bytes = std::max<size_t>(1, (config->entry_bits.at(key) + 7) / 8);
+    domain->entries.push_back({config, key, domain->size});
+    if (reg->offset != NULL) {
+      *reg->offset = domain->size;
+    }
+    if (reg->bit_position != NULL) {
+      *reg->bit_position = 0;
+    }
+    domain->size += bytes;
+  }
+  return 0;
+}
+
+size_t ecrt_domain_size(const ec_domain_t * domain) {return domain->size;}
+
+uint8_t * ecrt_domain_data(ec_domain_t * domain)
+{
+  return domain->master->active ? domain->data.data() : NULL;
+}
+
+void ecrt_domain_process(ec_domain_t * domain)
+{
+  domain->state = domain->received;
+}
+
+void ecrt_domain_queue(ec_domain_t * /*domain*/) {}
+
+void ecrt_domain_state(const ec_domain_t * domain, ec_domain_state_t * state)
+{
+  *state = domain->state;
+}
@@ -0,0 +1,177 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ethercat_interface/ec_sim_cia402_drive.hpp"
+
+#include <cmath>
+
+namespace ethercat_interface
+{
+namespace sim
+{
+
+CiA402DriveModel::CiA402DriveModel(const CiA402DriveConfig & config)
+: config_(config),
+  delay_line_(config.response_delay_cycles + 1)
+{}
+
+uint16_t CiA402DriveModel::statusWord() const
+{
+  switch (state_) {
+    case State::SWITCH_ON_DISABLED:
+      return 0x0040;
+    case State::READY_TO_SWITCH_ON:
+      return 0x0021;
+    case State::SWITCHED_ON:
+      return 0x0023;
+    case State::OPERATION_ENABLED:
+      return 0x0027;
+    case State::QUICK_STOP_ACTIVE:
+      return 0x0007;
+    case State::FAULT:
+      return 0x0008;
+  }
+  return 0x0000;
+}
+
+void CiA402DriveModel::cycle(SlaveProcessImage & image)
+{
+  double dt = config_.cycle_time;
+  if (last_time_ != 0 && image.time() > last_time_) {
+    dt = (image.time() - last_time_) * 1e-9;
+  }
+  last_time_ = image.time();
+
+  if (uint8_t * control_word = image.entry(0x6040, 0x00)) {
+    transition(EC_READ_U16(control_word));
+  } else if (fault_) {
+    state_ = State::FAULT;
+  }
+
+  // latest targets, the objects that are not mapped keep their value
+  if (uint8_t * mode = image.entry(0x6060, 0x00)) {
+    latest_.mode = EC_READ_S8(mode);
+  }
+  if (uint8_t * position = image.entry(0x607a, 0x00)) {
+    latest_.position = EC_READ_S32(position);
+  }
+  if (uint8_t * velocity = image.entry(0x60ff, 0x00)) {
+    latest_.velocity = EC_READ_S32(velocity);
+  }
+  if (uint8_t * torque = image.entry(0x6071, 0x00)) {
+    latest_.torque = EC_READ_S16(torque);
+  }
+  // they reach the drive after the response delay
+  delay_line_[delay_index_] = latest_;
+  delay_index_ = (delay_index_ + 1) % delay_line_.size();
+  const Targets & targets = delay_line_[delay_index_];
+
+  mode_display_ = targets.mode;
+  follow(targets, dt);
+
+  if (uint8_t * status_word = image.entry(0x6041, 0x00)) {
+    EC_WRITE_U16(status_word, statusWord());
+  }
+  if (uint8_t * mode_display = image.entry(0x6061, 0x00)) {
+    EC_WRITE_S8(mode_display, mode_display_);
+  }
+  if (uint8_t * position = image.entry(0x6064, 0x00)) {
+    EC_WRITE_S32(position, static_cast<int32_t>(std::lround(position_)));
+  }
+  if (uint8_t * velocity = image.entry(0x606c, 0x00)) {
+    EC_WRITE_S32(velocity, static_cast<int32_t>(std::lround(velocity_)));
+  }
+  if (uint8_t * torque = image.entry(0x6077, 0x00)) {
+    EC_WRITE_S16(torque, static_cast<int16_t>(std::lround(torque_)));
+  }
+}
+
+void CiA402DriveModel::transition(uint16_t control_word)
+{
+  const bool fault_reset = (control_word & 0x80) && !(last_control_word_ & 0x80);
+  last_control_word_ = control_word;
+
+  if (fault_) {
+    state_ = State::FAULT;
+    fault_ = false;
+    return;
+  }
+  if (state_ == State::FAULT) {
+    if (fault_reset) {
+      state_ = State::SWITCH_ON_DISABLED;
+    }
+    return;
+  }
+
+  if ((control_word & 0x0002) == 0x0000) {
+    // disable voltage
+    state_ = State::SWITCH_ON_DISABLED;
+  } else if ((control_word & 0x0006) == 0x0002) {
+    // quick stop
+    state_ = state_ == State::OPERATION_ENABLED || state_ == State::QUICK_STOP_ACTIVE ?
+      State::QUICK_STOP_ACTIVE : State::SWITCH_ON_DISABLED;
+  } else if ((control_word & 0x0087) == 0x0006) {
+    // shutdown
+    state_ = State::READY_TO_SWITCH_ON;
+  } else if ((control_word & 0x008f) == 0x0007) {
+    // switch on, or disable operation
+    if (state_ == State::READY_TO_SWITCH_ON || state_ == State::OPERATION_ENABLED) {
+      state_ = State::SWITCHED_ON;
+    }
+  } else if ((control_word & 0x008f) == 0x000f) {
+    // enable operation
+    if (state_ == State::SWITCHED_ON || state_ == State::QUICK_STOP_ACTIVE) {
+      state_ = State::OPERATION_ENABLED;
+    } else if (state_ == State::READY_TO_SWITCH_ON) {
+      state_ = State::SWITCHED_ON;
+    }
+  }
+}
+
+void CiA402DriveModel::follow(const Targets & targets, double dt)
+{
+  const double alpha =
+    config_.time_constant > 0 ? 1.0 - std::exp(-dt / config_.time_constant) : 1.0;
+
+  if (state_ == State::OPERATION_ENABLED) {
+    if (targets.mode == 8) {
+      const double position = position_ + alpha * (targets.position - position_);
+      velocity_ = (position - position_) / dt;
+      position_ = position;
+      torque_ = 0;
+      return;
+    } else if (targets.mode == 9) {
+      velocity_ += alpha * (targets.velocity - velocity_);
+      position_ += velocity_ * dt;
+      torque_ = 0;
+      return;
+    } else if (targets.mode == 10) {
+      torque_ += alpha * (targets.torque - torque_);
+      velocity_ += config_.torque_gain * torque_ * dt;
+      position_ += velocity_ * dt;
+      return;
+    }
+  }
+  torque_ = 0;
+  if (state_ == State::OPERATION_ENABLED || state_ == State::QUICK_STOP_ACTIVE) {
+    // stop with the drive dynamics
+    velocity_ -= alpha * velocity_;
+    position_ += velocity_ * dt;
+  } else {
+    velocity_ = 0;
+  }
+}
+
+}  // namespace sim
+}  // namespace ethercat_interface
@@ -0,0 +1,88 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include "ethercat_interface/ec_axis_coupling.hpp"
+
+TEST(TestAxisCoupling, EvaluatesCamTables)
+{
+  ethercat_interface::CamTable cam;
+  cam.leader = {0, 1, 2};
+  cam.follower = {0, 2, 3};
+  ASSERT_TRUE(cam.valid());
+  ASSERT_DOUBLE_EQ(cam.evaluate(0.5), 1.0);
+  ASSERT_DOUBLE_EQ(cam.evaluate(1.5), 2.5);
+  // clamped to the ends
+  ASSERT_DOUBLE_EQ(cam.evaluate(-1), 0.0);
+  ASSERT_DOUBLE_EQ(cam.evaluate(5), 3.0);
+
+  // repeated and shifted by the follower range
+  cam.periodic = true;
+  ASSERT_DOUBLE_EQ(cam.evaluate(2.5), 4.0);
+  ASSERT_DOUBLE_EQ(cam.evaluate(-0.5), -0.5);
+
+  cam.leader = {0, 1, 1};
+  ASSERT_FALSE(cam.valid());
+  cam.leader = {0, 1};
+  ASSERT_FALSE(cam.valid());
+}
+
+TEST(TestAxisCoupling, RampsGearing)
+{
+  ethercat_interface::AxisCoupling coupling;
+  coupling.setRatio(2.0);
+  coupling.setRamps(0.002, 0.001);
+  double target = 0;
+  ASSERT_FALSE(coupling.update(0.001, false, 10, 5, target));
+
+  // starts at the follower position, the increments are ramped in
+  ASSERT_TRUE(coupling.update(0.001, true, 10, 5, target));
+  ASSERT_DOUBLE_EQ(target, 5.0);
+  ASSERT_EQ(coupling.state(), ethercat_interface::AxisCoupling::ENGAGING);
+  ASSERT_TRUE(coupling.update(0.001, true, 11, 5, target));
+  ASSERT_DOUBLE_EQ(target, 7.0);
+  ASSERT_EQ(coupling.state(), ethercat_interface::AxisCoupling::ENGAGED);
+  ASSERT_TRUE(coupling.update(0.001, true, 12, 7, target));
+  ASSERT_DOUBLE_EQ(target, 9.0);
+
+  // a lost leader position holds the follower
+  ASSERT_TRUE(coupling.update(0.001, true, std::nan(""), 9, target));
+  ASSERT_DOUBLE_EQ(target, 9.0);
+
+  // the last target is sent once disengaged
+  ASSERT_TRUE(coupling.update(0.001, false, 13, 9, target));
+  ASSERT_DOUBLE_EQ(target, 9.0);
+  ASSERT_EQ(coupling.state(), ethercat_interface::AxisCoupling::DISENGAGED);
+  ASSERT_FALSE(coupling.update(0.001, false, 14, 9, target));
+}
+
+TEST(TestAxisCoupling, FollowsCamTable)
+{
+  ethercat_interface::AxisCoupling coupling;
+  ethercat_interface::CamTable cam;
+  ASSERT_FALSE(coupling.loadCamTable(cam));
+  cam.leader = {0, 5, 10};
+  cam.follower = {0, 1, 0};
+  cam.periodic = true;
+  ASSERT_TRUE(coupling.loadCamTable(cam));
+
+  double target = 0;
+  coupling.update(0.001, true, 9, 100, target);
+  ASSERT_DOUBLE_EQ(target, 100.0);
+  // across the period boundary
+  coupling.update(0.001, true, 12.5, 100, target);
+  ASSERT_DOUBLE_EQ(target, 100.0 + 0.5 - 0.2);
+}
@@ -0,0 +1,76 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+#include "ethercat_interface/ec_command_schedule.hpp"
+
+TEST(TestCommandSchedule, AppliesBatchesWhenDue)
+{
+  ethercat_interface::CommandSchedule schedule;
+  schedule.configure(2, 4);
+  std::vector<double> batch = {1, 2};
+  ASSERT_TRUE(schedule.push(12, batch.data()));
+  batch = {3, 4};
+  ASSERT_TRUE(schedule.push(10, batch.data()));
+  ASSERT_EQ(schedule.pending(), 2u);
+
+  std::vector<double> values = {0, 0};
+  ASSERT_EQ(schedule.apply(9, values.data()), 0u);
+  ASSERT_EQ(values, std::vector<double>({0, 0}));
+  ASSERT_EQ(schedule.apply(10, values.data()), 1u);
+  ASSERT_EQ(values, std::vector<double>({3, 4}));
+  ASSERT_EQ(schedule.apply(11, values.data()), 0u);
+  // a late apply catches up with all the batches due
+  ASSERT_EQ(schedule.apply(20, values.data()), 1u);
+  ASSERT_EQ(values, std::vector<double>({1, 2}));
+  ASSERT_EQ(schedule.pending(), 0u);
+}
+
+TEST(TestCommandSchedule, MergesBatchesInOrder)
+{
+  ethercat_interface::CommandSchedule schedule;
+  schedule.configure(3, 4);
+  std::vector<double> batch = {1, 1, 1};
+  schedule.push(5, batch.data());
+  batch = {2, std::nan(""), std::nan("")};
+  schedule.push(5, batch.data());
+  batch = {std::nan(""), 3, std::nan("")};
+  schedule.push(4, batch.data());
+
+  std::vector<double> values = {0, 0, 0};
+  ASSERT_EQ(schedule.apply(5, values.data()), 3u);
+  // same key in push order, NaN keeps the previous value
+  ASSERT_EQ(values, std::vector<double>({2, 1, 1}));
+}
+
+TEST(TestCommandSchedule, RejectsBatchesWhenFull)
+{
+  ethercat_interface::CommandSchedule schedule;
+  schedule.configure(1, 2);
+  std::vector<double> batch = {1};
+  ASSERT_TRUE(schedule.push(1, batch.data()));
+  ASSERT_TRUE(schedule.push(2, batch.data()));
+  ASSERT_FALSE(schedule.push(3, batch.data()));
+
+  double value = 0;
+  ASSERT_EQ(schedule.apply(1, &value), 1u);
+  ASSERT_TRUE(schedule.push(3, batch.data()));
+  schedule.clear();
+  ASSERT_EQ(schedule.pending(), 0u);
+  ASSERT_TRUE(schedule.push(4, batch.data()));
+  ASSERT_TRUE(schedule.push(5, batch.data()));
+}
@@ -0,0 +1,80 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <map>
+#include <string>
+
+#include "ethercat_interface/ec_expression.hpp"
+
+class ExpressionProgramTest : public ::testing::Test
+{
+public:
+  ExpressionProgramTest()
+  {
+    resolve_ = [this](const std::string & name) -> const double * {
+        auto it = values_.find(name);
+        return it != values_.end() ? &it->second : NULL;
+      };
+  }
+
+  double evaluate(const std::string & expression)
+  {
+    std::string error;
+    const int index = program_.compile(expression, resolve_, error);
+    EXPECT_GE(index, 0) << expression << ": " << error;
+    return index >= 0 ? program_.evaluate(index) : std::nan("");
+  }
+
+protected:
+  std::map<std::string, double> values_ = {
+    {"hi", 2}, {"lo", 3}, {"inlet_pressure", 5.5}, {"outlet_pressure", 1.5}, {"io/ai.1", 4}};
+  ethercat_interface::ExpressionProgram program_;
+  ethercat_interface::ExpressionProgram::Resolver resolve_;
+};
+
+TEST_F(ExpressionProgramTest, EvaluatesArithmetic)
+{
+  ASSERT_EQ(evaluate("hi * 65536 + lo"), 131075);
+  ASSERT_EQ(evaluate("inlet_pressure - outlet_pressure"), 4);
+  // left associative, * and / before + and -
+  ASSERT_EQ(evaluate("10 - 4 - 3"), 3);
+  ASSERT_EQ(evaluate("lo + hi * lo / 4"), 4.5);
+  ASSERT_EQ(evaluate("(lo + hi) * -(lo - 1)"), -10);
+  ASSERT_EQ(evaluate("-hi - -lo"), 1);
+  // a division by a name needs spaces, a slash followed by a letter is part of the name
+  ASSERT_EQ(evaluate("io/ai.1 / hi"), 2);
+  ASSERT_EQ(evaluate("io/ai.1/2"), 2);
+  // arithmetic before comparisons before booleans
+  ASSERT_EQ(evaluate("hi + 1 == lo && !(lo < .5)"), 1);
+  ASSERT_TRUE(std::isinf(evaluate("hi / 0")));
+  ASSERT_EQ(program_.size(), 10u);
+
+  // the compiled expressions follow the values
+  values_["lo"] = 4;
+  ASSERT_EQ(program_.evaluate(0), 131076);
+}
+
+TEST_F(ExpressionProgramTest, RejectsInvalidExpressions)
+{
+  std::string error;
+  for (const std::string expression :
+    {"", "hi +", "(hi", "hi)", "mid", "hi lo", "* lo", "hi ** lo", "hi % lo", "hi = lo"})
+  {
+    ASSERT_LT(program_.compile(expression, resolve_, error), 0) << expression;
+  }
+  ASSERT_EQ(program_.size(), 0u);
+  ASSERT_EQ(program_.instructions(), 0u);
+}
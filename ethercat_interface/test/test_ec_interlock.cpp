@@ -0,0 +1,114 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <map>
+#include <string>
+
+#include "ethercat_interface/ec_interlock.hpp"
+
+class InterlockEngineTest : public ::testing::Test
+{
+public:
+  InterlockEngineTest()
+  {
+    resolve_ = [this](const std::string & name) -> double * {
+        auto it = values_.find(name);
+        return it != values_.end() ? &it->second : NULL;
+      };
+  }
+
+  /** condition of a single rule on the values */
+  bool condition(const std::string & expression)
+  {
+    ethercat_interface::InterlockEngine engine;
+    double output = 0;
+    std::string error;
+    EXPECT_TRUE(engine.addRule(expression, &output, 1, 0, resolve_, error)) << error;
+    engine.apply();
+    return output == 1;
+  }
+
+protected:
+  std::map<std::string, double> values_ = {
+    {"door/closed", 1}, {"estop/ok", 1}, {"io/analog.1", 2.5}, {"io/missing", std::nan("")}};
+  ethercat_interface::InterlockEngine::Resolver resolve_;
+};
+
+TEST_F(InterlockEngineTest, EvaluatesConditions)
+{
+  ASSERT_FALSE(condition("door/closed == 0 || estop/ok < 1"));
+  values_["door/closed"] = 0;
+  ASSERT_TRUE(condition("door/closed == 0 || estop/ok < 1"));
+  // comparisons before && before ||
+  ASSERT_TRUE(condition("io/analog.1 > 2 && io/analog.1 <= 2.5 || false"));
+  ASSERT_FALSE(condition("io/analog.1 > 2 && (io/analog.1 > 3 || false)"));
+  ASSERT_TRUE(condition("!door/closed && !(estop/ok != 1)"));
+  ASSERT_TRUE(condition("!!estop/ok && io/analog.1 >= -1"));
+  // a missing value is false, its negation true
+  ASSERT_FALSE(condition("io/missing"));
+  ASSERT_TRUE(condition("!io/missing"));
+  ASSERT_FALSE(condition("io/missing >= 0"));
+}
+
+TEST_F(InterlockEngineTest, RejectsInvalidConditions)
+{
+  ethercat_interface::InterlockEngine engine;
+  double output = 0;
+  std::string error;
+  for (const std::string expression :
+    {"", "door/closed ==", "(door/closed", "door/closed)", "door/opened", "door/closed = 1",
+      "door/closed estop/ok", "&& estop/ok"})
+  {
+    ASSERT_FALSE(engine.addRule(expression, &output, 1, 0, resolve_, error)) << expression;
+  }
+  ASSERT_EQ(engine.size(), 0u);
+  ASSERT_EQ(engine.instructions(), 0u);
+}
+
+TEST_F(InterlockEngineTest, ForcesAndRestoresOutputs)
+{
+  double enable = 1;
+  double brake = 7;
+  values_["drive/enable"] = 0;
+  ethercat_interface::InterlockEngine engine;
+  std::string error;
+  ASSERT_TRUE(
+    engine.load(
+      YAML::Load(
+        "[{when: 'door/closed == 0', output: enable, value: 0},"
+        " {when: 'estop/ok', output: brake, value: 0, otherwise: 1}]"),
+      resolve_,
+      [&](const std::string & name) {return name == "enable" ? &enable : &brake;},
+      error)) << error;
+  ASSERT_EQ(engine.size(), 2u);
+
+  // passed through while the condition is false, unless otherwise is set
+  ASSERT_EQ(engine.apply(), 1u);
+  ASSERT_EQ(enable, 1);
+  ASSERT_EQ(brake, 0);
+  engine.restore();
+  ASSERT_EQ(brake, 7);
+
+  values_["door/closed"] = 0;
+  values_["estop/ok"] = 0;
+  ASSERT_EQ(engine.apply(), 1u);
+  ASSERT_TRUE(engine.active(0));
+  ASSERT_EQ(enable, 0);
+  ASSERT_EQ(brake, 1);
+  engine.restore();
+  ASSERT_EQ(enable, 1);
+  ASSERT_EQ(brake, 7);
+}
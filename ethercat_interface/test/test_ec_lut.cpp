@@ -0,0 +1,65 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+#include "ethercat_interface/ec_lut.hpp"
+
+TEST(TestLookupTable, InterpolatesAndClamps)
+{
+  ethercat_interface::LookupTable table;
+  ASSERT_TRUE(table.load(YAML::Load("{input: [0, 1, 3], output: [10, 20, 0]}")));
+  ASSERT_EQ(table.evaluate(-1), 10);
+  ASSERT_EQ(table.evaluate(0.5), 15);
+  ASSERT_EQ(table.evaluate(2), 10);
+  ASSERT_EQ(table.evaluate(4), 0);
+
+  ASSERT_FALSE(table.load(YAML::Load("{input: [0], output: [10]}")));
+  ASSERT_FALSE(table.load(YAML::Load("{input: [0, 0], output: [10, 20]}")));
+  ASSERT_FALSE(table.load(YAML::Load("{input: [0, 1], output: [10]}")));
+  ASSERT_FALSE(table.load(YAML::Load("/no/such/table.yaml")));
+}
+
+TEST(TestLookupTable, BatchMatchesTables)
+{
+  std::vector<ethercat_interface::LookupTable> tables(3);
+  tables[0].input = {0, 1, 3};
+  tables[0].output = {10, 20, 0};
+  tables[1].input = {-5, 5};
+  tables[1].output = {5, -5};
+  // a type K thermocouple, mV to degC
+  tables[2].input = {-5.891, 0, 4.096, 8.138, 12.209, 16.397, 20.644, 24.905, 29.129, 33.275};
+  tables[2].output = {-200, 0, 100, 200, 300, 400, 500, 600, 700, 800};
+  ethercat_interface::LookupTableBatch batch;
+  for (const auto & table : tables) {
+    batch.add(table);
+  }
+  ASSERT_EQ(batch.size(), 3u);
+
+  for (double value = -8; value <= 36; value += 0.25) {
+    for (auto c = 0ul; c < tables.size(); c++) {
+      batch.inputs()[c] = value + c;
+    }
+    batch.evaluate();
+    for (auto c = 0ul; c < tables.size(); c++) {
+      ASSERT_NEAR(batch.outputs()[c], tables[c].evaluate(value + c), 1e-9) << value + c;
+    }
+  }
+
+  batch.inputs()[1] = std::nan("");
+  batch.evaluate();
+  ASSERT_TRUE(std::isnan(batch.outputs()[1]));
+}
@@ -0,0 +1,571 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ethercat_interface/ec_master.hpp"
+#include "ethercat_interface/ec_sim_backend.hpp"
+
+namespace
+{
+/** slave with one output and one input word */
+class TestSlave : public ethercat_interface::EcSlave
+{
+public:
+  TestSlave()
+  : EcSlave(0x00000001, 0x00000002) {}
+
+  void processData(size_t index, uint8_t * domain_address) override
+  {
+    if (index == 0) {
+      EC_WRITE_U16(domain_address, output);
+    } else {
+      input = EC_READ_U16(domain_address);
+    }
+  }
+  void newCycle(uint32_t /*domain*/) override {new_cycles++;}
+  void cycleBegin(uint32_t /*domain*/) override {cycle_begins++;}
+  void cycleEnd(uint32_t /*domain*/) override {cycle_ends++;}
+  const ec_sync_info_t * syncs() override {return syncs_;}
+  size_t syncSize() override {return 3;}
+  int assign_activate_dc_sync() override {return assign_activate;}
+  ethercat_interface::DcSyncConfig dc_sync_config() const override {return dc;}
+  const ec_pdo_entry_info_t * channels() override {return channels_;}
+  void domains(DomainMap & domains) const override {domains = {{0, {0, 1}}};}
+
+  uint16_t output = 0;
+  uint16_t input = 0;
+  int assign_activate = 0;
+  ethercat_interface::DcSyncConfig dc;
+  int new_cycles = 0;
+  int cycle_begins = 0;
+  int cycle_ends = 0;
+
+private:
+  ec_pdo_entry_info_t channels_[2] = {{0x7000, 0x01, 16}, {0x6000, 0x01, 16}};
+  ec_pdo_info_t pdos_[2] = {{0x1600, 1, channels_}, {0x1a00, 1, channels_ + 1}};
+  ec_sync_info_t syncs_[3] = {
+    {2, EC_DIR_OUTPUT, 1, pdos_, EC_WD_DEFAULT},
+    {3, EC_DIR_INPUT, 1, pdos_ + 1, EC_WD_DEFAULT},
+    {0xff, EC_DIR_INVALID, 0, NULL, EC_WD_DEFAULT}
+  };
+};
+
+/** slave summing its input word over the cycles between two resetStateAggregation(),
+ *  with a TPDO channel as the generic slaves */
+class AggregatingSlave : public TestSlave
+{
+public:
+  AggregatingSlave()
+  {
+    channel.pdo_type = ethercat_interface::TPDO;
+    channel.data_type = "uint16";
+    channel.aggregation = ethercat_interface::Aggregation::SUM;
+    channel.interface_index = 0;
+    channel.setup_interface_ptrs(&states, NULL);
+  }
+
+  void processData(size_t index, uint8_t * domain_address) override
+  {
+    if (index == 0) {
+      EC_WRITE_U16(domain_address, output);
+    } else {
+      channel.ec_update(domain_address, read_inputs);
+    }
+  }
+  void newCycle(uint32_t /*domain*/) override {read_inputs = true;}
+  void writePass(uint32_t /*domain*/) override {read_inputs = false;}
+  void resetStateAggregation() override {channel.reset_aggregation();}
+
+  ethercat_interface::EcPdoChannelManager channel;
+  std::vector<double> states = {0};
+  bool read_inputs = true;
+};
+
+/** simulated slave returning its output word as input */
+class LoopbackModel : public ethercat_interface::sim::SlaveModel
+{
+public:
+  void cycle(ethercat_interface::sim::SlaveProcessImage & image) override
+  {
+    EC_WRITE_U16(image.entry(0x6000, 0x01), EC_READ_U16(image.entry(0x7000, 0x01)));
+  }
+};
+}  // namespace
+
+class EcMasterTest : public ::testing::Test
+{
+public:
+  void SetUp() override
+  {
+    ethercat_interface::sim::reset();
+    sim_ = &ethercat_interface::sim::master(0);
+  }
+
+  void TearDown() override
+  {
+    master_.reset();
+    ethercat_interface::sim::reset();
+  }
+
+  void activate(size_t num_slaves, const std::vector<ethercat_interface::PdoRoute> & routes = {})
+  {
+    master_ = std::make_unique<ethercat_interface::EcMaster>(0);
+    for (size_t i = 0; i < num_slaves; i++) {
+      slaves_.push_back(std::make_unique<TestSlave>());
+      sim_->setSlaveModel(i, std::make_shared<LoopbackModel>());
+      master_->addSlave(0, i, slaves_.back().get());
+    }
+    for (const auto & route : routes) {
+      master_->addRoute(route);
+    }
+    ASSERT_TRUE(master_->activate());
+  }
+
+  void cycle(size_t num_cycles = 1)
+  {
+    for (size_t i = 0; i < num_cycles; i++) {
+      master_->update();
+    }
+  }
+
+protected:
+  ethercat_interface::sim::SimMaster * sim_;
+  std::unique_ptr<ethercat_interface::EcMaster> master_;
+  std::vector<std::unique_ptr<TestSlave>> slaves_;
+};
+
+TEST_F(EcMasterTest, ExchangesProcessData)
+{
+  activate(2);
+  slaves_[0]->output = 12;
+  slaves_[1]->output = 34;
+  cycle(2);
+
+  ASSERT_EQ(slaves_[0]->input, 12);
+  ASSERT_EQ(slaves_[1]->input, 34);
+  auto stats = master_->getStatistics();
+  ASSERT_EQ(stats.cycles, 2u);
+  ASSERT_FALSE(stats.backup_device);
+  ASSERT_TRUE(stats.links[0].link_up);
+  ASSERT_EQ(stats.domains.at(0).working_counter, 6u);
+  ASSERT_FALSE(stats.ring_broken);
+}
+
+TEST_F(EcMasterTest, CallsCycleHooksOncePerSlave)
+{
+  activate(2);
+  cycle(3);
+  ASSERT_EQ(slaves_[0]->new_cycles, 3);
+  ASSERT_EQ(slaves_[0]->cycle_begins, 3);
+  ASSERT_EQ(slaves_[0]->cycle_ends, 3);
+  ASSERT_EQ(slaves_[1]->cycle_ends, 3);
+
+  // the split cycle is one bus cycle, its hooks run in the pass of readData()
+  master_->readData();
+  ASSERT_EQ(slaves_[1]->new_cycles, 4);
+  ASSERT_EQ(slaves_[1]->cycle_begins, 4);
+  ASSERT_EQ(slaves_[1]->cycle_ends, 4);
+  master_->writeData();
+  ASSERT_EQ(slaves_[1]->new_cycles, 4);
+  ASSERT_EQ(slaves_[1]->cycle_begins, 4);
+  ASSERT_EQ(slaves_[1]->cycle_ends, 4);
+}
+
+TEST_F(EcMasterTest, AggregatesInputsOncePerSplitCycle)
+{
+  master_ = std::make_unique<ethercat_interface::EcMaster>(0);
+  auto slave = std::make_unique<AggregatingSlave>();
+  AggregatingSlave * aggregating = slave.get();
+  slaves_.push_back(std::move(slave));
+  sim_->setSlaveModel(0, std::make_shared<LoopbackModel>());
+  master_->addSlave(0, 0, aggregating);
+  ASSERT_TRUE(master_->activate());
+  aggregating->output = 1;
+  cycle(2);
+
+  // default read()/write() path: one sample per window, handed over after readData()
+  aggregating->resetStateAggregation();
+  for (int i = 0; i < 3; i++) {
+    master_->readData();
+    ASSERT_EQ(aggregating->states[0], 1);
+    aggregating->resetStateAggregation();
+    master_->writeData();
+  }
+
+  // bus thread with couplings or interlocks: one sample per bus cycle
+  aggregating->resetStateAggregation();
+  for (int i = 0; i < 3; i++) {
+    master_->readData();
+    master_->writeData();
+  }
+  ASSERT_EQ(aggregating->states[0], 3);
+}
+
+TEST_F(EcMasterTest, RoutesEntriesBetweenSlaves)
+{
+  ethercat_interface::PdoRoute route;
+  ASSERT_TRUE(
+    route.load(
+      YAML::Load(
+        "{from: {position: 0, index: 0x6000, sub_index: 1, type: uint16},"
+        " to: {position: 1, index: 0x7000, sub_index: 1}, scale: 2}")));
+  ASSERT_FALSE(route.isCopy());
+  activate(2, {route});
+  slaves_[0]->output = 21;
+  slaves_[1]->output = 1;
+  // looped back by slave 0 in the second cycle, routed to slave 1 in the same cycle
+  cycle(3);
+  ASSERT_EQ(slaves_[1]->input, 42);
+
+  // split cycle, the route is applied before sending
+  slaves_[0]->output = 5;
+  cycle(1);
+  master_->readData();
+  master_->writeData();
+  cycle(1);
+  ASSERT_EQ(slaves_[1]->input, 10);
+}
+
+TEST_F(EcMasterTest, RoutesSaturateOutOfRangeValues)
+{
+  ethercat_interface::PdoRoute route;
+  ASSERT_TRUE(
+    route.load(
+      YAML::Load(
+        "{from: {position: 0, index: 0x6000, sub_index: 1, type: uint16},"
+        " to: {position: 1, index: 0x7000, sub_index: 1, type: int16}, offset: -100}")));
+  activate(2, {route});
+  slaves_[1]->output = 1;
+  // 40000 - 100 does not fit in an int16
+  slaves_[0]->output = 40000;
+  cycle(3);
+  ASSERT_EQ(slaves_[1]->input, 32767);
+  // 50 - 100 is in the range of an int16
+  slaves_[0]->output = 50;
+  cycle(3);
+  ASSERT_EQ(static_cast<int16_t>(slaves_[1]->input), -50);
+
+  using ethercat_interface::PdoRoute;
+  uint8_t data[8];
+  PdoRoute::write(PdoRoute::UINT16, data, -5);
+  ASSERT_EQ(EC_READ_U16(data), 0);
+  PdoRoute::write(PdoRoute::INT8, data, -1000);
+  ASSERT_EQ(EC_READ_S8(data), -128);
+  PdoRoute::write(PdoRoute::UINT32, data, std::nan(""));
+  ASSERT_EQ(EC_READ_U32(data), 0u);
+  PdoRoute::write(PdoRoute::INT64, data, 1e30);
+  ASSERT_EQ(EC_READ_S64(data), INT64_MAX);
+  PdoRoute::write(PdoRoute::UINT64, data, 1e30);
+  ASSERT_EQ(EC_READ_U64(data), UINT64_MAX);
+  PdoRoute::write(PdoRoute::INT32, data, -123456.7);
+  ASSERT_EQ(EC_READ_S32(data), -123456);
+}
+
+TEST_F(EcMasterTest, RejectsRoutesToUnknownEntries)
+{
+  ethercat_interface::PdoRoute route;
+  route.source_position = 0;
+  route.source_index = 0x6000;
+  route.source_sub_index = 1;
+  route.source_type = ethercat_interface::PdoRoute::UINT16;
+  route.destination_position = 3;
+  route.destination_index = 0x7000;
+  route.destination_sub_index = 1;
+  route.destination_type = ethercat_interface::PdoRoute::UINT16;
+  ASSERT_TRUE(route.isCopy());
+  master_ = std::make_unique<ethercat_interface::EcMaster>(0);
+  slaves_.push_back(std::make_unique<TestSlave>());
+  master_->addSlave(0, 0, slaves_.back().get());
+  master_->addRoute(route);
+  ASSERT_FALSE(master_->activate());
+
+  ASSERT_FALSE(route.load(YAML::Load("{from: {position: 0, index: 1, type: float}, to: {}}")));
+}
+
+TEST_F(EcMasterTest, CountsLostFramesWithoutBackup)
+{
+  activate(2);
+  cycle(10);
+  const auto before = master_->getStatistics().domains.at(0).wc_zero_cycles;
+
+  sim_->dropFrames(ethercat_interface::sim::SimMaster::MAIN_DEVICE, 3);
+  cycle(10);
+
+  auto stats = master_->getStatistics();
+  ASSERT_EQ(stats.domains.at(0).wc_zero_cycles - before, 3u);
+  ASSERT_EQ(stats.domains.at(0).redundancy_active_cycles, 0u);
+  ASSERT_FALSE(stats.ring_broken);
+}
+
+TEST_F(EcMasterTest, DetectsBackupDevice)
+{
+  sim_->setBackupDevice(true);
+  activate(2);
+  cycle(20);
+
+  auto stats = master_->getStatistics();
+  ASSERT_TRUE(stats.backup_device);
+  ASSERT_TRUE(stats.links[0].link_up);
+  ASSERT_TRUE(stats.links[1].link_up);
+  ASSERT_EQ(stats.links[0].slaves_responding, 2u);
+  ASSERT_EQ(stats.links[1].slaves_responding, 0u);
+  ASSERT_FALSE(stats.ring_broken);
+}
+
+TEST_F(EcMasterTest, ContinuesThroughBrokenRing)
+{
+  sim_->setBackupDevice(true);
+  activate(3);
+  cycle(10);
+
+  // cable broken between the first and the second slave
+  sim_->breakRing(0);
+  slaves_[2]->output = 56;
+  cycle(20);
+
+  auto stats = master_->getStatistics();
+  ASSERT_EQ(slaves_[2]->input, 56);
+  ASSERT_TRUE(stats.ring_broken);
+  ASSERT_EQ(stats.ring_broken_count, 1u);
+  ASSERT_EQ(stats.domains.at(0).working_counter, 9u);
+  // the frame received in the first cycle was sent before the break
+  ASSERT_EQ(stats.domains.at(0).redundancy_active_cycles, 19u);
+  ASSERT_EQ(stats.links[0].slaves_responding, 1u);
+  ASSERT_EQ(stats.links[1].slaves_responding, 2u);
+  const auto incomplete = stats.domains.at(0).wc_incomplete_cycles;
+
+  sim_->breakRing(-1);
+  cycle(10);
+  stats = master_->getStatistics();
+  ASSERT_FALSE(stats.ring_broken);
+  ASSERT_EQ(stats.ring_broken_count, 1u);
+  ASSERT_EQ(stats.domains.at(0).wc_incomplete_cycles, incomplete);
+}
+
+TEST_F(EcMasterTest, ContinuesWhenMainLinkIsLost)
+{
+  sim_->setBackupDevice(true);
+  activate(2);
+  cycle(10);
+  const auto zero = master_->getStatistics().domains.at(0).wc_zero_cycles;
+
+  sim_->setLinkUp(ethercat_interface::sim::SimMaster::MAIN_DEVICE, false);
+  slaves_[0]->output = 78;
+  cycle(20);
+
+  auto stats = master_->getStatistics();
+  ASSERT_EQ(slaves_[0]->input, 78);
+  ASSERT_FALSE(stats.links[0].link_up);
+  ASSERT_EQ(stats.links[0].link_down_count, 1u);
+  ASSERT_TRUE(stats.links[1].link_up);
+  ASSERT_TRUE(stats.ring_broken);
+  ASSERT_EQ(stats.domains.at(0).wc_zero_cycles, zero);
+  ASSERT_EQ(sim_->framesLost(ethercat_interface::sim::SimMaster::MAIN_DEVICE), 20u);
+}
+
+TEST_F(EcMasterTest, SleepSpinWakeupStatistics)
+{
+  activate(1);
+  master_->setCtrlFrequency(1000);
+  master_->setWakeupStrategy(
+    ethercat_interface::EcMaster::WakeupStrategy::SLEEP_SPIN, 200000, true);
+
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  for (int i = 0; i < 50; i++) {
+    t.tv_nsec += master_->getInterval();
+    while (t.tv_nsec >= 1000000000) {
+      t.tv_nsec -= 1000000000;
+      t.tv_sec++;
+    }
+    master_->sleepUntil(t);
+    master_->update();
+  }
+
+  auto wakeup = master_->getStatistics().wakeup;
+  ASSERT_EQ(wakeup.wakeups, 50u);
+  // spinning never starts a cycle early
+  ASSERT_GE(wakeup.min_ns, 0);
+  ASSERT_GE(wakeup.max_ns, wakeup.min_ns);
+  ASSERT_GE(wakeup.jitter_ns, 0.0);
+  // the guard adapts within [2 us, interval / 2]
+  ASSERT_GE(wakeup.spin_guard_ns, 2000u);
+  ASSERT_LE(wakeup.spin_guard_ns, 500000u);
+  // the RT snapshot matches the full statistics
+  ASSERT_EQ(master_->getWakeupStatistics().wakeups, wakeup.wakeups);
+  ASSERT_DOUBLE_EQ(master_->getWakeupStatistics().jitter_ns, wakeup.jitter_ns);
+}
+
+TEST_F(EcMasterTest, CalibratesSync0Shift)
+{
+  sim_->setReferenceClockDelay(30000);
+  activate(2);
+  master_->setCtrlFrequency(1000);
+  master_->startSync0Calibration(100);
+  while (!master_->sync0CalibrationDone()) {
+    master_->update();
+  }
+
+  auto calibration = master_->getSync0Calibration(10000);
+  ASSERT_EQ(calibration.samples, 100u);
+  ASSERT_EQ(calibration.min_delay_ns, 30000);
+  ASSERT_EQ(calibration.p99_delay_ns, 30000);
+  ASSERT_EQ(calibration.shift_ns, 40000);
+}
+
+TEST_F(EcMasterTest, RejectsSync0ShiftLongerThanCycle)
+{
+  sim_->setReferenceClockDelay(995000);
+  activate(2);
+  master_->setCtrlFrequency(1000);
+  master_->startSync0Calibration(10);
+  while (!master_->sync0CalibrationDone()) {
+    master_->update();
+  }
+
+  // 995 us + 10 us does not fit in the 1 ms cycle, the shift must not wrap to 5 us
+  auto calibration = master_->getSync0Calibration(10000);
+  ASSERT_EQ(calibration.samples, 10u);
+  ASSERT_EQ(calibration.p99_delay_ns, 995000);
+  ASSERT_EQ(calibration.shift_ns, -1);
+}
+
+TEST_F(EcMasterTest, AppliesSync0Shift)
+{
+  master_ = std::make_unique<ethercat_interface::EcMaster>(0);
+  master_->setCtrlFrequency(1000);
+  master_->setSync0Shift(40000);
+  slaves_.push_back(std::make_unique<TestSlave>());
+  slaves_.back()->assign_activate = 0x0300;
+  master_->addSlave(0, 0, slaves_.back().get());
+
+  auto dc = sim_->dcConfig(0);
+  ASSERT_EQ(dc.assign_activate, 0x0300);
+  ASSERT_EQ(dc.sync0_cycle, 1000000u);
+  ASSERT_EQ(dc.sync0_shift, 40000);
+}
+
+TEST_F(EcMasterTest, AppliesSlaveDcSyncConfig)
+{
+  master_ = std::make_unique<ethercat_interface::EcMaster>(0);
+  master_->setCtrlFrequency(1000);
+  master_->setSync0Shift(40000);
+  slaves_.push_back(std::make_unique<TestSlave>());
+  slaves_.back()->assign_activate = 0x0700;
+  slaves_.back()->dc.sync0_cycle = 500000;
+  slaves_.back()->dc.sync0_shift = 100000;
+  slaves_.back()->dc.sync1_cycle = 1000000;
+  slaves_.back()->dc.sync1_shift = 250000;
+  ASSERT_TRUE(master_->addSlave(0, 0, slaves_.back().get()));
+
+  auto dc = sim_->dcConfig(0);
+  ASSERT_EQ(dc.assign_activate, 0x0700);
+  ASSERT_EQ(dc.sync0_cycle, 500000u);
+  ASSERT_EQ(dc.sync0_shift, 100000);
+  ASSERT_EQ(dc.sync1_cycle, 1000000u);
+  ASSERT_EQ(dc.sync1_shift, 250000);
+}
+
+TEST_F(EcMasterTest, RejectsInvalidDcSyncConfig)
+{
+  master_ = std::make_unique<ethercat_interface::EcMaster>(0);
+  master_->setCtrlFrequency(1000);
+  TestSlave slave;
+  slave.assign_activate = 0x0700;
+
+  // SYNC0 not aligned with the master cycle
+  slave.dc.sync0_cycle = 300000;
+  ASSERT_FALSE(master_->addSlave(0, 0, &slave));
+  // SYNC0 shift longer than the cycle
+  slave.dc.sync0_cycle = 0;
+  slave.dc.sync0_shift = 1000000;
+  ASSERT_FALSE(master_->addSlave(0, 0, &slave));
+  // SYNC1 not a multiple of SYNC0
+  slave.dc.sync0_shift.reset();
+  slave.dc.sync1_cycle = 1500000;
+  ASSERT_FALSE(master_->addSlave(0, 0, &slave));
+  ASSERT_EQ(sim_->dcConfig(0).assign_activate, 0);
+}
+
+TEST_F(EcMasterTest, SchedulesConfigSdo)
+{
+  activate(1);
+  ethercat_interface::SdoConfigEntry sdo;
+  sdo.index = 0x6060;
+  sdo.sub_index = 0;
+  sdo.data_type = "int8";
+  sdo.data = 8;
+  uint32_t abort_code;
+  ASSERT_EQ(master_->configSlaveSdo(0, sdo, &abort_code), 0);
+  ASSERT_EQ(sim_->sdo(0, 0x6060, 0), std::vector<uint8_t>({8}));
+  ASSERT_EQ(
+    master_->sdoScheduler().executed(ethercat_interface::SdoScheduler::CONFIG), 1u);
+
+  // waits for the transfers of higher priority on the slave
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future();
+  master_->sdoScheduler().submit(
+    0, ethercat_interface::SdoScheduler::SAFETY,
+    ethercat_interface::SdoScheduler::Clock::now() + std::chrono::seconds(10),
+    [released](bool) {released.wait();});
+  std::thread config([&]() {
+      sdo.data = 9;
+      ASSERT_EQ(master_->configSlaveSdo(0, sdo, &abort_code), 0);
+    });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_EQ(sim_->sdo(0, 0x6060, 0), std::vector<uint8_t>({8}));
+  release.set_value();
+  config.join();
+  ASSERT_EQ(sim_->sdo(0, 0x6060, 0), std::vector<uint8_t>({9}));
+  ASSERT_EQ(sim_->sdoTransfers(), 2u);
+}
+
+TEST_F(EcMasterTest, SharesSdoScheduler)
+{
+  using ethercat_interface::SdoScheduler;
+  auto scheduler = std::make_shared<SdoScheduler>();
+  activate(1);
+  master_->setSdoScheduler(scheduler);
+  ASSERT_EQ(&master_->sdoScheduler(), scheduler.get());
+
+  // the transfer of another user of the schedule holds the mailbox of the slave
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future();
+  scheduler->submit(
+    SdoScheduler::slaveKey(0, 0), SdoScheduler::BULK,
+    SdoScheduler::Clock::now() + std::chrono::seconds(10),
+    [released](bool) {released.wait();});
+  ethercat_interface::SdoConfigEntry sdo;
+  sdo.index = 0x6060;
+  sdo.sub_index = 0;
+  sdo.data_type = "int8";
+  sdo.data = 8;
+  uint32_t abort_code;
+  std::thread config([&]() {
+      ASSERT_EQ(master_->configSlaveSdo(0, sdo, &abort_code), 0);
+    });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_EQ(sim_->sdoTransfers(), 0u);
+  release.set_value();
+  config.join();
+  ASSERT_EQ(sim_->sdo(0, 0x6060, 0), std::vector<uint8_t>({8}));
+  ASSERT_EQ(scheduler->executed(SdoScheduler::CONFIG), 1u);
+  ASSERT_EQ(scheduler->executed(SdoScheduler::BULK), 1u);
+}
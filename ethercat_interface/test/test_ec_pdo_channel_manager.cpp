@@ -14,6 +14,8 @@
 
 #include <gtest/gtest.h>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "ethercat_interface/ec_pdo_channel_manager.hpp"
 #include "yaml-cpp/yaml.h"
@@ -142,3 +144,88 @@ TEST(TestEcPdoChannelManager, EcReadWriteBoolMask5)
   pdo_manager.ec_write(buffer, 5);
   ASSERT_EQ(EC_READ_U8(buffer), 5);
 }
+
+TEST(TestEcPdoChannelManager, SetParametersAtNextUpdate)
+{
+  const char channel_config[] =
+    R"(
+      {index: 0x6064, sub_index: 0, type: int32, state_interface: position, factor: 2, offset: 10}
+    )";
+  YAML::Node config = YAML::Load(channel_config);
+  ethercat_interface::EcPdoChannelManager pdo_manager;
+  pdo_manager.pdo_type = ethercat_interface::PdoType::TPDO;
+  pdo_manager.load_from_config(config);
+
+  ethercat_interface::ChannelParameters parameters;
+  parameters.factor = 3;
+  parameters.offset = -1;
+  parameters.default_value = 7;
+  pdo_manager.set_parameters(parameters);
+
+  // parameters are only taken over at the next cycle boundary
+  ASSERT_EQ(pdo_manager.factor, 2);
+  ASSERT_EQ(pdo_manager.offset, 10);
+
+  uint8_t buffer[4];
+  EC_WRITE_S32(buffer, 42);
+  pdo_manager.ec_update(buffer);
+  ASSERT_EQ(pdo_manager.factor, 3);
+  ASSERT_EQ(pdo_manager.offset, -1);
+  ASSERT_EQ(pdo_manager.default_value, 7);
+  ASSERT_EQ(pdo_manager.last_value, 3 * 42 - 1);
+
+  // consecutive updates, only the last one is applied
+  parameters.factor = 4;
+  pdo_manager.set_parameters(parameters);
+  parameters.factor = 5;
+  pdo_manager.set_parameters(parameters);
+  pdo_manager.ec_update(buffer);
+  ASSERT_EQ(pdo_manager.factor, 5);
+  pdo_manager.ec_update(buffer);
+  ASSERT_EQ(pdo_manager.factor, 5);
+}
+
+TEST(TestEcPdoChannelManager, AggregatesStatesBetweenReads)
+{
+  const char channel_config[] =
+    R"(
+      {index: 0x6064, sub_index: 0, type: int32, state_interface: position, aggregation: mean}
+    )";
+  YAML::Node config = YAML::Load(channel_config);
+  ethercat_interface::EcPdoChannelManager pdo_manager;
+  pdo_manager.pdo_type = ethercat_interface::PdoType::TPDO;
+  pdo_manager.load_from_config(config);
+  ASSERT_EQ(pdo_manager.aggregation, ethercat_interface::Aggregation::MEAN);
+
+  std::vector<double> states(1);
+  pdo_manager.setup_interface_ptrs(&states, NULL);
+  pdo_manager.interface_index = 0;
+
+  uint8_t buffer[4];
+  for (int value : {1, 2, 6}) {
+    EC_WRITE_S32(buffer, value);
+    pdo_manager.ec_update(buffer);
+  }
+  ASSERT_EQ(states[0], 3);
+  ASSERT_EQ(pdo_manager.last_value, 6);
+
+  pdo_manager.reset_aggregation();
+  EC_WRITE_S32(buffer, 10);
+  pdo_manager.ec_update(buffer);
+  ASSERT_EQ(states[0], 10);
+
+  const std::vector<std::pair<ethercat_interface::Aggregation, double>> expected = {
+    {ethercat_interface::Aggregation::LAST, 6},
+    {ethercat_interface::Aggregation::MIN, 1},
+    {ethercat_interface::Aggregation::MAX, 6},
+    {ethercat_interface::Aggregation::SUM, 9}};
+  for (const auto & policy : expected) {
+    pdo_manager.aggregation = policy.first;
+    pdo_manager.reset_aggregation();
+    for (int value : {1, 2, 6}) {
+      EC_WRITE_S32(buffer, value);
+      pdo_manager.ec_update(buffer);
+    }
+    ASSERT_EQ(states[0], policy.second);
+  }
+}
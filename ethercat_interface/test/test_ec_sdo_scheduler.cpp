@@ -0,0 +1,148 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ethercat_interface/ec_sdo_scheduler.hpp"
+
+using ethercat_interface::SdoScheduler;
+
+/** records the order of the transfers */
+class Recorder
+{
+public:
+  SdoScheduler::Transfer transfer(const std::string & name)
+  {
+    return [this, name](bool expired) {
+             std::lock_guard<std::mutex> lock(mutex_);
+             order_.push_back(expired ? name + " expired" : name);
+           };
+  }
+
+  std::vector<std::string> order()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return order_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<std::string> order_;
+};
+
+/** a transfer running until released */
+SdoScheduler::Transfer blocking(std::shared_future<void> release, std::promise<void> & started)
+{
+  return [release, &started](bool) {
+           started.set_value();
+           release.wait();
+         };
+}
+
+SdoScheduler::Clock::time_point in(int ms)
+{
+  return SdoScheduler::Clock::now() + std::chrono::milliseconds(ms);
+}
+
+TEST(TestSdoScheduler, RunsByPriority)
+{
+  SdoScheduler scheduler(1);
+  Recorder recorder;
+  std::promise<void> release, started;
+  scheduler.submit(0, SdoScheduler::BULK, in(10000), blocking(release.get_future(), started));
+  started.get_future().wait();
+
+  scheduler.submit(0, SdoScheduler::BULK, in(10000), recorder.transfer("bulk"));
+  scheduler.submit(0, SdoScheduler::CONFIG, in(10000), recorder.transfer("config"));
+  scheduler.submit(0, SdoScheduler::BULK, in(10000), recorder.transfer("bulk 2"));
+  scheduler.submit(0, SdoScheduler::SAFETY, in(10000), recorder.transfer("safety"));
+  scheduler.submit(0, SdoScheduler::DIAGNOSTIC, in(10000), recorder.transfer("diagnostic"));
+  ASSERT_EQ(scheduler.pending(), 5u);
+  release.set_value();
+
+  ASSERT_TRUE(scheduler.execute(0, SdoScheduler::BULK, in(10000), [] {}));
+  ASSERT_EQ(
+    recorder.order(),
+    std::vector<std::string>({"safety", "diagnostic", "config", "bulk", "bulk 2"}));
+  ASSERT_EQ(scheduler.executed(SdoScheduler::BULK), 4u);
+  ASSERT_EQ(scheduler.executed(SdoScheduler::SAFETY), 1u);
+
+  SdoScheduler::Priority priority;
+  ASSERT_TRUE(SdoScheduler::priorityFromString("diagnostic", priority));
+  ASSERT_EQ(priority, SdoScheduler::DIAGNOSTIC);
+  ASSERT_FALSE(SdoScheduler::priorityFromString("urgent", priority));
+}
+
+TEST(TestSdoScheduler, SerializesSlaves)
+{
+  SdoScheduler scheduler(2);
+  Recorder recorder;
+  std::promise<void> release, started;
+  const uint32_t slave_0 = SdoScheduler::slaveKey(0, 0);
+  const uint32_t slave_1 = SdoScheduler::slaveKey(0, 1);
+  scheduler.submit(
+    slave_0, SdoScheduler::BULK, in(10000), blocking(release.get_future(), started));
+  started.get_future().wait();
+
+  // the other slave is served while the first one is busy, with a free worker
+  scheduler.submit(slave_0, SdoScheduler::SAFETY, in(10000), recorder.transfer("slave 0"));
+  ASSERT_TRUE(
+    scheduler.execute(
+      slave_1, SdoScheduler::BULK, in(10000), [&recorder] {recorder.transfer("slave 1")(false);}));
+  ASSERT_EQ(recorder.order(), std::vector<std::string>({"slave 1"}));
+  ASSERT_EQ(scheduler.pending(), 1u);
+
+  release.set_value();
+  ASSERT_TRUE(scheduler.execute(slave_0, SdoScheduler::BULK, in(10000), [] {}));
+  ASSERT_EQ(recorder.order(), std::vector<std::string>({"slave 1", "slave 0"}));
+  ASSERT_NE(SdoScheduler::slaveKey(1, 0), slave_0);
+}
+
+TEST(TestSdoScheduler, ExpiresAtDeadline)
+{
+  SdoScheduler scheduler(1);
+  Recorder recorder;
+  std::promise<void> release, started;
+  scheduler.submit(0, SdoScheduler::BULK, in(10000), blocking(release.get_future(), started));
+  started.get_future().wait();
+
+  scheduler.submit(0, SdoScheduler::SAFETY, in(10), recorder.transfer("late"));
+  scheduler.submit(0, SdoScheduler::BULK, in(10000), recorder.transfer("bulk"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  release.set_value();
+
+  ASSERT_FALSE(scheduler.execute(0, SdoScheduler::SAFETY, in(-1), [] {}));
+  ASSERT_TRUE(scheduler.execute(0, SdoScheduler::BULK, in(10000), [] {}));
+  ASSERT_EQ(recorder.order(), std::vector<std::string>({"late expired", "bulk"}));
+  ASSERT_EQ(scheduler.expired(SdoScheduler::SAFETY), 2u);
+
+  // the queued transfers expire when stopping
+  std::promise<void> release_2, started_2;
+  scheduler.submit(
+    0, SdoScheduler::BULK, in(10000), blocking(release_2.get_future(), started_2));
+  started_2.get_future().wait();
+  scheduler.submit(0, SdoScheduler::BULK, in(10000), recorder.transfer("stopped"));
+  std::thread stopping([&scheduler] {scheduler.stop();});
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  release_2.set_value();
+  stopping.join();
+  ASSERT_EQ(recorder.order().back(), "stopped expired");
+  ASSERT_FALSE(scheduler.execute(0, SdoScheduler::SAFETY, in(10000), [] {}));
+}
@@ -0,0 +1,106 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "ethercat_interface/ec_shm_commands.hpp"
+
+namespace
+{
+const std::string region_name = "/test_ec_shm_commands_" + std::to_string(getpid());
+}
+
+TEST(TestShmCommandChannels, WriterReachesReader)
+{
+  ethercat_interface::ShmCommandChannels reader;
+  ASSERT_TRUE(reader.create(region_name, {"joint_1/position", "joint_2/velocity"}));
+
+  ethercat_interface::ShmCommandChannels writer;
+  ASSERT_TRUE(writer.open(region_name));
+  ASSERT_EQ(writer.size(), 2u);
+  ASSERT_EQ(writer.channel("joint_2/velocity"), 1);
+  ASSERT_EQ(writer.channel("joint_3/velocity"), -1);
+
+  double value = 0;
+  uint64_t stamp = 0;
+  ASSERT_FALSE(reader.read(1, value, stamp));
+
+  writer.write(1, 2.5, 1234);
+  ASSERT_TRUE(reader.read(1, value, stamp));
+  ASSERT_EQ(value, 2.5);
+  ASSERT_EQ(stamp, 1234u);
+  ASSERT_FALSE(reader.read(0, value, stamp));
+}
+
+TEST(TestShmCommandChannels, OpenFailsWithoutRegion)
+{
+  ethercat_interface::ShmCommandChannels writer;
+  ASSERT_FALSE(writer.open(region_name + "_missing"));
+
+  ethercat_interface::ShmCommandChannels reader;
+  ASSERT_TRUE(reader.create(region_name, {"joint_1/position"}));
+  reader.close();
+  ASSERT_FALSE(writer.open(region_name));
+}
+
+TEST(TestShmCommandChannels, ReaderNeverSeesTornValues)
+{
+  ethercat_interface::ShmCommandChannels reader;
+  ASSERT_TRUE(reader.create(region_name, {"joint_1/position"}));
+  ethercat_interface::ShmCommandChannels writer;
+  ASSERT_TRUE(writer.open(region_name));
+
+  // the stamp always mirrors the value, a torn read would break the pair
+  std::atomic<bool> done{false};
+  std::thread writer_thread([&]() {
+      for (uint64_t i = 1; i <= 200000; i++) {
+        writer.write(0, static_cast<double>(i), i);
+      }
+      done = true;
+    });
+  uint64_t reads = 0;
+  uint64_t last_stamp = 0;
+  while (!done) {
+    double value;
+    uint64_t stamp;
+    if (reader.read(0, value, stamp)) {
+      ASSERT_EQ(value, static_cast<double>(stamp));
+      ASSERT_GE(stamp, last_stamp);
+      last_stamp = stamp;
+      reads++;
+    }
+  }
+  writer_thread.join();
+  ASSERT_GT(reads, 0u);
+}
+
+TEST(TestShmCommandChannels, FreshWithinTimeout)
+{
+  using ethercat_interface::ShmCommandChannels;
+  const uint64_t now = 10000000;
+  ASSERT_TRUE(ShmCommandChannels::fresh(now, now, 1000));
+  ASSERT_TRUE(ShmCommandChannels::fresh(now - 1000, now, 1000));
+  ASSERT_FALSE(ShmCommandChannels::fresh(now - 1001, now, 1000));
+  // never written
+  ASSERT_FALSE(ShmCommandChannels::fresh(0, now, 1000));
+  // written after now was sampled
+  ASSERT_TRUE(ShmCommandChannels::fresh(now + 1000, now, 1000));
+  // a stamp from the future does not keep the value fresh
+  ASSERT_FALSE(ShmCommandChannels::fresh(now + 1001, now, 1000));
+  ASSERT_FALSE(ShmCommandChannels::fresh(UINT64_MAX, now, 1000));
+}
@@ -0,0 +1,128 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <utility>
+#include <vector>
+
+#include "ethercat_interface/ec_sim_cia402_drive.hpp"
+
+class CiA402DriveModelTest : public ::testing::Test
+{
+public:
+  void SetUp() override
+  {
+    // process image of a drive mapping all objects
+    size_t offset = 0;
+    for (auto & object : objects_) {
+      image_.entries_[(static_cast<uint32_t>(object.first) << 8)] = data_ + offset;
+      offset += object.second;
+    }
+  }
+
+  /** run one cycle of 1 ms with the given outputs */
+  void cycle(
+    ethercat_interface::sim::CiA402DriveModel & drive, uint16_t control_word,
+    int8_t mode = 8, int32_t target = 0)
+  {
+    EC_WRITE_U16(image_.entry(0x6040, 0), control_word);
+    EC_WRITE_S8(image_.entry(0x6060, 0), mode);
+    EC_WRITE_S32(image_.entry(0x607a, 0), target);
+    EC_WRITE_S32(image_.entry(0x60ff, 0), target);
+    EC_WRITE_S16(image_.entry(0x6071, 0), target);
+    image_.time_ += 1000000;
+    drive.cycle(image_);
+  }
+
+  uint16_t statusWord() {return EC_READ_U16(image_.entry(0x6041, 0));}
+  int32_t position() {return EC_READ_S32(image_.entry(0x6064, 0));}
+
+  /** walk the state machine to operation enabled */
+  void enable(ethercat_interface::sim::CiA402DriveModel & drive)
+  {
+    for (uint16_t control_word : {0x0006, 0x0007, 0x000f}) {
+      cycle(drive, control_word);
+    }
+  }
+
+protected:
+  ethercat_interface::sim::SlaveProcessImage image_;
+  uint8_t data_[64] = {};
+  const std::vector<std::pair<uint16_t, size_t>> objects_ = {
+    {0x6040, 2}, {0x6060, 1}, {0x607a, 4}, {0x60ff, 4}, {0x6071, 2},
+    {0x6041, 2}, {0x6061, 1}, {0x6064, 4}, {0x606c, 4}, {0x6077, 2}};
+};
+
+TEST_F(CiA402DriveModelTest, StateMachine)
+{
+  ethercat_interface::sim::CiA402DriveModel drive;
+  cycle(drive, 0x0000);
+  ASSERT_EQ(statusWord(), 0x0040);
+  cycle(drive, 0x0006);
+  ASSERT_EQ(statusWord(), 0x0021);
+  cycle(drive, 0x0007);
+  ASSERT_EQ(statusWord(), 0x0023);
+  cycle(drive, 0x000f);
+  ASSERT_EQ(statusWord(), 0x0027);
+  cycle(drive, 0x000b);
+  ASSERT_EQ(statusWord(), 0x0007);
+  cycle(drive, 0x000f);
+  ASSERT_EQ(statusWord(), 0x0027);
+
+  drive.setFault();
+  cycle(drive, 0x000f);
+  ASSERT_EQ(statusWord(), 0x0008);
+  cycle(drive, 0x000f);
+  ASSERT_EQ(statusWord(), 0x0008);
+  cycle(drive, 0x0080);
+  ASSERT_EQ(statusWord(), 0x0040);
+}
+
+TEST_F(CiA402DriveModelTest, FollowsPositionWithFirstOrderResponse)
+{
+  ethercat_interface::sim::CiA402DriveConfig config;
+  config.time_constant = 0.005;
+  ethercat_interface::sim::CiA402DriveModel drive(config);
+  enable(drive);
+
+  for (int i = 0; i < 5; i++) {
+    cycle(drive, 0x000f, 8, 10000);
+  }
+  // 1 - exp(-1) after one time constant
+  ASSERT_NEAR(position(), 6321, 1);
+  ASSERT_EQ(EC_READ_S8(image_.entry(0x6061, 0)), 8);
+
+  // no motion once disabled
+  cycle(drive, 0x0006, 8, 0);
+  const int32_t hold = position();
+  cycle(drive, 0x0006, 8, 0);
+  ASSERT_EQ(position(), hold);
+}
+
+TEST_F(CiA402DriveModelTest, RespondsAfterDelay)
+{
+  ethercat_interface::sim::CiA402DriveConfig config;
+  config.time_constant = 0;
+  config.response_delay_cycles = 3;
+  ethercat_interface::sim::CiA402DriveModel drive(config);
+  enable(drive);
+
+  cycle(drive, 0x000f, 9, 1000);
+  ASSERT_EQ(EC_READ_S32(image_.entry(0x606c, 0)), 0);
+  cycle(drive, 0x000f, 9, 1000);
+  cycle(drive, 0x000f, 9, 1000);
+  ASSERT_EQ(EC_READ_S32(image_.entry(0x606c, 0)), 0);
+  cycle(drive, 0x000f, 9, 1000);
+  ASSERT_EQ(EC_READ_S32(image_.entry(0x606c, 0)), 1000);
+}
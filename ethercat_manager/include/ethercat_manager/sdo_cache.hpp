@@ -0,0 +1,183 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_MANAGER__SDO_CACHE_HPP_
+#define ETHERCAT_MANAGER__SDO_CACHE_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "yaml-cpp/yaml.h"
+
+namespace ethercat_manager
+{
+
+/** SDO object of a slave on a master */
+struct SdoKey
+{
+  int master = 0;
+  uint16_t slave_position = 0;
+  uint16_t index = 0;
+  uint8_t subindex = 0;
+
+  bool operator<(const SdoKey & other) const
+  {
+    return std::tie(master, slave_position, index, subindex) <
+           std::tie(other.master, other.slave_position, other.index, other.subindex);
+  }
+};
+
+/** Cache of the raw data uploaded from SDO objects, so that objects polled faster than they
+ *  change do not hit the mailbox of the slave at each request. Each object is kept for its
+ *  time to live, given by the most specific matching rule {slave_position, index, subindex}
+ *  or by the default one; a time to live of 0 disables the caching of the object.
+ *  The data is cached raw and decoded at each request, downloads invalidate their object. */
+class SdoCache
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /** time to live in s of the objects without rule */
+  void setDefaultTtl(double ttl) {default_ttl_ = ttl;}
+
+  /** add a time to live rule, a negative slave position or subindex matches any */
+  void addRule(int slave_position, uint16_t index, int subindex, double ttl)
+  {
+    rules_.push_back({slave_position, index, subindex, ttl});
+  }
+
+  /** set up from a yaml node {default_ttl, objects: [{index, subindex, slave_position, ttl}]},
+   *  the subindex and slave position of an object are optional */
+  bool load(const YAML::Node & config)
+  {
+    try {
+      if (config["default_ttl"]) {
+        setDefaultTtl(config["default_ttl"].as<double>());
+      }
+      for (const auto & object : config["objects"]) {
+        addRule(
+          object["slave_position"] ? object["slave_position"].as<int>() : -1,
+          object["index"].as<uint16_t>(),
+          object["subindex"] ? object["subindex"].as<int>() : -1,
+          object["ttl"].as<double>());
+      }
+    } catch (const YAML::Exception & ex) {
+      std::cerr << "SdoCache: invalid cache configuration: " << ex.what() << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /** time to live in s of the object */
+  double ttl(const SdoKey & key) const
+  {
+    double ttl = default_ttl_;
+    int best = -1;
+    for (const auto & rule : rules_) {
+      if (rule.index != key.index ||
+        (rule.slave_position >= 0 && rule.slave_position != key.slave_position) ||
+        (rule.subindex >= 0 && rule.subindex != key.subindex))
+      {
+        continue;
+      }
+      // a rule on the slave is more specific than a rule on the subindex
+      const int specificity = (rule.slave_position >= 0 ? 2 : 0) + (rule.subindex >= 0 ? 1 : 0);
+      if (specificity > best) {
+        best = specificity;
+        ttl = rule.ttl;
+      }
+    }
+    return ttl;
+  }
+
+  /** data of the object if it is cached and still alive, counts a hit or a miss */
+  bool lookup(const SdoKey & key, Clock::time_point now, std::vector<uint8_t> & data)
+  {
+    auto entry = entries_.find(key);
+    if (entry == entries_.end() || now >= entry->second.expiry) {
+      misses_++;
+      return false;
+    }
+    hits_++;
+    data = entry->second.data;
+    return true;
+  }
+
+  /** cache the data uploaded from the object at now */
+  void store(const SdoKey & key, Clock::time_point now, const std::vector<uint8_t> & data)
+  {
+    const double ttl = this->ttl(key);
+    if (!(ttl > 0)) {
+      return;
+    }
+    Entry & entry = entries_[key];
+    entry.data = data;
+    entry.expiry = now + std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(ttl));
+  }
+
+  /** forget the object, e.g. after a download to it */
+  void invalidate(const SdoKey & key)
+  {
+    if (entries_.erase(key) > 0) {
+      invalidations_++;
+    }
+  }
+
+  /** forget the expired objects */
+  void prune(Clock::time_point now)
+  {
+    for (auto entry = entries_.begin(); entry != entries_.end(); ) {
+      entry = now >= entry->second.expiry ? entries_.erase(entry) : std::next(entry);
+    }
+  }
+
+  void clear() {entries_.clear();}
+
+  size_t size() const {return entries_.size();}
+  uint64_t hits() const {return hits_;}
+  uint64_t misses() const {return misses_;}
+  uint64_t invalidations() const {return invalidations_;}
+
+private:
+  struct Rule
+  {
+    int slave_position;
+    uint16_t index;
+    int subindex;
+    double ttl;
+  };
+
+  struct Entry
+  {
+    std::vector<uint8_t> data;
+    Clock::time_point expiry;
+  };
+
+  double default_ttl_ = 0;
+  std::vector<Rule> rules_;
+  std::map<SdoKey, Entry> entries_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t invalidations_ = 0;
+};
+
+}  // namespace ethercat_manager
+#endif  // ETHERCAT_MANAGER__SDO_CACHE_HPP_
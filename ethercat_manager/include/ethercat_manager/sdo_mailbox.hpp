@@ -0,0 +1,48 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_MANAGER__SDO_MAILBOX_HPP_
+#define ETHERCAT_MANAGER__SDO_MAILBOX_HPP_
+
+#include "ethercat_manager/ec_master_async.hpp"
+
+namespace ethercat_manager
+{
+
+/** SDO transfers with the mailboxes of the slaves, through the device of the master. Each
+ *  transfer opens the device, so that transfers on several slaves may run at the same time.
+ *  Throws a MasterException if the transfer fails */
+class SdoMailbox
+{
+public:
+  virtual ~SdoMailbox() {}
+
+  virtual void upload(int master_id, ec_ioctl_slave_sdo_upload_t * data)
+  {
+    EcMasterAsync master(master_id);
+    master.open(EcMasterAsync::Read);
+    master.sdo_upload(data);
+  }
+
+  virtual void download(int master_id, ec_ioctl_slave_sdo_download_t * data)
+  {
+    EcMasterAsync master(master_id);
+    master.open(EcMasterAsync::ReadWrite);
+    master.sdo_download(data);
+  }
+};
+
+}  // namespace ethercat_manager
+
+#endif  // ETHERCAT_MANAGER__SDO_MAILBOX_HPP_
@@ -0,0 +1,81 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_MANAGER__SDO_MONITOR_HPP_
+#define ETHERCAT_MANAGER__SDO_MONITOR_HPP_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "ethercat_msgs/msg/sdo_values.hpp"
+#include "ethercat_manager/sdo_mailbox.hpp"
+#include "ethercat_manager/sdo_monitor_schedule.hpp"
+#include "ethercat_interface/ec_sdo_scheduler.hpp"
+
+namespace ethercat_manager
+{
+using ethercat_interface::SdoScheduler;
+
+struct DataType;
+
+/** Periodic uploads of SDO objects within a mailbox bandwidth budget, published together.
+ *  The uploads run through the SdoScheduler, one at a time per slave */
+class SdoMonitor : public rclcpp::Node
+{
+public:
+  /** the uploads run through scheduler, shared with the other users of the mailboxes in the
+   *  process. its concurrency is set by its owner, from the sdo_concurrency parameter */
+  explicit SdoMonitor(
+    std::shared_ptr<SdoScheduler> scheduler,
+    std::shared_ptr<SdoMailbox> mailbox = std::make_shared<SdoMailbox>(),
+    const rclcpp::NodeOptions & options = rclcpp::NodeOptions());
+  ~SdoMonitor();
+
+protected:
+  /** time of the schedule in s, independent of the ROS time */
+  static double steadyTime()
+  {
+    return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /** submit the uploads due */
+  void tick();
+
+  void upload(size_t object);
+
+  void publish();
+
+  SdoMonitorSchedule schedule_;
+  std::shared_ptr<SdoScheduler> scheduler_;
+  std::shared_ptr<SdoMailbox> mailbox_;
+  std::vector<const DataType *> data_types_;
+  std::vector<SdoScheduler::Priority> priorities_;
+  /** the values are shared by the node and the transfers */
+  std::mutex mutex_;
+  std::vector<double> values_;
+  std::vector<rclcpp::Time> stamps_;
+  std::vector<uint32_t> errors_;
+  std::vector<size_t> uploads_;
+  ethercat_msgs::msg::SdoValues msg_;
+  rclcpp::Publisher<ethercat_msgs::msg::SdoValues>::SharedPtr values_pub_;
+  rclcpp::TimerBase::SharedPtr tick_timer_;
+  rclcpp::TimerBase::SharedPtr publish_timer_;
+};
+
+}  // namespace ethercat_manager
+
+#endif  // ETHERCAT_MANAGER__SDO_MONITOR_HPP_
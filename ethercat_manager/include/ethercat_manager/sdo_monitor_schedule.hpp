@@ -0,0 +1,192 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ETHERCAT_MANAGER__SDO_MONITOR_SCHEDULE_HPP_
+#define ETHERCAT_MANAGER__SDO_MONITOR_SCHEDULE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "yaml-cpp/yaml.h"
+
+namespace ethercat_manager
+{
+
+/** Schedule of the periodic uploads of SDO objects monitored on the slaves.
+ *  Each object is due once per period. The uploads are limited to a mailbox bandwidth
+ *  budget in uploads per s over all the slaves, and the due objects are taken round robin
+ *  across the slaves, so that a slave with many objects neither starves the others nor
+ *  gets several requests in a row in its mailbox. An object served a period or more late
+ *  skips the missed periods and counts as late. */
+class SdoMonitorSchedule
+{
+public:
+  struct Object
+  {
+    std::string name;
+    int master_id = 0;
+    uint16_t slave_position = 0;
+    uint16_t index = 0;
+    uint8_t subindex = 0;
+    std::string data_type;
+    double period = 1;
+    /** priority class of the uploads */
+    std::string priority = "diagnostic";
+  };
+
+  /** set up from a yaml node {bandwidth, publish_period, objects: [{name, master_id,
+   *  slave_position, index, subindex, data_type, period, priority}]} */
+  bool load(const YAML::Node & config)
+  {
+    try {
+      if (config["bandwidth"]) {
+        bandwidth_ = config["bandwidth"].as<double>();
+      }
+      if (config["publish_period"]) {
+        publish_period_ = config["publish_period"].as<double>();
+      }
+      for (const auto & object_config : config["objects"]) {
+        Object object;
+        object.name = object_config["name"].as<std::string>();
+        object.master_id = object_config["master_id"] ? object_config["master_id"].as<int>() : 0;
+        object.slave_position = object_config["slave_position"].as<uint16_t>();
+        object.index = object_config["index"].as<uint16_t>();
+        object.subindex = object_config["subindex"] ? object_config["subindex"].as<int>() : 0;
+        object.data_type = object_config["data_type"].as<std::string>();
+        object.period = object_config["period"] ? object_config["period"].as<double>() : 1;
+        if (object_config["priority"]) {
+          object.priority = object_config["priority"].as<std::string>();
+        }
+        if (!(object.period > 0)) {
+          std::cerr << "SdoMonitorSchedule: " << object.name << ": expected a positive period." <<
+            std::endl;
+          return false;
+        }
+        add(object);
+      }
+    } catch (const YAML::Exception & ex) {
+      std::cerr << "SdoMonitorSchedule: invalid monitor configuration: " << ex.what() <<
+        std::endl;
+      return false;
+    }
+    if (!(bandwidth_ > 0) || !(publish_period_ > 0)) {
+      std::cerr << "SdoMonitorSchedule: expected a positive bandwidth and publish period." <<
+        std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /** add an object to monitor, returns its number */
+  size_t add(const Object & object)
+  {
+    objects_.push_back(object);
+    due_.push_back(0);
+    const std::pair<int, uint16_t> slave(object.master_id, object.slave_position);
+    auto it = std::find(slave_ids_.begin(), slave_ids_.end(), slave);
+    if (it == slave_ids_.end()) {
+      slave_ids_.push_back(slave);
+      slaves_.emplace_back();
+      it = slave_ids_.end() - 1;
+    }
+    slaves_[it - slave_ids_.begin()].push_back(objects_.size() - 1);
+    return objects_.size() - 1;
+  }
+
+  /** all the objects are due at now, with a full budget */
+  void start(double now)
+  {
+    std::fill(due_.begin(), due_.end(), now);
+    last_ = now;
+    tokens_ = 1;
+    cursor_ = 0;
+  }
+
+  /** objects to upload at now within the budget, appended to uploads */
+  void next(double now, std::vector<size_t> & uploads)
+  {
+    // the budget unused in a call is not saved for later bursts
+    const double refill = bandwidth_ * std::max(0.0, now - last_);
+    tokens_ = std::min(tokens_ + refill, std::max(1.0, refill));
+    last_ = now;
+    while (tokens_ >= 1) {
+      const int object = take(now);
+      if (object < 0) {
+        break;
+      }
+      uploads.push_back(object);
+      tokens_ -= 1;
+    }
+  }
+
+  const std::vector<Object> & objects() const {return objects_;}
+  double bandwidth() const {return bandwidth_;}
+  double publishPeriod() const {return publish_period_;}
+  size_t slaves() const {return slaves_.size();}
+  /** uploads per s needed to serve all the objects on time */
+  double demand() const
+  {
+    double demand = 0;
+    for (const auto & object : objects_) {
+      demand += 1 / object.period;
+    }
+    return demand;
+  }
+  /** number of uploads served a period or more late */
+  uint64_t late() const {return late_;}
+
+private:
+  /** most overdue object of the next slave having one, -1 if none is due */
+  int take(double now)
+  {
+    for (size_t k = 0; k < slaves_.size(); k++) {
+      const size_t slave = (cursor_ + k) % slaves_.size();
+      int best = -1;
+      for (const size_t object : slaves_[slave]) {
+        if (due_[object] <= now && (best < 0 || due_[object] < due_[best])) {
+          best = object;
+        }
+      }
+      if (best >= 0) {
+        cursor_ = slave + 1;
+        due_[best] += objects_[best].period;
+        if (due_[best] <= now) {
+          late_++;
+          due_[best] = now + objects_[best].period;
+        }
+        return best;
+      }
+    }
+    return -1;
+  }
+
+  double bandwidth_ = 20;
+  double publish_period_ = 1;
+  std::vector<Object> objects_;
+  std::vector<double> due_;
+  /** objects of each slave, and the master and position of the slave */
+  std::vector<std::vector<size_t>> slaves_;
+  std::vector<std::pair<int, uint16_t>> slave_ids_;
+  size_t cursor_ = 0;
+  double tokens_ = 1;
+  double last_ = 0;
+  uint64_t late_ = 0;
+};
+
+}  // namespace ethercat_manager
+#endif  // ETHERCAT_MANAGER__SDO_MONITOR_SCHEDULE_HPP_
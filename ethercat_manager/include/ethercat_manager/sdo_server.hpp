@@ -0,0 +1,119 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Maciej Bednarczyk (mcbed.robotics@gmail.com)
+
+#ifndef ETHERCAT_MANAGER__SDO_SERVER_HPP_
+#define ETHERCAT_MANAGER__SDO_SERVER_HPP_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "rclcpp/rclcpp.hpp"
+#include "ethercat_msgs/srv/get_sdo.hpp"
+#include "ethercat_msgs/srv/set_sdo.hpp"
+#include "ethercat_msgs/msg/sdo_cache_statistics.hpp"
+#include "ethercat_manager/sdo_cache.hpp"
+#include "ethercat_manager/sdo_mailbox.hpp"
+#include "ethercat_interface/ec_sdo_scheduler.hpp"
+
+namespace ethercat_manager
+{
+using ethercat_interface::SdoScheduler;
+
+/** SDO services of the EtherCAT masters, with a cache of the uploaded values. The transfers
+ *  are ordered by the SdoScheduler and answered when done, without blocking the node */
+class SdoServer : public rclcpp::Node
+{
+public:
+  using GetSdo = ethercat_msgs::srv::GetSdo;
+  using SetSdo = ethercat_msgs::srv::SetSdo;
+
+  /** the transfers run through scheduler, shared with the other users of the mailboxes in the
+   *  process. its concurrency is set by its owner, from the sdo_concurrency parameter */
+  explicit SdoServer(
+    std::shared_ptr<SdoScheduler> scheduler,
+    std::shared_ptr<SdoMailbox> mailbox = std::make_shared<SdoMailbox>(),
+    const rclcpp::NodeOptions & options = rclcpp::NodeOptions());
+  ~SdoServer();
+
+  /** upload an object, from the cache if possible. done is called with the response, at once
+   *  or from the transfer */
+  void getSdo(
+    std::shared_ptr<GetSdo::Request> request, std::function<void(GetSdo::Response &)> done);
+
+  /** download an object. done is called with the response from the transfer */
+  void setSdo(
+    std::shared_ptr<SetSdo::Request> request, std::function<void(SetSdo::Response &)> done);
+
+private:
+  /** priority class of a request, the default if none is given */
+  static SdoScheduler::Priority priority(uint8_t priority, SdoScheduler::Priority otherwise)
+  {
+    return priority > 0 && priority <= SdoScheduler::PRIORITIES ?
+           static_cast<SdoScheduler::Priority>(priority - 1) : otherwise;
+  }
+
+  /** time until which a request may wait for the mailbox */
+  SdoScheduler::Clock::time_point deadline(double timeout) const
+  {
+    return SdoScheduler::Clock::now() + std::chrono::duration_cast<SdoScheduler::Clock::duration>(
+      std::chrono::duration<double>(timeout > 0 ? timeout : timeout_));
+  }
+
+  void onGetSdo(
+    const std::shared_ptr<rmw_request_id_t> header,
+    const std::shared_ptr<GetSdo::Request> request);
+
+  void onSetSdo(
+    const std::shared_ptr<rmw_request_id_t> header,
+    const std::shared_ptr<SetSdo::Request> request);
+
+  template<typename Response>
+  static void timedOut(Response & response)
+  {
+    response.success = false;
+    response.sdo_return_message = "SDO request timed out waiting for the mailbox of the slave";
+    RCLCPP_ERROR(rclcpp::get_logger("ethercat_manager"), response.sdo_return_message.c_str());
+  }
+
+  void publishStatistics();
+
+  /** answer from the cache, or from the mailbox if from_mailbox. returns false if the value
+   *  is not cached */
+  bool upload(
+    const std::shared_ptr<GetSdo::Request> request,
+    std::shared_ptr<GetSdo::Response> response, bool from_mailbox);
+
+  void download(
+    const std::shared_ptr<SetSdo::Request> request,
+    std::shared_ptr<SetSdo::Response> response);
+
+  std::shared_ptr<SdoScheduler> scheduler_;
+  std::shared_ptr<SdoMailbox> mailbox_;
+  double timeout_;
+  /** the cache is shared by the node and the transfers */
+  std::mutex cache_mutex_;
+  SdoCache cache_;
+  uint64_t bypasses_ = 0;
+  rclcpp::Service<GetSdo>::SharedPtr service_get_sdo_;
+  rclcpp::Service<SetSdo>::SharedPtr service_set_sdo_;
+  rclcpp::Publisher<ethercat_msgs::msg::SdoCacheStatistics>::SharedPtr statistics_pub_;
+  rclcpp::TimerBase::SharedPtr statistics_timer_;
+};
+
+}  // namespace ethercat_manager
+
+#endif  // ETHERCAT_MANAGER__SDO_SERVER_HPP_
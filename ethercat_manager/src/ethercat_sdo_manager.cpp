@@ -0,0 +1,41 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "rclcpp/rclcpp.hpp"
+#include "ethercat_manager/sdo_monitor.hpp"
+#include "ethercat_manager/sdo_server.hpp"
+
+/** the SDO services and the monitor in one process, with one schedule of the transfers on the
+ *  mailboxes: a burst of service requests does not delay the monitor uploads of a higher
+ *  priority, and the transfers on a slave never overlap */
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+
+  auto scheduler = std::make_shared<ethercat_interface::SdoScheduler>();
+  auto server = std::make_shared<ethercat_manager::SdoServer>(scheduler);
+  auto monitor = std::make_shared<ethercat_manager::SdoMonitor>(scheduler);
+  scheduler->setConcurrency(server->get_parameter("sdo_concurrency").as_int());
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(server);
+  executor.add_node(monitor);
+  executor.spin();
+  // the transfers of both nodes end before either goes
+  scheduler->stop();
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,31 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "rclcpp/rclcpp.hpp"
+#include "ethercat_manager/sdo_monitor.hpp"
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+
+  auto scheduler = std::make_shared<ethercat_interface::SdoScheduler>();
+  auto node = std::make_shared<ethercat_manager::SdoMonitor>(scheduler);
+  scheduler->setConcurrency(node->get_parameter("sdo_concurrency").as_int());
+
+  rclcpp::spin(node);
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,155 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ethercat_manager/sdo_monitor.hpp"
+#include "ethercat_manager/data_convertion_tools.hpp"
+
+namespace ethercat_manager
+{
+
+SdoMonitor::SdoMonitor(
+  std::shared_ptr<SdoScheduler> scheduler, std::shared_ptr<SdoMailbox> mailbox,
+  const rclcpp::NodeOptions & options)
+: rclcpp::Node("ethercat_sdo_monitor", options), scheduler_(scheduler), mailbox_(mailbox)
+{
+  const std::string config = declare_parameter<std::string>("config", "");
+  const double tick_period = declare_parameter<double>("tick_period", 0.01);
+  declare_parameter<int>("sdo_concurrency", 2);
+  try {
+    if (!schedule_.load(YAML::LoadFile(config))) {
+      throw std::runtime_error("Invalid SDO monitor configuration " + config);
+    }
+  } catch (const YAML::Exception & ex) {
+    throw std::runtime_error(
+            "Failed to load the SDO monitor configuration " + config + ": " + ex.what());
+  }
+  if (schedule_.demand() > schedule_.bandwidth()) {
+    RCLCPP_WARN(
+      get_logger(), "The objects need %.1f uploads/s, more than the bandwidth of %.1f: "
+      "they will be uploaded late.", schedule_.demand(), schedule_.bandwidth());
+  }
+
+  const size_t size = schedule_.objects().size();
+  values_.assign(size, std::numeric_limits<double>::quiet_NaN());
+  stamps_.assign(size, rclcpp::Time(0, 0, get_clock()->get_clock_type()));
+  errors_.assign(size, 0);
+  data_types_.resize(size);
+  priorities_.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    const auto & object = schedule_.objects()[i];
+    if (!(data_types_[i] = get_data_type(object.data_type))) {
+      throw std::runtime_error(
+              "Invalid data type '" + object.data_type + "' of " + object.name);
+    }
+    if (!SdoScheduler::priorityFromString(object.priority, priorities_[i])) {
+      throw std::runtime_error("Invalid priority '" + object.priority + "' of " + object.name);
+    }
+    msg_.names.push_back(object.name);
+  }
+
+  schedule_.start(steadyTime());
+  values_pub_ = create_publisher<ethercat_msgs::msg::SdoValues>(
+    "ethercat_manager/sdo_values", 10);
+  tick_timer_ = create_wall_timer(
+    std::chrono::duration<double>(tick_period), std::bind(&SdoMonitor::tick, this));
+  publish_timer_ = create_wall_timer(
+    std::chrono::duration<double>(schedule_.publishPeriod()),
+    std::bind(&SdoMonitor::publish, this));
+}
+
+SdoMonitor::~SdoMonitor()
+{
+  // the transfers end before the values go. the scheduler stops for all its users, which go
+  // with the node in the hosting process
+  scheduler_->stop();
+}
+
+void SdoMonitor::tick()
+{
+  uploads_.clear();
+  schedule_.next(steadyTime(), uploads_);
+  for (const size_t object : uploads_) {
+    const auto & config = schedule_.objects()[object];
+    // a value not uploaded within its period is replaced by the next one
+    scheduler_->submit(
+      SdoScheduler::slaveKey(config.master_id, config.slave_position), priorities_[object],
+      SdoScheduler::Clock::now() + std::chrono::duration_cast<SdoScheduler::Clock::duration>(
+        std::chrono::duration<double>(config.period)),
+      [this, object](bool expired) {
+        if (expired) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          errors_[object]++;
+        } else {
+          upload(object);
+        }
+      });
+  }
+}
+
+void SdoMonitor::upload(size_t object)
+{
+  const auto & config = schedule_.objects()[object];
+  ec_ioctl_slave_sdo_upload_t data;
+  data.slave_position = config.slave_position;
+  data.sdo_index = config.index;
+  data.sdo_entry_subindex = config.subindex;
+  data.target_size = data_types_[object]->byteSize;
+  std::vector<uint8_t> buffer(data.target_size + 1);
+  data.target = buffer.data();
+
+  std::stringstream data_stream;
+  double value = std::numeric_limits<double>::quiet_NaN();
+  try {
+    mailbox_->upload(config.master_id, &data);
+    buffer2data(data_stream, value, data_types_[object], data.target, data.data_size);
+  } catch (const std::runtime_error & e) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 10000, "Failed to upload %s: %s", config.name.c_str(),
+      e.what());
+    std::lock_guard<std::mutex> lock(mutex_);
+    errors_[object]++;
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  values_[object] = value;
+  stamps_[object] = now();
+}
+
+void SdoMonitor::publish()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  const rclcpp::Time stamp = now();
+  msg_.header.stamp = stamp;
+  msg_.values = values_;
+  msg_.ages.resize(stamps_.size());
+  for (size_t i = 0; i < stamps_.size(); i++) {
+    msg_.ages[i] = std::isnan(values_[i]) ? std::numeric_limits<double>::infinity() :
+      (stamp - stamps_[i]).seconds();
+  }
+  msg_.errors = errors_;
+  msg_.late_uploads = schedule_.late();
+  values_pub_->publish(msg_);
+}
+}  // namespace ethercat_manager
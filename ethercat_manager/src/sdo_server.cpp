@@ -0,0 +1,312 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Maciej Bednarczyk (mcbed.robotics@gmail.com)
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ethercat_manager/sdo_server.hpp"
+#include "ethercat_manager/data_convertion_tools.hpp"
+
+namespace ethercat_manager
+{
+
+SdoServer::SdoServer(
+  std::shared_ptr<SdoScheduler> scheduler, std::shared_ptr<SdoMailbox> mailbox,
+  const rclcpp::NodeOptions & options)
+: rclcpp::Node("ethercat_sdo_srv_server", options), scheduler_(scheduler), mailbox_(mailbox)
+{
+  cache_.setDefaultTtl(declare_parameter<double>("cache_default_ttl", 0.0));
+  const std::string cache_config = declare_parameter<std::string>("cache_config", "");
+  if (!cache_config.empty()) {
+    try {
+      if (!cache_.load(YAML::LoadFile(cache_config))) {
+        RCLCPP_ERROR(get_logger(), "Invalid SDO cache configuration %s", cache_config.c_str());
+      }
+    } catch (const YAML::Exception & ex) {
+      RCLCPP_ERROR(
+        get_logger(), "Failed to load the SDO cache configuration %s: %s",
+        cache_config.c_str(), ex.what());
+    }
+  }
+
+  declare_parameter<int>("sdo_concurrency", 2);
+  timeout_ = declare_parameter<double>("sdo_timeout", 5.0);
+
+  service_get_sdo_ = create_service<GetSdo>(
+    "ethercat_manager/get_sdo",
+    std::bind(&SdoServer::onGetSdo, this, std::placeholders::_1, std::placeholders::_2));
+  service_set_sdo_ = create_service<SetSdo>(
+    "ethercat_manager/set_sdo",
+    std::bind(&SdoServer::onSetSdo, this, std::placeholders::_1, std::placeholders::_2));
+
+  const double statistics_period = declare_parameter<double>("cache_statistics_period", 1.0);
+  if (statistics_period > 0) {
+    statistics_pub_ = create_publisher<ethercat_msgs::msg::SdoCacheStatistics>(
+      "ethercat_manager/sdo_cache_statistics", 10);
+    statistics_timer_ = create_wall_timer(
+      std::chrono::duration<double>(statistics_period),
+      std::bind(&SdoServer::publishStatistics, this));
+  }
+}
+
+SdoServer::~SdoServer()
+{
+  // the queued requests expire, the running transfers end before the cache goes. the
+  // scheduler stops for all its users, which go with the node in the hosting process
+  scheduler_->stop();
+}
+
+void SdoServer::getSdo(
+  std::shared_ptr<GetSdo::Request> request, std::function<void(GetSdo::Response &)> done)
+{
+  auto response = std::make_shared<GetSdo::Response>();
+  // cached values are answered at once, without waiting for the mailbox
+  if (request->bypass_cache) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    bypasses_++;
+  } else if (upload(request, response, false)) {
+    done(*response);
+    return;
+  }
+  scheduler_->submit(
+    SdoScheduler::slaveKey(request->master_id, request->slave_position),
+    priority(request->priority, SdoScheduler::DIAGNOSTIC), deadline(request->timeout),
+    [this, request, response, done](bool expired) {
+      if (expired) {
+        timedOut(*response);
+      } else {
+        upload(request, response, true);
+      }
+      done(*response);
+    });
+}
+
+void SdoServer::setSdo(
+  std::shared_ptr<SetSdo::Request> request, std::function<void(SetSdo::Response &)> done)
+{
+  auto response = std::make_shared<SetSdo::Response>();
+  scheduler_->submit(
+    SdoScheduler::slaveKey(request->master_id, static_cast<uint16_t>(request->slave_position)),
+    priority(request->priority, SdoScheduler::CONFIG), deadline(request->timeout),
+    [this, request, response, done](bool expired) {
+      if (expired) {
+        timedOut(*response);
+      } else {
+        download(request, response);
+      }
+      done(*response);
+    });
+}
+
+void SdoServer::onGetSdo(
+  const std::shared_ptr<rmw_request_id_t> header,
+  const std::shared_ptr<GetSdo::Request> request)
+{
+  getSdo(
+    request, [this, header](GetSdo::Response & response) {
+      service_get_sdo_->send_response(*header, response);
+    });
+}
+
+void SdoServer::onSetSdo(
+  const std::shared_ptr<rmw_request_id_t> header,
+  const std::shared_ptr<SetSdo::Request> request)
+{
+  setSdo(
+    request, [this, header](SetSdo::Response & response) {
+      service_set_sdo_->send_response(*header, response);
+    });
+}
+
+void SdoServer::publishStatistics()
+{
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  cache_.prune(SdoCache::Clock::now());
+  ethercat_msgs::msg::SdoCacheStatistics msg;
+  msg.header.stamp = now();
+  msg.hits = cache_.hits();
+  msg.misses = cache_.misses();
+  msg.bypasses = bypasses_;
+  msg.invalidations = cache_.invalidations();
+  msg.entries = cache_.size();
+  statistics_pub_->publish(msg);
+}
+
+bool SdoServer::upload(
+  const std::shared_ptr<GetSdo::Request> request,
+  std::shared_ptr<GetSdo::Response> response, bool from_mailbox)
+{
+  ec_ioctl_slave_sdo_upload_t data;
+  std::stringstream return_stream, data_stream;
+  const DataType * data_type = NULL;
+  double data_value = std::numeric_limits<double>::quiet_NaN();
+  response->sdo_return_value = data_value;
+  response->cached = false;
+
+  data.sdo_index = request->sdo_index;
+  data.sdo_entry_subindex = request->sdo_subindex;
+  data.slave_position = request->slave_position;
+
+  if (!(data_type = get_data_type(request->sdo_data_type))) {
+    return_stream << "Invalid data type '" << request->sdo_data_type << "'!";
+    response->sdo_return_message = return_stream.str();
+    response->success = false;
+    RCLCPP_ERROR(rclcpp::get_logger("ethercat_manager"), return_stream.str().c_str());
+    return true;
+  }
+
+  SdoKey key;
+  key.master = request->master_id;
+  key.slave_position = request->slave_position;
+  key.index = request->sdo_index;
+  key.subindex = request->sdo_subindex;
+  const SdoCache::Clock::time_point now = SdoCache::Clock::now();
+  std::vector<uint8_t> buffer;
+  if (!from_mailbox) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    if (!cache_.lookup(key, now, buffer)) {
+      return false;
+    }
+    response->cached = true;
+  } else {
+    data.target_size = data_type->byteSize;
+    buffer.resize(data.target_size + 1);
+    data.target = buffer.data();
+
+    try {
+      mailbox_->upload(request->master_id, &data);
+    } catch (MasterException & e) {
+      return_stream << e.what();
+      response->success = false;
+      RCLCPP_ERROR(rclcpp::get_logger("ethercat_manager"), return_stream.str().c_str());
+      response->sdo_return_message = return_stream.str();
+      return true;
+    }
+
+    buffer.resize(data.data_size);
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    cache_.store(key, now, buffer);
+  }
+
+  try {
+    buffer2data(data_stream, data_value, data_type, buffer.data(), buffer.size());
+  } catch (SizeException & e) {
+    return_stream << e.what();
+    response->success = false;
+    RCLCPP_ERROR(rclcpp::get_logger("ethercat_manager"), return_stream.str().c_str());
+    response->sdo_return_message = return_stream.str();
+    return true;
+  }
+  return_stream << (response->cached ? "SDO value read from cache" :
+    "SDO upload done successfully");
+  response->success = true;
+  response->sdo_return_value_string = data_stream.str();
+  response->sdo_return_value = data_value;
+  response->sdo_return_message = return_stream.str();
+
+  if (response->cached) {
+    RCLCPP_DEBUG(rclcpp::get_logger("ethercat_sdo_srv_server"), return_stream.str().c_str());
+  } else {
+    RCLCPP_INFO(rclcpp::get_logger("ethercat_sdo_srv_server"), return_stream.str().c_str());
+  }
+  return true;
+}
+
+void SdoServer::download(
+  const std::shared_ptr<SetSdo::Request> request,
+  std::shared_ptr<SetSdo::Response> response)
+{
+  ec_ioctl_slave_sdo_download_t data;
+  std::stringstream return_stream, data_stream;
+  const DataType * data_type = NULL;
+  data.complete_access = 0;
+  data.sdo_index = request->sdo_index;
+  data.sdo_entry_subindex = request->sdo_subindex;
+
+  data.slave_position = request->slave_position;
+  if (!(data_type = get_data_type(request->sdo_data_type))) {
+    return_stream << "Invalid data type '" << request->sdo_data_type << "'!";
+    response->success = false;
+    response->sdo_return_message = return_stream.str();
+    RCLCPP_ERROR(rclcpp::get_logger("ethercat_manager"), return_stream.str().c_str());
+    return;
+  }
+
+  data.data_size = request->sdo_value.size();
+  data.data = new uint8_t[data.data_size + 1];
+
+  try {
+    data.data_size = data2buffer(
+      data_type, request->sdo_value, data.data, data.data_size);
+  } catch (SizeException & e) {
+    return_stream << e.what();
+    response->success = false;
+    response->sdo_return_message = return_stream.str();
+    RCLCPP_ERROR(rclcpp::get_logger("ethercat_manager"), return_stream.str().c_str());
+    if (nullptr != data.data) {
+      delete[] data.data;
+    }
+    return;
+  } catch (std::ios::failure & e) {
+    return_stream << "Invalid value for type '" << data_type->name << "'!";
+    response->success = false;
+    response->sdo_return_message = return_stream.str();
+    RCLCPP_ERROR(rclcpp::get_logger("ethercat_manager"), return_stream.str().c_str());
+    if (nullptr != data.data) {
+      delete[] data.data;
+    }
+    return;
+  }
+
+  // the object may change even if the download fails
+  SdoKey key;
+  key.master = request->master_id;
+  key.slave_position = static_cast<uint16_t>(request->slave_position);
+  key.index = static_cast<uint16_t>(request->sdo_index);
+  key.subindex = static_cast<uint8_t>(request->sdo_subindex);
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    cache_.invalidate(key);
+  }
+
+  try {
+    mailbox_->download(request->master_id, &data);
+  } catch (MasterException & e) {
+    return_stream << e.what();
+    response->success = false;
+    RCLCPP_ERROR(rclcpp::get_logger("ethercat_manager"), return_stream.str().c_str());
+    response->sdo_return_message = return_stream.str();
+    if (nullptr != data.data) {
+      delete[] data.data;
+    }
+    return;
+  }
+
+  return_stream << "SDO download done successfully";
+  response->success = true;
+  response->sdo_return_message = return_stream.str();
+
+  if (nullptr != data.data) {
+    delete[] data.data;
+  }
+  RCLCPP_INFO(rclcpp::get_logger("ethercat_sdo_srv_server"), return_stream.str().c_str());
+}
+}  // namespace ethercat_manager
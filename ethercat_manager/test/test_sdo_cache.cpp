@@ -0,0 +1,91 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <vector>
+
+#include "ethercat_manager/sdo_cache.hpp"
+
+using ethercat_manager::SdoCache;
+using ethercat_manager::SdoKey;
+
+SdoKey key(uint16_t slave_position, uint16_t index, uint8_t subindex)
+{
+  SdoKey key;
+  key.slave_position = slave_position;
+  key.index = index;
+  key.subindex = subindex;
+  return key;
+}
+
+TEST(TestSdoCache, TimeToLiveRules)
+{
+  SdoCache cache;
+  ASSERT_TRUE(
+    cache.load(
+      YAML::Load(
+        "{default_ttl: 1.0, objects: [{index: 0x6041, ttl: 0}, "
+        "{index: 0x1018, subindex: 1, ttl: 60}, "
+        "{index: 0x1018, slave_position: 2, ttl: 10}]}")));
+  ASSERT_EQ(cache.ttl(key(0, 0x6064, 0)), 1.0);
+  ASSERT_EQ(cache.ttl(key(0, 0x6041, 0)), 0.0);
+  ASSERT_EQ(cache.ttl(key(0, 0x1018, 1)), 60.0);
+  ASSERT_EQ(cache.ttl(key(0, 0x1018, 2)), 1.0);
+  // the rule on the slave is more specific
+  ASSERT_EQ(cache.ttl(key(2, 0x1018, 1)), 10.0);
+
+  ASSERT_FALSE(cache.load(YAML::Load("{objects: [{index: 0x6041}]}")));
+}
+
+TEST(TestSdoCache, ExpiresAndInvalidates)
+{
+  SdoCache cache;
+  cache.addRule(-1, 0x6041, -1, 0);
+  cache.setDefaultTtl(1.0);
+  const SdoCache::Clock::time_point t0 = SdoCache::Clock::now();
+  const std::vector<uint8_t> value = {0x01, 0x02};
+  std::vector<uint8_t> data;
+
+  ASSERT_FALSE(cache.lookup(key(0, 0x6064, 0), t0, data));
+  cache.store(key(0, 0x6064, 0), t0, value);
+  ASSERT_TRUE(cache.lookup(key(0, 0x6064, 0), t0 + std::chrono::milliseconds(500), data));
+  ASSERT_EQ(data, value);
+  // other subindex, slave and master are other objects
+  ASSERT_FALSE(cache.lookup(key(0, 0x6064, 1), t0, data));
+  ASSERT_FALSE(cache.lookup(key(1, 0x6064, 0), t0, data));
+  SdoKey other_master = key(0, 0x6064, 0);
+  other_master.master = 1;
+  ASSERT_FALSE(cache.lookup(other_master, t0, data));
+  ASSERT_FALSE(cache.lookup(key(0, 0x6064, 0), t0 + std::chrono::seconds(1), data));
+
+  // not cached with a time to live of 0
+  cache.store(key(0, 0x6041, 0), t0, value);
+  ASSERT_FALSE(cache.lookup(key(0, 0x6041, 0), t0, data));
+  ASSERT_EQ(cache.size(), 1u);
+
+  cache.invalidate(key(0, 0x6064, 0));
+  cache.invalidate(key(0, 0x6064, 0));
+  ASSERT_FALSE(cache.lookup(key(0, 0x6064, 0), t0, data));
+  ASSERT_EQ(cache.size(), 0u);
+  ASSERT_EQ(cache.hits(), 1u);
+  ASSERT_EQ(cache.misses(), 7u);
+  ASSERT_EQ(cache.invalidations(), 1u);
+
+  cache.store(key(0, 0x6064, 0), t0, value);
+  cache.prune(t0 + std::chrono::milliseconds(500));
+  ASSERT_EQ(cache.size(), 1u);
+  cache.prune(t0 + std::chrono::seconds(2));
+  ASSERT_EQ(cache.size(), 0u);
+}
@@ -0,0 +1,114 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "ethercat_manager/sdo_monitor_schedule.hpp"
+
+using ethercat_manager::SdoMonitorSchedule;
+
+TEST(TestSdoMonitorSchedule, LoadsObjects)
+{
+  SdoMonitorSchedule schedule;
+  ASSERT_TRUE(
+    schedule.load(
+      YAML::Load(
+        "{bandwidth: 10, publish_period: 0.5, objects: ["
+        "{name: drive_0/temperature, slave_position: 0, index: 0x2026, subindex: 1, "
+        "data_type: int16, period: 2}, "
+        "{name: drive_1/dc_link, slave_position: 1, index: 0x2022, data_type: uint32, "
+        "priority: bulk}]}")));
+  ASSERT_EQ(schedule.objects().size(), 2u);
+  ASSERT_EQ(schedule.slaves(), 2u);
+  ASSERT_EQ(schedule.bandwidth(), 10);
+  ASSERT_EQ(schedule.publishPeriod(), 0.5);
+  ASSERT_EQ(schedule.objects()[0].subindex, 1);
+  ASSERT_EQ(schedule.objects()[1].period, 1);
+  ASSERT_EQ(schedule.objects()[0].priority, "diagnostic");
+  ASSERT_EQ(schedule.objects()[1].priority, "bulk");
+  ASSERT_EQ(schedule.demand(), 1.5);
+
+  SdoMonitorSchedule invalid;
+  ASSERT_FALSE(invalid.load(YAML::Load("{objects: [{name: a, slave_position: 0}]}")));
+  ASSERT_FALSE(
+    invalid.load(
+      YAML::Load(
+        "{objects: [{name: a, slave_position: 0, index: 0x2026, data_type: int16, "
+        "period: 0}]}")));
+  ASSERT_FALSE(invalid.load(YAML::Load("{bandwidth: 0}")));
+}
+
+TEST(TestSdoMonitorSchedule, SharesBudgetAcrossSlaves)
+{
+  SdoMonitorSchedule schedule;
+  SdoMonitorSchedule::Object object;
+  object.period = 1;
+  for (int i = 0; i < 3; i++) {
+    schedule.add(object);
+  }
+  object.slave_position = 1;
+  schedule.add(object);
+  ASSERT_TRUE(schedule.load(YAML::Load("{bandwidth: 2}")));
+
+  std::vector<size_t> uploads;
+  schedule.start(0);
+  // one upload per 0.5 s, alternating between the slaves
+  for (int i = 0; i <= 4; i++) {
+    schedule.next(0.5 * i, uploads);
+  }
+  ASSERT_EQ(uploads, std::vector<size_t>({0, 3, 1, 3, 2}));
+  // objects 1 and 2 were served a period or more after they were due
+  ASSERT_EQ(schedule.late(), 2u);
+
+  // the budget is not saved while nothing is due
+  schedule.start(0);
+  uploads.clear();
+  schedule.next(0, uploads);
+  uploads.clear();
+  schedule.next(5, uploads);
+  ASSERT_EQ(uploads.size(), 4u);
+  uploads.clear();
+  schedule.next(5.6, uploads);
+  ASSERT_TRUE(uploads.empty());
+  // all the objects are due again, the budget of the last 0.4 s is left
+  schedule.next(6, uploads);
+  ASSERT_EQ(uploads.size(), 1u);
+}
+
+TEST(TestSdoMonitorSchedule, KeepsPeriods)
+{
+  SdoMonitorSchedule schedule;
+  SdoMonitorSchedule::Object object;
+  object.period = 0.1;
+  schedule.add(object);
+  object.period = 0.25;
+  object.slave_position = 1;
+  schedule.add(object);
+  ASSERT_TRUE(schedule.load(YAML::Load("{bandwidth: 100}")));
+
+  std::vector<size_t> uploads;
+  std::vector<int> count(2, 0);
+  schedule.start(0);
+  for (int i = 0; i < 100; i++) {
+    uploads.clear();
+    schedule.next(0.01 * i + 1e-9, uploads);
+    for (const size_t upload : uploads) {
+      count[upload]++;
+    }
+  }
+  ASSERT_EQ(count[0], 10);
+  ASSERT_EQ(count[1], 4);
+  ASSERT_EQ(schedule.late(), 0u);
+}
@@ -0,0 +1,166 @@
+// Copyright 2023 ICUBE Laboratory, University of Strasbourg
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "ethercat_manager/sdo_monitor.hpp"
+#include "ethercat_manager/sdo_server.hpp"
+
+using ethercat_interface::SdoScheduler;
+using ethercat_manager::SdoMailbox;
+using ethercat_manager::SdoMonitor;
+using ethercat_manager::SdoServer;
+
+/** slaves answering after a delay, recording the transfers in the order they start */
+class FakeMailbox : public SdoMailbox
+{
+public:
+  void upload(int, ec_ioctl_slave_sdo_upload_t * data) override
+  {
+    transfer("upload");
+    std::fill(data->target, data->target + data->target_size, 0);
+    data->data_size = data->target_size;
+  }
+
+  void download(int, ec_ioctl_slave_sdo_download_t *) override
+  {
+    transfer("download");
+  }
+
+  std::vector<std::string> transfers()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return transfers_;
+  }
+
+  /** most transfers running at the same time */
+  int overlap()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return overlap_;
+  }
+
+private:
+  void transfer(const std::string & kind)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      transfers_.push_back(kind);
+      overlap_ = std::max(overlap_, ++running_);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_--;
+  }
+
+  std::mutex mutex_;
+  std::vector<std::string> transfers_;
+  int running_ = 0;
+  int overlap_ = 0;
+};
+
+class FriendSdoMonitor : public SdoMonitor
+{
+public:
+  using SdoMonitor::SdoMonitor;
+  using SdoMonitor::tick;
+};
+
+class SdoNodesTest : public ::testing::Test
+{
+protected:
+  static void SetUpTestCase() {rclcpp::init(0, nullptr);}
+  static void TearDownTestCase() {rclcpp::shutdown();}
+
+  void SetUp()
+  {
+    config_ = ::testing::TempDir() + "test_sdo_nodes.yaml";
+    std::ofstream(config_) <<
+      "bandwidth: 100\n"
+      "objects:\n"
+      "  - {name: temperature, slave_position: 0, index: 0x2026, data_type: int16, "
+      "period: 1.0, priority: diagnostic}\n";
+    scheduler_ = std::make_shared<SdoScheduler>(2);
+    mailbox_ = std::make_shared<FakeMailbox>();
+    server_ = std::make_shared<SdoServer>(scheduler_, mailbox_);
+    monitor_ = std::make_shared<FriendSdoMonitor>(
+      scheduler_, mailbox_, rclcpp::NodeOptions().parameter_overrides({{"config", config_}}));
+  }
+
+  void TearDown()
+  {
+    monitor_.reset();
+    server_.reset();
+    std::remove(config_.c_str());
+  }
+
+  /** wait until the mailbox made count transfers */
+  bool waitTransfers(size_t count)
+  {
+    for (int i = 0; i < 200 && mailbox_->transfers().size() < count; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return mailbox_->transfers().size() == count;
+  }
+
+  std::string config_;
+  std::shared_ptr<SdoScheduler> scheduler_;
+  std::shared_ptr<FakeMailbox> mailbox_;
+  std::shared_ptr<SdoServer> server_;
+  std::shared_ptr<FriendSdoMonitor> monitor_;
+};
+
+TEST_F(SdoNodesTest, BulkBurstDoesNotDelayMonitorUploads)
+{
+  const size_t burst = 5;
+  std::atomic<size_t> succeeded(0);
+  for (size_t i = 0; i < burst; i++) {
+    auto request = std::make_shared<SdoServer::SetSdo::Request>();
+    request->slave_position = 0;
+    request->sdo_index = 0x2000;
+    request->sdo_data_type = "int16";
+    request->sdo_value = "1";
+    request->priority = SdoServer::SetSdo::Request::PRIORITY_BULK;
+    server_->setSdo(
+      request, [&succeeded](SdoServer::SetSdo::Response & response) {
+        succeeded += response.success;
+      });
+  }
+  monitor_->tick();
+
+  ASSERT_TRUE(waitTransfers(burst + 1));
+  // the last transfer ends
+  scheduler_->stop();
+  const std::vector<std::string> transfers = mailbox_->transfers();
+  // the diagnostic upload waits at most for the download running on the slave
+  const size_t upload = std::find(transfers.begin(), transfers.end(), "upload") -
+    transfers.begin();
+  EXPECT_LE(upload, 1u);
+  // the transfers of both nodes on the slave are one at a time
+  EXPECT_EQ(mailbox_->overlap(), 1);
+  EXPECT_EQ(scheduler_->executed(SdoScheduler::DIAGNOSTIC), 1u);
+  EXPECT_EQ(scheduler_->executed(SdoScheduler::BULK), burst);
+  EXPECT_EQ(succeeded, burst);
+}